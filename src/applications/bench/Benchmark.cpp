@@ -0,0 +1,249 @@
+/*
+ * Copyright 2016, Simula Research Laboratory
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+#include "Benchmark.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <iomanip>
+#include <new>
+#include <ostream>
+
+#ifdef _WIN32
+#include <malloc.h> // _aligned_malloc
+#endif
+
+namespace {
+
+std::atomic<std::uint64_t> nAllocations(0);
+
+// nullptr if the allocation fails.
+void* countedAllocation(std::size_t size, const std::nothrow_t&) noexcept
+{
+  nAllocations.fetch_add(1, std::memory_order_relaxed);
+  return std::malloc(size ? size : 1);
+}
+
+void* countedAllocation(std::size_t size)
+{
+  if (void* p = countedAllocation(size, std::nothrow))
+    return p;
+  throw std::bad_alloc();
+}
+
+#ifdef __cpp_aligned_new
+void* countedAlignedAllocation(std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+  nAllocations.fetch_add(1, std::memory_order_relaxed);
+  const std::size_t align = static_cast<std::size_t>(alignment);
+#ifdef _WIN32
+  return _aligned_malloc(size ? size : 1, align);
+#else
+  // aligned_alloc wants a multiple of the alignment.
+  return std::aligned_alloc(align, ((size ? size : 1) + align - 1) / align * align);
+#endif
+}
+
+void* countedAlignedAllocation(std::size_t size, std::align_val_t alignment)
+{
+  if (void* p = countedAlignedAllocation(size, alignment, std::nothrow))
+    return p;
+  throw std::bad_alloc();
+}
+
+void alignedFree(void* p) noexcept
+{
+#ifdef _WIN32
+  _aligned_free(p);
+#else
+  std::free(p);
+#endif
+}
+#endif
+
+} // namespace
+
+// Count the heap allocations of the whole executable, through every
+// replaceable form of operator new.
+void* operator new(std::size_t size) { return countedAllocation(size); }
+void* operator new[](std::size_t size) { return countedAllocation(size); }
+void* operator new(std::size_t size, const std::nothrow_t& tag) noexcept { return countedAllocation(size, tag); }
+void* operator new[](std::size_t size, const std::nothrow_t& tag) noexcept { return countedAllocation(size, tag); }
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t) noexcept { std::free(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept { std::free(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { std::free(p); }
+
+#ifdef __cpp_aligned_new
+void* operator new(std::size_t size, std::align_val_t alignment) { return countedAlignedAllocation(size, alignment); }
+void* operator new[](std::size_t size, std::align_val_t alignment) { return countedAlignedAllocation(size, alignment); }
+void* operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t& tag) noexcept { return countedAlignedAllocation(size, alignment, tag); }
+void* operator new[](std::size_t size, std::align_val_t alignment, const std::nothrow_t& tag) noexcept { return countedAlignedAllocation(size, alignment, tag); }
+void operator delete(void* p, std::align_val_t) noexcept { alignedFree(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { alignedFree(p); }
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept { alignedFree(p); }
+void operator delete[](void* p, std::size_t, std::align_val_t) noexcept { alignedFree(p); }
+void operator delete(void* p, std::align_val_t, const std::nothrow_t&) noexcept { alignedFree(p); }
+void operator delete[](void* p, std::align_val_t, const std::nothrow_t&) noexcept { alignedFree(p); }
+#endif
+
+namespace cctag {
+namespace bench {
+
+namespace {
+
+// Runs shorter than this are too noisy to extrapolate the iteration count from.
+const double kMinCalibrationNs = 1e6;
+const std::size_t kMaxIterations = std::size_t(1) << 30;
+
+struct Result
+{
+  std::string name;
+  std::size_t iterations;
+  double nsPerOp;
+  double itemsPerS;
+  double allocsPerOp;
+  std::string skipReason;
+};
+
+Result run(const Benchmark& benchmark, const RunOptions& options)
+{
+  const double minTimeNs = options.minTimeS * 1e9;
+  std::size_t iterations = 1;
+  for (;;)
+  {
+    State state(iterations);
+    benchmark.function(state);
+    if (!state.skipReason().empty())
+      return Result{ benchmark.name, 0, 0, 0, 0, state.skipReason() };
+
+    const double elapsed = std::max(state.elapsedNs(), 1.);
+    if (elapsed >= minTimeNs || iterations >= kMaxIterations)
+    {
+      return Result{
+        benchmark.name,
+        iterations,
+        elapsed / iterations,
+        state.itemsProcessed() * 1e9 / elapsed,
+        double(state.allocations()) / iterations,
+        std::string() };
+    }
+
+    // Aim 40% past the minimum time, growing by at most 10x per step while the
+    // runs are short.
+    const double scale = elapsed < kMinCalibrationNs ? 10. : std::min(10., 1.4 * minTimeNs / elapsed);
+    iterations = std::min(kMaxIterations, std::max(iterations + 1, std::size_t(iterations * scale)));
+  }
+}
+
+void printTableHeader(std::ostream& ostr)
+{
+  ostr << std::left << std::setw(44) << "benchmark"
+       << std::right << std::setw(12) << "iterations"
+       << std::setw(16) << "ns/op"
+       << std::setw(14) << "items/s"
+       << std::setw(13) << "allocs/op" << '\n'
+       << std::string(44 + 12 + 16 + 14 + 13, '-') << '\n';
+}
+
+void printTableRow(std::ostream& ostr, const Result& r)
+{
+  ostr << std::left << std::setw(44) << r.name << std::right;
+  if (!r.skipReason.empty())
+  {
+    ostr << "  skipped: " << r.skipReason << std::endl;
+    return;
+  }
+  ostr << std::setw(12) << r.iterations
+       << std::setw(16) << std::fixed << std::setprecision(1) << r.nsPerOp
+       << std::setw(14) << std::scientific << std::setprecision(3) << r.itemsPerS
+       << std::setw(13) << std::fixed << std::setprecision(1) << r.allocsPerOp
+       << std::endl;
+}
+
+void printCsvRow(std::ostream& ostr, const Result& r)
+{
+  ostr << r.name << ',' << r.iterations << ','
+       << std::fixed << std::setprecision(1) << r.nsPerOp << ','
+       << std::setprecision(0) << r.itemsPerS << ','
+       << std::setprecision(2) << r.allocsPerOp << ','
+       << r.skipReason << std::endl;
+}
+
+} // namespace
+
+std::uint64_t allocationCount()
+{
+  return nAllocations.load(std::memory_order_relaxed);
+}
+
+State::State(std::size_t iterations)
+  : _iterations(iterations)
+{}
+
+State::Iterator State::begin()
+{
+  resumeTiming();
+  return Iterator(this, _iterations);
+}
+
+void State::pauseTiming()
+{
+  if (!_running)
+    return;
+  _elapsedNs += std::chrono::duration<double, std::nano>(Clock::now() - _start).count();
+  _allocations += allocationCount() - _startAllocations;
+  _running = false;
+}
+
+void State::resumeTiming()
+{
+  if (_running)
+    return;
+  _running = true;
+  _startAllocations = allocationCount();
+  _start = Clock::now();
+}
+
+void State::finish()
+{
+  pauseTiming();
+}
+
+std::vector<Benchmark>& registry()
+{
+  static std::vector<Benchmark> benchmarks;
+  return benchmarks;
+}
+
+std::size_t runBenchmarks(const RunOptions& options, std::ostream& ostr)
+{
+  if (options.csv)
+    ostr << "benchmark,iterations,ns_per_op,items_per_s,allocs_per_op,skipped" << std::endl;
+  else
+    printTableHeader(ostr);
+
+  std::size_t nRun = 0;
+  for (const Benchmark& benchmark : registry())
+  {
+    if (benchmark.name.find(options.filter) == std::string::npos)
+      continue;
+    const Result result = run(benchmark, options);
+    if (options.csv)
+      printCsvRow(ostr, result);
+    else
+      printTableRow(ostr, result);
+    ++nRun;
+  }
+  return nRun;
+}
+
+} // namespace bench
+} // namespace cctag
@@ -0,0 +1,141 @@
+/*
+ * Copyright 2016, Simula Research Laboratory
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iosfwd>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace cctag {
+namespace bench {
+
+/**
+ * Minimal micro-benchmark harness, in the style of Google Benchmark. A
+ * benchmark is a function of a State, registered under a name:
+ *
+ *   static Registrar registrar("vote/01.png", [](State& state)
+ *   {
+ *     ...                               // untimed setup
+ *     for (auto _ : state)
+ *     {
+ *       (void)_;                        // the loop variable is not used
+ *       state.pauseTiming();            // untimed per-iteration setup
+ *       ...
+ *       state.resumeTiming();
+ *       ...                             // timed
+ *     }
+ *     state.setItemsProcessed(state.iterations() * nItems);
+ *   });
+ *
+ * The runner increases the number of iterations until a run lasts at least
+ * the minimum time, and reports the time per iteration, the processed items
+ * per second and the heap allocations per iteration (operator new is counted
+ * in the benchmark executable).
+ */
+
+// Number of calls to operator new so far, in all the threads.
+std::uint64_t allocationCount();
+
+class State
+{
+public:
+  explicit State(std::size_t iterations);
+
+  class Iterator
+  {
+  public:
+    Iterator(State* state, std::size_t remaining) : _state(state), _remaining(remaining) {}
+
+    // The loop variable is not used.
+    struct Value {};
+    Value operator*() const { return Value(); }
+    Iterator& operator++() { --_remaining; return *this; }
+
+    bool operator!=(const Iterator&)
+    {
+      if (_remaining != 0)
+        return true;
+      _state->finish();
+      return false;
+    }
+
+  private:
+    State* _state;
+    std::size_t _remaining;
+  };
+
+  Iterator begin();
+  Iterator end() { return Iterator(this, 0); }
+
+  // Exclude the per-iteration setup from the measures.
+  void pauseTiming();
+  void resumeTiming();
+
+  void setItemsProcessed(std::size_t items) { _items = items; }
+  // Mark the benchmark as not runnable (e.g. its input could not be loaded).
+  void skip(const std::string& reason) { _skipReason = reason; }
+
+  std::size_t iterations() const { return _iterations; }
+  std::size_t itemsProcessed() const { return _items; }
+  const std::string& skipReason() const { return _skipReason; }
+  double elapsedNs() const { return _elapsedNs; }
+  std::uint64_t allocations() const { return _allocations; }
+
+private:
+  void finish();
+
+  using Clock = std::chrono::steady_clock;
+
+  std::size_t _iterations;
+  std::size_t _items = 0;
+  std::string _skipReason;
+  bool _running = false;
+  Clock::time_point _start;
+  std::uint64_t _startAllocations = 0;
+  double _elapsedNs = 0;
+  std::uint64_t _allocations = 0;
+};
+
+using BenchmarkFunction = std::function<void(State&)>;
+
+struct Benchmark
+{
+  std::string name;
+  BenchmarkFunction function;
+};
+
+std::vector<Benchmark>& registry();
+
+struct Registrar
+{
+  Registrar(const std::string& name, BenchmarkFunction function)
+  {
+    registry().push_back(Benchmark{ name, std::move(function) });
+  }
+};
+
+struct RunOptions
+{
+  double minTimeS = 0.5;            // minimum duration of the measured run
+  std::string filter;               // only the benchmarks whose name contains it
+  bool csv = false;                 // CSV instead of a table
+};
+
+/**
+ * @brief Run the registered benchmarks.
+ * @return the number of benchmarks run
+ */
+std::size_t runBenchmarks(const RunOptions& options, std::ostream& ostr);
+
+} // namespace bench
+} // namespace cctag
@@ -0,0 +1,221 @@
+/*
+ * Copyright 2016, Simula Research Laboratory
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+#include "Fixtures.hpp"
+#include "../synthetic/Scene.hpp"
+
+#include <cctag/Canny.hpp>
+#include <cctag/Detection.hpp>
+#include <cctag/EllipseGrowing.hpp>
+#include <cctag/Identification.hpp>
+#include <cctag/Vote.hpp>
+#include <cctag/filter/cvRecode.hpp>
+#include <cctag/filter/thinning.hpp>
+
+#include <opencv2/imgcodecs.hpp>
+
+#include <algorithm>
+#include <iostream>
+#include <map>
+#include <random>
+
+namespace cctag {
+namespace bench {
+
+namespace {
+
+std::string sampleDirectory = "sample";
+
+const char* const kSyntheticScene = "synthetic-1080p";
+
+// Number of seeds tried for a flow component leading to an outer ellipse.
+const std::size_t kMaxSeedsTried = 50;
+
+/*
+ * Markers of the bank rendered by the synthetic scene generator, with a fixed
+ * seed: the same scene on every run. The markers are only mildly tilted and
+ * the background has no clutter, so that the first seeds lead to an outer
+ * ellipse.
+ */
+cv::Mat syntheticScene(const CCTagMarkersBank& bank)
+{
+  synthetic::SceneOptions options;
+  options.nTags = 18;
+  options.minRadius = 80.f;
+  options.maxRadius = 110.f;
+  options.maxTiltDeg = 20.f;
+  options.noiseSigma = 3.f;
+  options.nClutter = 0;
+
+  cv::Mat scene;
+  std::mt19937 rng(42);
+  synthetic::renderScene(scene, options, bank, rng);
+  return scene;
+}
+
+bool loadScene(StageFixture& fixture)
+{
+  if (fixture.name == kSyntheticScene)
+  {
+    fixture.gray = syntheticScene(fixture.bank);
+    return true;
+  }
+  fixture.gray = cv::imread(sampleDirectory + "/" + fixture.name, cv::IMREAD_GRAYSCALE);
+  return !fixture.gray.empty();
+}
+
+void buildEdges(StageFixture& f)
+{
+  const Parameters& params = f.params;
+  f.canny.create(f.gray.rows, f.gray.cols, CV_8UC1);
+  f.dx.create(f.gray.rows, f.gray.cols, CV_16SC1);
+  f.dy.create(f.gray.rows, f.gray.cols, CV_16SC1);
+  cvRecodedCanny(f.gray, f.canny, f.dx, f.dy,
+                 params._cannyThrLow * 256, params._cannyThrHigh * 256,
+                 3 | CV_CANNY_L2_GRADIENT, 0, &params);
+
+  f.edges = f.canny.clone();
+  cv::Mat temp(f.gray.rows, f.gray.cols, CV_8UC1);
+  thin(f.edges, temp);
+
+  f.edgeCollection.reset(new EdgePointCollection(f.gray.cols, f.gray.rows));
+  EdgePointCollection& edgeCollection = *f.edgeCollection;
+  edgesPointsFromCanny(edgeCollection, f.edges, f.dx, f.dy);
+  vote(edgeCollection, f.seeds, f.dx, f.dy, params, f.debug);
+  std::sort(f.seeds.begin(), f.seeds.end(),
+    [&edgeCollection](const EdgePoint* p1, const EdgePoint* p2)
+    { return edgeCollection.is_max(p1) > edgeCollection.is_max(p2); });
+}
+
+// Same steps as the construction and the completion of a flow component in
+// the detection, up to the ellipse growing.
+void buildFlowComponent(StageFixture& f)
+{
+  const Parameters& params = f.params;
+  const EdgePointCollection& edgeCollection = *f.edgeCollection;
+
+  const std::size_t nSeeds = std::min(f.seeds.size(), kMaxSeedsTried);
+  for (std::size_t iSeed = 0; iSeed < nSeeds; ++iSeed)
+  {
+    std::list<EdgePoint*> convexEdgeSegment;
+    std::vector<EdgePoint*> processedIn;
+    edgeLinking(edgeCollection, convexEdgeSegment, processedIn, f.seeds[iSeed],
+                params._windowSizeOnInnerEllipticSegment, params._averageVoteMin);
+    f.children.clear();
+    childrenOf(edgeCollection, convexEdgeSegment, f.children);
+    if (f.children.size() < params._minPointsSegmentCandidate)
+      continue;
+
+    float SmFinal = 1e+10;
+    f.filteredChildren.clear();
+    outlierRemoval(f.children, f.filteredChildren, SmFinal,
+                   params._threshRobustEstimationOfOuterEllipse, f.debug, kWeight, 60);
+    if (f.filteredChildren.size() < 5)
+      continue;
+
+    f.goodInit = ellipseGrowingInit(f.filteredChildren, f.initialEllipse);
+    f.outerEllipse = f.initialEllipse;
+    f.outerEllipsePoints.clear();
+    ellipseGrowing2(edgeCollection, f.filteredChildren, f.outerEllipsePoints, f.outerEllipse,
+                    params._ellipseGrowingEllipticHullWidth, 0, f.goodInit);
+
+    // The benchmarks start from unprocessed points.
+    for (int i = 0; i < edgeCollection.get_point_count(); ++i)
+      edgeCollection.processed(i) = 0;
+
+    if (f.outerEllipsePoints.size() < 5)
+      continue;
+
+    f.outerPoints.clear();
+    for (const EdgePoint* p : f.outerEllipsePoints)
+      f.outerPoints.emplace_back(p->cast<float>());
+    return;
+  }
+  f.edgeFailure = "no flow component leads to an outer ellipse";
+}
+
+void buildIdentification(StageFixture& f)
+{
+  cctagDetection(f.markers, 0, 0, f.gray, f.params, f.bank);
+  for (const CCTag& marker : f.markers)
+  {
+    if (marker.getStatus() == status::id_reliable)
+    {
+      f.marker = &marker;
+      break;
+    }
+  }
+  if (!f.marker)
+  {
+    f.identificationFailure = "no marker identified";
+    return;
+  }
+
+  if (identification::identify_step_1(0, *f.marker, f.selectedCuts, f.gray, f.params, f.debug) != status::id_reliable)
+  {
+    f.identificationFailure = "no cut selected";
+    return;
+  }
+
+  const numerical::geometry::Ellipse& ellipse = f.marker->rescaledOuterEllipse();
+  f.rectifiedCuts = f.selectedCuts;
+  f.homography = Eigen::Matrix3f::Identity();
+  Point2d<Eigen::Vector3f> center(ellipse.center());
+  float residual = 0;
+  std::size_t nEvaluations = 0;
+  if (!identification::refineConicFamilyGlob(0, f.homography, center, f.rectifiedCuts, f.gray,
+                                              nullptr, ellipse, f.params, nullptr, residual,
+                                              nEvaluations, f.debug))
+  {
+    f.identificationFailure = "imaged center optimization diverged";
+  }
+}
+
+} // namespace
+
+StageFixture::StageFixture()
+  : params(3)
+  , bank(3)
+{}
+
+void setSampleDirectory(const std::string& directory)
+{
+  sampleDirectory = directory;
+}
+
+const std::vector<std::string>& sceneNames()
+{
+  static const std::vector<std::string> names{ "01.png", "02.png", kSyntheticScene };
+  return names;
+}
+
+StageFixture* stageFixture(const std::string& scene)
+{
+  static std::map<std::string, std::unique_ptr<StageFixture>> fixtures;
+
+  auto found = fixtures.find(scene);
+  if (found != fixtures.end())
+    return found->second.get();
+
+  std::unique_ptr<StageFixture> fixture(new StageFixture);
+  fixture->name = scene;
+  if (!loadScene(*fixture))
+  {
+    std::cerr << "Unable to load " << sampleDirectory << "/" << scene << std::endl;
+    fixture.reset();
+  }
+  else
+  {
+    buildEdges(*fixture);
+    buildFlowComponent(*fixture);
+    buildIdentification(*fixture);
+  }
+  return (fixtures[scene] = std::move(fixture)).get();
+}
+
+} // namespace bench
+} // namespace cctag
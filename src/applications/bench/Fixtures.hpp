@@ -0,0 +1,89 @@
+/*
+ * Copyright 2016, Simula Research Laboratory
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+#pragma once
+
+#include <cctag/CCTag.hpp>
+#include <cctag/CCTagMarkersBank.hpp>
+#include <cctag/CutBatch.hpp>
+#include <cctag/EdgePoint.hpp>
+#include <cctag/Params.hpp>
+#include <cctag/Types.hpp>
+#include <cctag/geometry/Ellipse.hpp>
+#include <cctag/utils/DebugSink.hpp>
+
+#include <opencv2/core/core.hpp>
+
+#include <Eigen/Core>
+
+#include <list>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace cctag {
+namespace bench {
+
+/**
+ * @brief Inputs of every stage, computed once per scene by running the
+ * pipeline up to the stage, on the original resolution.
+ */
+struct StageFixture
+{
+  StageFixture();
+
+  std::string name;
+  Parameters params;
+  CCTagMarkersBank bank;
+  cv::Mat gray;
+  DebugSink debug;
+
+  // Edge detection: Canny output before and after thinning, and the gradients.
+  cv::Mat canny;
+  cv::Mat edges;
+  cv::Mat dx;
+  cv::Mat dy;
+
+  // Edge points after the vote, and its seeds sorted by decreasing votes.
+  std::unique_ptr<EdgePointCollection> edgeCollection;
+  std::vector<EdgePoint*> seeds;
+
+  // Flow component of the first seed leading to an outer ellipse.
+  std::list<EdgePoint*> children;
+  std::vector<EdgePoint*> filteredChildren;
+  bool goodInit = false;
+  numerical::geometry::Ellipse initialEllipse;
+  std::vector<EdgePoint*> outerEllipsePoints;
+  std::vector<Eigen::Vector3f> outerPoints;
+  numerical::geometry::Ellipse outerEllipse;
+
+  // Identification of the first identified marker of the full detection.
+  CCTag::List markers;
+  const CCTag* marker = nullptr;
+  CutBatch selectedCuts;   // before the imaged center optimization
+  CutBatch rectifiedCuts;  // after it
+  Eigen::Matrix3f homography;
+
+  // Reason for which a stage cannot be benchmarked on this scene, if any.
+  std::string edgeFailure;
+  std::string identificationFailure;
+};
+
+// Directory of 01.png and 02.png.
+void setSampleDirectory(const std::string& directory);
+
+// Names of the scenes the stages are benchmarked on.
+const std::vector<std::string>& sceneNames();
+
+/**
+ * @brief Fixture of a scene, built on first use.
+ * @return nullptr if the scene cannot be loaded
+ */
+StageFixture* stageFixture(const std::string& scene);
+
+} // namespace bench
+} // namespace cctag
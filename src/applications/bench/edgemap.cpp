@@ -0,0 +1,212 @@
+/*
+ * Copyright 2016, Simula Research Laboratory
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+// Compares the edge map layouts on the access pattern of the gradient descent
+// of the vote: short field lines in arbitrary directions starting from edge
+// points, probing the map (and a neighbour) at each step until an edge point
+// is hit. The edge maps are synthetic (rings plus clutter) with the density of
+// a Canny output, from VGA to the largest supported resolution.
+
+#include <cctag/EdgeMapLayout.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+
+using namespace cctag;
+
+namespace {
+
+const int kDistSearch = 30;   // default Parameters::_distSearch
+const int kRepetitions = 5;   // the best time is kept
+
+struct Walk
+{
+  int x, y;
+  float dx, dy;
+};
+
+struct Resolution
+{
+  int w, h;
+  const char* name;
+};
+
+// Edge map stored with a given layout; withOccupancy selects the bitmap test
+// before the int load, as in EdgePointCollection.
+template<typename Layout, bool withOccupancy>
+class EdgeMap
+{
+public:
+  EdgeMap(int w, int h, const std::vector<std::pair<int,int>>& points)
+    : _w(w), _h(h), _layout(w, h)
+    , _map(_layout.size(), -1)
+    , _occupancy((_layout.size()+63)/64, 0)
+  {
+    for (std::size_t i = 0; i < points.size(); ++i)
+    {
+      const std::size_t cell = _layout.index(points[i].first, points[i].second);
+      _map[cell] = int(i);
+      setOccupancy(_occupancy.data(), cell);
+    }
+  }
+
+  int operator()(int x, int y) const
+  {
+    const std::size_t cell = _layout.index(x, y);
+    if (withOccupancy && !testOccupancy(_occupancy.data(), cell))
+      return -1;
+    return _map[cell];
+  }
+
+  // Walk along the direction like gradientDirectionDescent and return the
+  // index of the hit point or -1.
+  int walk(const Walk& walk) const
+  {
+    const bool yMajor = std::abs(walk.dy) > std::abs(walk.dx);
+    const float a = yMajor ? std::abs(walk.dx/walk.dy) : std::abs(walk.dy/walk.dx);
+    const int stpX = walk.dx > 0 ? 1 : -1;
+    const int stpY = walk.dy > 0 ? 1 : -1;
+    int x = walk.x, y = walk.y;
+    float e = 0.f;
+    for (int n = 0; n < kDistSearch; ++n)
+    {
+      e += a;
+      if (yMajor)
+      {
+        y += stpY;
+        if (e >= 0.5f) { x += stpX; e -= 1; }
+      }
+      else
+      {
+        x += stpX;
+        if (e >= 0.5f) { y += stpY; e -= 1; }
+      }
+      if (x < 1 || x >= _w-1 || y < 1 || y >= _h-1)
+        return -1;
+      int hit = (*this)(x, y);
+      if (hit >= 0)
+        return hit;
+      hit = yMajor ? (*this)(x - stpX, y) : (*this)(x, y - stpY);
+      if (hit >= 0)
+        return hit;
+    }
+    return -1;
+  }
+
+private:
+  int _w, _h;
+  Layout _layout;
+  std::vector<int> _map;
+  std::vector<std::uint64_t> _occupancy;
+};
+
+// Rings of random centers and radii, plus isolated clutter points.
+std::vector<std::pair<int,int>> makeEdgePoints(int w, int h, std::mt19937& rng)
+{
+  std::vector<char> taken(std::size_t(w)*h, 0);
+  std::vector<std::pair<int,int>> points;
+  const auto add = [&](int x, int y)
+  {
+    if (x >= 0 && x < w && y >= 0 && y < h && !taken[std::size_t(y)*w + x])
+    {
+      taken[std::size_t(y)*w + x] = 1;
+      points.emplace_back(x, y);
+    }
+  };
+
+  const std::size_t nRings = std::size_t(w)*h / 4000;
+  std::uniform_real_distribution<float> uniform(0.f, 1.f);
+  for (std::size_t i = 0; i < nRings; ++i)
+  {
+    const float cx = uniform(rng) * w;
+    const float cy = uniform(rng) * h;
+    const float r = 4.f + uniform(rng) * 60.f;
+    const int nSteps = int(2 * M_PI * r) + 1;
+    for (int k = 0; k < nSteps; ++k)
+    {
+      const float t = 2 * float(M_PI) * k / nSteps;
+      add(int(cx + r*std::cos(t)), int(cy + r*std::sin(t)));
+    }
+  }
+  const std::size_t nClutter = std::size_t(w)*h / 100;
+  for (std::size_t i = 0; i < nClutter; ++i)
+    add(int(uniform(rng) * w), int(uniform(rng) * h));
+
+  // Canny outputs the points row by row.
+  std::sort(points.begin(), points.end(),
+    [](const std::pair<int,int>& a, const std::pair<int,int>& b)
+    { return a.second < b.second || (a.second == b.second && a.first < b.first); });
+  return points;
+}
+
+template<typename Map>
+void run(const char* name, const Map& map, const std::vector<Walk>& walks, long& reference)
+{
+  double best = 1e30;
+  long checksum = 0;
+  for (int r = 0; r < kRepetitions; ++r)
+  {
+    checksum = 0;
+    const auto t0 = std::chrono::steady_clock::now();
+    for (const Walk& w : walks)
+      checksum += map.walk(w);
+    const auto t1 = std::chrono::steady_clock::now();
+    best = std::min(best, std::chrono::duration<double, std::nano>(t1 - t0).count());
+  }
+  if (reference == 0)
+    reference = checksum;
+
+  std::cout << "  " << std::left << std::setw(22) << name
+            << std::right << std::setw(10) << std::fixed << std::setprecision(1)
+            << best / walks.size() << " ns/walk"
+            << (checksum == reference ? "" : "  MISMATCH") << std::endl;
+}
+
+} // namespace
+
+int main()
+{
+  const std::vector<Resolution> resolutions{
+    { 640, 480, "VGA" },
+    { 1920, 1080, "1080p" },
+    { 3840, 2160, "4K" },
+    { 6144, 3456, "6K" } };
+
+  std::mt19937 rng(42);
+  for (const Resolution& res : resolutions)
+  {
+    const auto points = makeEdgePoints(res.w, res.h, rng);
+
+    // One walk per edge point, in the order of the points, in both directions
+    // of a random gradient.
+    std::vector<Walk> walks;
+    walks.reserve(2*points.size());
+    std::uniform_real_distribution<float> angle(0.f, 2 * float(M_PI));
+    for (const auto& p : points)
+    {
+      const float t = angle(rng);
+      walks.push_back(Walk{ p.first, p.second, std::cos(t), std::sin(t) });
+      walks.push_back(Walk{ p.first, p.second, -std::cos(t), -std::sin(t) });
+    }
+
+    std::cout << res.name << " (" << res.w << "x" << res.h << "), "
+              << points.size() << " edge points, " << walks.size() << " walks" << std::endl;
+
+    long reference = 0;
+    run("row-major", EdgeMap<RowMajorEdgeMapLayout, false>(res.w, res.h, points), walks, reference);
+    run("row-major + bitmap", EdgeMap<RowMajorEdgeMapLayout, true>(res.w, res.h, points), walks, reference);
+    run("tiled 8x8 + bitmap", EdgeMap<TiledEdgeMapLayout, true>(res.w, res.h, points), walks, reference);
+  }
+  return 0;
+}
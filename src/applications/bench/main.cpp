@@ -0,0 +1,67 @@
+/*
+ * Copyright 2016, Simula Research Laboratory
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+#include "Benchmark.hpp"
+#include "Fixtures.hpp"
+
+#include <boost/program_options.hpp>
+
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+int main(int argc, char** argv)
+{
+  using namespace boost::program_options;
+
+  cctag::bench::RunOptions options;
+  std::string sampleDir;
+
+  options_description desc("cctag_bench options");
+  desc.add_options()
+    ("filter", value<std::string>(&options.filter), "Only run the benchmarks whose name contains this string, e.g. vote/ or /02.png")
+    ("min-time", value<double>(&options.minTimeS)->default_value(0.5), "Minimum duration of the measured run of a benchmark (s)")
+    ("sample-dir", value<std::string>(&sampleDir)->default_value("sample"), "Directory of 01.png and 02.png")
+    ("csv", "CSV output")
+    ("list", "List the benchmarks")
+    ("help", "Print help");
+
+  variables_map vm;
+  try
+  {
+    store(parse_command_line(argc, argv, desc), vm);
+    notify(vm);
+  }
+  catch (const error& e)
+  {
+    std::cerr << e.what() << std::endl << desc << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  if (vm.count("help"))
+  {
+    std::cout << desc << std::endl;
+    return EXIT_SUCCESS;
+  }
+
+  if (vm.count("list"))
+  {
+    for (const cctag::bench::Benchmark& benchmark : cctag::bench::registry())
+      std::cout << benchmark.name << std::endl;
+    return EXIT_SUCCESS;
+  }
+
+  options.csv = vm.count("csv") > 0;
+  cctag::bench::setSampleDirectory(sampleDir);
+
+  if (cctag::bench::runBenchmarks(options, std::cout) == 0)
+  {
+    std::cerr << "No benchmark matches \"" << options.filter << "\"" << std::endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,308 @@
+/*
+ * Copyright 2016, Simula Research Laboratory
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+// Benchmarks of the stages of the detection in isolation, each one on the
+// fixtures of every scene (see Fixtures.hpp).
+
+#include "Benchmark.hpp"
+#include "Fixtures.hpp"
+
+#include <cctag/Canny.hpp>
+#include <cctag/EllipseGrowing.hpp>
+#include <cctag/Fitting.hpp>
+#include <cctag/Identification.hpp>
+#include <cctag/Vote.hpp>
+#include <cctag/filter/cvRecode.hpp>
+#include <cctag/filter/thinning.hpp>
+#include <cctag/geometry/Distance.hpp>
+
+#include <list>
+#include <vector>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+using namespace cctag;
+using namespace cctag::bench;
+
+namespace {
+
+// Registers a benchmark of the stage for every scene, as "<stage>/<scene>".
+struct StageRegistrar
+{
+  using StageFunction = void (*)(State&, StageFixture&);
+
+  StageRegistrar(const char* stage, StageFunction function)
+  {
+    for (const std::string& scene : sceneNames())
+    {
+      Registrar(std::string(stage) + "/" + scene, [scene, function](State& state)
+      {
+        StageFixture* fixture = stageFixture(scene);
+        if (!fixture)
+          state.skip("scene not available");
+        else
+          function(state, *fixture);
+      });
+    }
+  }
+};
+
+#define CCTAG_STAGE_BENCHMARK(stage) \
+  void bench_##stage(State& state, StageFixture& fixture); \
+  StageRegistrar registrar_##stage(#stage, bench_##stage); \
+  void bench_##stage(State& state, StageFixture& fixture)
+
+// Keep the compiler from discarding a result.
+#if defined(__GNUC__)
+template<typename T>
+void doNotOptimize(const T& value)
+{
+  asm volatile("" : : "r"(&value) : "memory");
+}
+#else
+// No inline assembly (e.g. MSVC x64): the address escapes through a volatile
+// store and the barrier keeps the compiler from moving memory accesses around it.
+const void* volatile doNotOptimizeSink;
+
+template<typename T>
+void doNotOptimize(const T& value)
+{
+  doNotOptimizeSink = &value;
+#if defined(_MSC_VER)
+  _ReadWriteBarrier();
+#endif
+}
+#endif
+
+/* Edge detection *********************************************************/
+
+CCTAG_STAGE_BENCHMARK(cvRecodedCanny)
+{
+  const Parameters& params = fixture.params;
+  cv::Mat canny(fixture.gray.rows, fixture.gray.cols, CV_8UC1);
+  cv::Mat dx(fixture.gray.rows, fixture.gray.cols, CV_16SC1);
+  cv::Mat dy(fixture.gray.rows, fixture.gray.cols, CV_16SC1);
+  for (auto _ : state)
+  {
+    (void)_;
+    cvRecodedCanny(fixture.gray, canny, dx, dy,
+                   params._cannyThrLow * 256, params._cannyThrHigh * 256,
+                   3 | CV_CANNY_L2_GRADIENT, 0, &params);
+  }
+  state.setItemsProcessed(state.iterations() * fixture.gray.total());
+}
+
+CCTAG_STAGE_BENCHMARK(thin)
+{
+  cv::Mat edges(fixture.canny.rows, fixture.canny.cols, CV_8UC1);
+  cv::Mat temp(fixture.canny.rows, fixture.canny.cols, CV_8UC1);
+  for (auto _ : state)
+  {
+    (void)_;
+    state.pauseTiming();
+    fixture.canny.copyTo(edges);
+    state.resumeTiming();
+    thin(edges, temp);
+  }
+  state.setItemsProcessed(state.iterations() * fixture.canny.total());
+}
+
+CCTAG_STAGE_BENCHMARK(edgesPointsFromCanny)
+{
+  EdgePointCollection edgeCollection(fixture.edges.cols, fixture.edges.rows);
+  for (auto _ : state)
+  {
+    (void)_;
+    state.pauseTiming();
+    edgeCollection.clear();
+    state.resumeTiming();
+    edgesPointsFromCanny(edgeCollection, fixture.edges, fixture.dx, fixture.dy);
+  }
+  state.setItemsProcessed(state.iterations() * edgeCollection.get_point_count());
+}
+
+/* Vote and flow components ***********************************************/
+
+CCTAG_STAGE_BENCHMARK(vote)
+{
+  EdgePointCollection edgeCollection(fixture.edges.cols, fixture.edges.rows);
+  std::vector<EdgePoint*> seeds;
+  for (auto _ : state)
+  {
+    (void)_;
+    state.pauseTiming();
+    edgeCollection.clear();
+    edgesPointsFromCanny(edgeCollection, fixture.edges, fixture.dx, fixture.dy);
+    seeds.clear();
+    state.resumeTiming();
+    vote(edgeCollection, seeds, fixture.dx, fixture.dy, fixture.params, fixture.debug);
+  }
+  state.setItemsProcessed(state.iterations() * edgeCollection.get_point_count());
+}
+
+CCTAG_STAGE_BENCHMARK(outlierRemoval)
+{
+  if (!fixture.edgeFailure.empty())
+    return state.skip(fixture.edgeFailure);
+
+  std::vector<EdgePoint*> filteredChildren;
+  for (auto _ : state)
+  {
+    (void)_;
+    float SmFinal = 1e+10;
+    filteredChildren.clear();
+    outlierRemoval(fixture.children, filteredChildren, SmFinal,
+                   fixture.params._threshRobustEstimationOfOuterEllipse, fixture.debug, kWeight, 60);
+    doNotOptimize(SmFinal);
+  }
+  state.setItemsProcessed(state.iterations() * fixture.children.size());
+}
+
+CCTAG_STAGE_BENCHMARK(ellipseGrowing2)
+{
+  if (!fixture.edgeFailure.empty())
+    return state.skip(fixture.edgeFailure);
+
+  const EdgePointCollection& edgeCollection = *fixture.edgeCollection;
+  std::vector<EdgePoint*> outerEllipsePoints;
+  std::size_t runId = 0;
+  for (auto _ : state)
+  {
+    (void)_;
+    // A run leaves its bit set on the outer ellipse points: the 64 run bits
+    // are used in turn, and cleared once all of them have been used.
+    state.pauseTiming();
+    if (runId == 64)
+    {
+      for (int i = 0; i < edgeCollection.get_point_count(); ++i)
+        edgeCollection.processed(i) = 0;
+      runId = 0;
+    }
+    numerical::geometry::Ellipse ellipse = fixture.initialEllipse;
+    outerEllipsePoints.clear();
+    state.resumeTiming();
+    ellipseGrowing2(edgeCollection, fixture.filteredChildren, outerEllipsePoints, ellipse,
+                    fixture.params._ellipseGrowingEllipticHullWidth, runId++, fixture.goodInit);
+  }
+  for (int i = 0; i < edgeCollection.get_point_count(); ++i)
+    edgeCollection.processed(i) = 0;
+  state.setItemsProcessed(state.iterations() * fixture.outerEllipsePoints.size());
+}
+
+CCTAG_STAGE_BENCHMARK(fitEllipse)
+{
+  if (!fixture.edgeFailure.empty())
+    return state.skip(fixture.edgeFailure);
+
+  numerical::geometry::Ellipse ellipse;
+  for (auto _ : state)
+  {
+    (void)_;
+    numerical::ellipseFitting(ellipse, fixture.outerEllipsePoints);
+    doNotOptimize(ellipse);
+  }
+  state.setItemsProcessed(state.iterations() * fixture.outerEllipsePoints.size());
+}
+
+CCTAG_STAGE_BENCHMARK(distancePointEllipse)
+{
+  if (!fixture.edgeFailure.empty())
+    return state.skip(fixture.edgeFailure);
+
+  std::vector<float> distances;
+  for (auto _ : state)
+  {
+    (void)_;
+    numerical::distancePointEllipse(distances, fixture.outerPoints, fixture.outerEllipse);
+    doNotOptimize(distances.front());
+  }
+  state.setItemsProcessed(state.iterations() * fixture.outerPoints.size());
+}
+
+/* Identification *********************************************************/
+
+CCTAG_STAGE_BENCHMARK(collectCuts)
+{
+  if (!fixture.identificationFailure.empty())
+    return state.skip(fixture.identificationFailure);
+
+  const CCTag& marker = *fixture.marker;
+  const float beginSig = identification::signalBegin(fixture.params._nCrowns);
+  CutBatch cuts;
+  for (auto _ : state)
+  {
+    (void)_;
+    identification::collectCuts(cuts, fixture.gray, marker.rescaledOuterEllipse().center(),
+                                marker.rescaledOuterEllipsePoints(), fixture.params._sampleCutLength, beginSig);
+  }
+  state.setItemsProcessed(state.iterations() * marker.rescaledOuterEllipsePoints().size());
+}
+
+CCTAG_STAGE_BENCHMARK(costFunctionGlob)
+{
+  if (!fixture.identificationFailure.empty())
+    return state.skip(fixture.identificationFailure);
+
+  CutBatch cuts = fixture.rectifiedCuts;
+  for (auto _ : state)
+  {
+    (void)_;
+    bool flag = false;
+    const float residual = identification::costFunctionGlob(fixture.homography, cuts, fixture.gray, flag);
+    doNotOptimize(residual);
+  }
+  state.setItemsProcessed(state.iterations() * cuts.size());
+}
+
+CCTAG_STAGE_BENCHMARK(refineConicFamilyGlob)
+{
+  if (!fixture.identificationFailure.empty())
+    return state.skip(fixture.identificationFailure);
+
+  const numerical::geometry::Ellipse& ellipse = fixture.marker->rescaledOuterEllipse();
+  CutBatch cuts;
+  for (auto _ : state)
+  {
+    (void)_;
+    state.pauseTiming();
+    cuts = fixture.selectedCuts;
+    Eigen::Matrix3f homography = Eigen::Matrix3f::Identity();
+    Point2d<Eigen::Vector3f> center(ellipse.center());
+    float residual = 0;
+    std::size_t nEvaluations = 0;
+    state.resumeTiming();
+    identification::refineConicFamilyGlob(0, homography, center, cuts, fixture.gray,
+                                          nullptr, ellipse, fixture.params, nullptr, residual,
+                                          nEvaluations, fixture.debug);
+  }
+  state.setItemsProcessed(state.iterations());
+}
+
+CCTAG_STAGE_BENCHMARK(orazioDistanceRobust)
+{
+  if (!fixture.identificationFailure.empty())
+    return state.skip(fixture.identificationFailure);
+
+  const std::vector<std::vector<float>>& radiusRatios = fixture.bank.getMarkers();
+  std::vector<std::list<float>> vScore;
+  for (auto _ : state)
+  {
+    (void)_;
+    state.pauseTiming();
+    vScore.assign(radiusRatios.size(), std::list<float>());
+    state.resumeTiming();
+    const bool identified = identification::orazioDistanceRobust(vScore, radiusRatios, fixture.rectifiedCuts,
+                                                                  fixture.params._minIdentProba);
+    doNotOptimize(identified);
+  }
+  state.setItemsProcessed(state.iterations() * fixture.rectifiedCuts.size());
+}
+
+} // namespace
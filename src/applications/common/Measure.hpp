@@ -0,0 +1,44 @@
+/*
+ * Copyright 2016, Simula Research Laboratory
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+#pragma once
+
+// Measures shared by the applications timing the detection.
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+namespace cctag {
+namespace measure {
+
+/**
+ * @brief Reset the peak resident set size, so that the next peakRssKb() is
+ * the peak since now.
+ * @return false if the platform cannot reset it (only Linux can): the peak is
+ * then the one of the whole process
+ */
+bool resetPeakRss();
+
+/// @brief Peak resident set size in kB, 0 if it cannot be measured.
+std::size_t peakRssKb();
+
+/// @brief Nearest rank percentile, 0 for no values.
+template<typename T>
+T percentile(std::vector<T> values, double p)
+{
+  if (values.empty())
+    return 0;
+  const std::size_t rank = std::max<std::size_t>(std::size_t(std::ceil(p / 100. * values.size())), 1);
+  const auto nth = values.begin() + (std::min(rank, values.size()) - 1);
+  std::nth_element(values.begin(), nth, values.end());
+  return *nth;
+}
+
+} // namespace measure
+} // namespace cctag
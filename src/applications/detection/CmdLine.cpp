@@ -6,6 +6,7 @@
  * file, You can obtain one at http://mozilla.org/MPL/2.0/.
  */
 #include <getopt.h>
+#include <cstdlib>
 #include <iostream>
 #include <string>
 #include "CmdLine.hpp"
@@ -24,6 +25,13 @@ static const struct option longopts[] =
     {"bank",       required_argument, 0, 'b'},
     {"parameters", required_argument, 0, 'p'},
     {"output",     optional_argument, 0, 'o'},   
+    {"trace",      required_argument, 0, 0xd4 },
+    {"stats",      required_argument, 0, 0xd5 },
+    {"workers",    required_argument, 0, 0xd6 },
+    {"decoders",   required_argument, 0, 0xd7 },
+    {"prefetch",   required_argument, 0, 0xd8 },
+    {"latest-only", no_argument,      0, 0xd9 },
+    {"write-bank", required_argument, 0, 0xda },
 #ifdef WITH_CUDA
     {"sync",       no_argument,       0, 0xd0 },
     {"debug-dir",  required_argument, 0, 0xd1 },
@@ -39,6 +47,13 @@ CmdLine::CmdLine( )
     , _cctagBankFilename( "" )
     , _paramsFilename( "" )
     , _outputFolderName( "" )
+    , _traceFilename( "" )
+    , _statsFilename( "" )
+    , _writeBankFilename( "" )
+    , _workers( 0 )
+    , _decoders( 2 )
+    , _prefetch( 8 )
+    , _latestOnly( false )
 #ifdef WITH_CUDA
     , _switchSync( false )
     , _debugDir( "" )
@@ -70,6 +85,13 @@ bool CmdLine::parse( int argc, char* argv[] )
       case 'b'  : _cctagBankFilename = optarg; break;
       case 'p'  : _paramsFilename    = optarg; break;
       case 'o'  : _outputFolderName  = optarg; break;
+      case 0xd4 : _traceFilename     = optarg; break;
+      case 0xd5 : _statsFilename     = optarg; break;
+      case 0xd6 : _workers           = strtoul( optarg, NULL, 0 ); break;
+      case 0xd7 : _decoders          = strtoul( optarg, NULL, 0 ); break;
+      case 0xd8 : _prefetch          = strtoul( optarg, NULL, 0 ); break;
+      case 0xd9 : _latestOnly        = true;   break;
+      case 0xda : _writeBankFilename = optarg; break;
 #ifdef WITH_CUDA
       case 0xd0 : _switchSync        = true;   break;
       case 0xd1 : _debugDir          = optarg; break;
@@ -79,7 +101,8 @@ bool CmdLine::parse( int argc, char* argv[] )
       default : break;
     }
   }
-  return ( has_i && has_n );
+  // Writing the bank needs no input.
+  return ( ( has_i || !_writeBankFilename.empty() ) && has_n );
 }
 
 void CmdLine::print( const char* const argv0 )
@@ -90,6 +113,18 @@ void CmdLine::print( const char* const argv0 )
          << "    --bank      " << _cctagBankFilename << std::endl
          << "    --params    " << _paramsFilename << std::endl
          << "    --output    " << _outputFolderName << std::endl;
+    if( _traceFilename != "" )
+        std::cout << "    --trace     " << _traceFilename << std::endl;
+    if( _statsFilename != "" )
+        std::cout << "    --stats     " << _statsFilename << std::endl;
+    if( _workers != 0 )
+        std::cout << "    --workers   " << _workers << std::endl;
+    std::cout << "    --decoders  " << _decoders << std::endl
+              << "    --prefetch  " << _prefetch << std::endl;
+    if( _latestOnly )
+        std::cout << "    --latest-only" << std::endl;
+    if( _writeBankFilename != "" )
+        std::cout << "    --write-bank " << _writeBankFilename << std::endl;
 #ifdef WITH_CUDA
     if( _switchSync )
         std::cout << "    --sync " << std::endl;
@@ -111,6 +146,13 @@ void CmdLine::usage( const char* const argv0 )
           "           [-p|--params <confpath>]\n"
           "           [-b|--bank] <bankpath>\n"
           "           [-o|--output] <outputfoldername>\n"
+          "           [--trace <tracepath>]\n"
+          "           [--stats <statspath>]\n"
+          "           [--workers <n>]\n"
+          "           [--decoders <n>]\n"
+          "           [--prefetch <n>]\n"
+          "           [--latest-only]\n"
+          "           [--write-bank <binbankpath>]\n"
           "           [--sync]\n"
           "           [--debug-dir <debugdir>]\n"
           "           [--use-cuda]\n"
@@ -121,6 +163,14 @@ void CmdLine::usage( const char* const argv0 )
           "    <bankpath> - path to a bank parameter file, e.g. 4Crowns/ids.txt \n"
           "    <output>   - output folder name \n"
           "    <confpath> - path to configuration XML file \n"
+          "    <tracepath> - write the spans of the detection stages to this file (Chrome trace JSON)\n"
+          "    <statspath> - write the per frame and per level detection counters to this file (CSV)\n"
+          "    --workers  - detect <n> frames concurrently (default one per core)\n"
+          "    --decoders - decode the images of a folder on <n> threads (default 2)\n"
+          "    --prefetch - keep up to <n> decoded frames ahead of the detection (default 8)\n"
+          "    --latest-only - drop the oldest waiting frame instead of waiting (live cameras)\n"
+          "    <binbankpath> - write the bank (<bankpath> or the default one of <nbrings>) in the binary\n"
+          "                format to this file and exit, without detection; -i is then not required\n"
           "    --sync     - CUDA debug option, run all CUDA ops synchronously\n"
           "    <debugdir> - path storing image to debug intermediate GPU results\n"
           "    --use-cuda - select GPU code instead of CPU code\n"
@@ -7,6 +7,7 @@
  */
 #pragma once
 
+#include <cstddef>
 #include <string>
 
 namespace cctag {
@@ -19,6 +20,13 @@ public:
     std::string _paramsFilename;
     std::string _nCrowns;
     std::string _outputFolderName;
+    std::string _traceFilename;
+    std::string _statsFilename;
+    std::string _writeBankFilename;
+    std::size_t _workers;
+    std::size_t _decoders;
+    std::size_t _prefetch;
+    bool        _latestOnly;
 #ifdef WITH_CUDA
     bool        _switchSync;
     std::string _debugDir;
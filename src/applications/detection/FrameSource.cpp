@@ -0,0 +1,193 @@
+/*
+ * Copyright 2016, Simula Research Laboratory
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+#include "FrameSource.hpp"
+
+#include <opencv2/imgcodecs.hpp>
+
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+#include <utility>
+
+namespace cctag {
+
+FrameQueue::FrameQueue(std::size_t capacity, DropPolicy policy, std::function<void(std::size_t)> onDrop)
+  : _capacity(std::max<std::size_t>(capacity, 1))
+  , _policy(policy)
+  , _onDrop(std::move(onDrop))
+{
+}
+
+bool FrameQueue::push(Frame frame)
+{
+  std::size_t droppedId = 0;
+  bool drop = false;
+  {
+    std::unique_lock<std::mutex> lock(_mutex);
+    if (_policy == DropPolicy::Block)
+      _notFull.wait(lock, [this] { return _frames.size() < _capacity || _closed; });
+    if (_closed)
+      return false;
+    if (_frames.size() == _capacity)
+    {
+      droppedId = _frames.front().id;
+      drop = true;
+      _frames.pop_front();
+      ++_dropped;
+    }
+    _frames.push_back(std::move(frame));
+  }
+  _notEmpty.notify_one();
+  // Outside the lock: the callback may lock the consumers of the results.
+  if (drop && _onDrop)
+    _onDrop(droppedId);
+  return true;
+}
+
+bool FrameQueue::pop(Frame& frame)
+{
+  {
+    std::unique_lock<std::mutex> lock(_mutex);
+    _notEmpty.wait(lock, [this] { return !_frames.empty() || _closed; });
+    if (_frames.empty())
+      return false;
+    frame = std::move(_frames.front());
+    _frames.pop_front();
+  }
+  _notFull.notify_one();
+  return true;
+}
+
+void FrameQueue::close()
+{
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _closed = true;
+  }
+  _notEmpty.notify_all();
+  _notFull.notify_all();
+}
+
+void FrameQueue::abort()
+{
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _closed = true;
+    _frames.clear();
+  }
+  _notEmpty.notify_all();
+  _notFull.notify_all();
+}
+
+std::size_t FrameQueue::dropped() const
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+  return _dropped;
+}
+
+FrameSource::FrameSource(std::size_t capacity, DropPolicy policy, std::function<void(std::size_t)> onDrop)
+  : _queue(capacity, policy, std::move(onDrop))
+{
+}
+
+FrameSource::~FrameSource()
+{
+  stop();
+}
+
+void FrameSource::stop()
+{
+  _queue.abort();
+  for (std::thread& decoder : _decoders)
+  {
+    if (decoder.joinable())
+      decoder.join();
+  }
+}
+
+ImageFilesSource::ImageFilesSource(std::vector<boost::filesystem::path> files, std::size_t nDecoders,
+                                   std::size_t capacity)
+  : FrameSource(capacity, DropPolicy::Block, nullptr)
+  , _files(std::move(files))
+  , _nextFile(0)
+  , _runningDecoders(std::max<std::size_t>(nDecoders, 1))
+{
+  for (std::size_t i = 0, n = _runningDecoders; i < n; ++i)
+  {
+    _decoders.emplace_back([this]()
+    {
+      for (std::size_t iFile = _nextFile++; iFile < _files.size(); iFile = _nextFile++)
+      {
+        Frame frame;
+        frame.id = iFile;
+        frame.name = _files[iFile].stem().string();
+        // An unreadable file gives an empty image, still queued to keep the ids
+        // contiguous for the ordered output.
+        frame.image = cv::imread(_files[iFile].string(), cv::IMREAD_GRAYSCALE);
+        if (!_queue.push(std::move(frame)))
+          break;
+      }
+      if (--_runningDecoders == 0)
+        _queue.close();
+    });
+  }
+}
+
+ImageFilesSource::~ImageFilesSource()
+{
+  stop();
+}
+
+VideoSource::VideoSource(const std::string& filename, std::size_t capacity, DropPolicy policy,
+                         std::function<void(std::size_t)> onDrop)
+  : FrameSource(capacity, policy, std::move(onDrop))
+  , _video(filename)
+{
+  start();
+}
+
+VideoSource::VideoSource(int camera, std::size_t capacity, DropPolicy policy,
+                         std::function<void(std::size_t)> onDrop)
+  : FrameSource(capacity, policy, std::move(onDrop))
+  , _video(camera)
+{
+  start();
+}
+
+VideoSource::~VideoSource()
+{
+  stop();
+}
+
+void VideoSource::start()
+{
+  if (!_video.isOpened())
+  {
+    _queue.close();
+    return;
+  }
+
+  _decoders.emplace_back([this]()
+  {
+    for (std::size_t frameId = 0;; ++frameId)
+    {
+      Frame frame;
+      if (!_video.read(frame.image) || frame.image.empty())
+        break;
+      frame.id = frameId;
+      std::ostringstream name;
+      name << std::setfill('0') << std::setw(5) << frameId;
+      frame.name = name.str();
+      if (!_queue.push(std::move(frame)))
+        break;
+    }
+    _queue.close();
+  });
+}
+
+} // namespace cctag
@@ -0,0 +1,204 @@
+/*
+ * Copyright 2016, Simula Research Laboratory
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+#pragma once
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/videoio.hpp>
+
+#include <boost/filesystem.hpp>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace cctag {
+
+/**
+ * @brief A decoded frame and its position in the input.
+ */
+struct Frame
+{
+  std::size_t id = 0;
+  std::string name;  ///< stem of the image file, or zero padded frame number
+  cv::Mat image;     ///< as decoded: gray for the images, BGR for the videos
+};
+
+enum class DropPolicy
+{
+  Block,      ///< the decoders wait for room: every frame is processed
+  LatestOnly  ///< the oldest waiting frame is dropped: a live camera stays current
+};
+
+/**
+ * @brief Bounded queue of frames between the decoders and the detection workers.
+ */
+class FrameQueue
+{
+public:
+  /**
+   * @param onDrop called with the id of every frame dropped by the LatestOnly
+   * policy, so that the consumers of the results do not wait for it
+   */
+  FrameQueue(std::size_t capacity, DropPolicy policy, std::function<void(std::size_t)> onDrop = nullptr);
+
+  /// @return false once the queue is closed: the frame is not queued
+  bool push(Frame frame);
+
+  /// @return false once the queue is closed and empty
+  bool pop(Frame& frame);
+
+  /// End of the input: the frames already queued are still delivered.
+  void close();
+
+  /// Stop: the frames already queued are discarded.
+  void abort();
+
+  std::size_t dropped() const;
+
+private:
+  const std::size_t _capacity;
+  const DropPolicy _policy;
+  const std::function<void(std::size_t)> _onDrop;
+  mutable std::mutex _mutex;
+  std::condition_variable _notEmpty;
+  std::condition_variable _notFull;
+  std::deque<Frame> _frames;
+  std::size_t _dropped = 0;
+  bool _closed = false;
+};
+
+/**
+ * @brief Frames of an input, decoded ahead of the detection on threads of
+ * their own. Any number of workers can pull the frames as they get ready.
+ */
+class FrameSource
+{
+public:
+  virtual ~FrameSource();
+
+  /// @brief Next frame, callable from any thread. Not in id order when there
+  /// are several decoders.
+  /// @return false at the end of the input or after stop()
+  bool next(Frame& frame) { return _queue.pop(frame); }
+
+  /// @brief Stop decoding and release the workers waiting for a frame.
+  void stop();
+
+  /// @brief Number of frames dropped by the LatestOnly policy so far.
+  std::size_t dropped() const { return _queue.dropped(); }
+
+protected:
+  FrameSource(std::size_t capacity, DropPolicy policy, std::function<void(std::size_t)> onDrop);
+
+  FrameQueue _queue;
+  /// Started by the derived classes, which must stop() in their destructor
+  /// since the decoders use their members.
+  std::vector<std::thread> _decoders;
+};
+
+/**
+ * @brief Images of a list of files, decoded to gray by a pool of decoders
+ * taking the files in order. Frame i is the i-th file.
+ */
+class ImageFilesSource : public FrameSource
+{
+public:
+  ImageFilesSource(std::vector<boost::filesystem::path> files, std::size_t nDecoders, std::size_t capacity);
+  ~ImageFilesSource() override;
+
+private:
+  const std::vector<boost::filesystem::path> _files;
+  std::atomic<std::size_t> _nextFile;
+  std::atomic<std::size_t> _runningDecoders;
+};
+
+/**
+ * @brief Frames of a video file or of a camera, grabbed by a single thread
+ * since cv::VideoCapture is not thread safe.
+ */
+class VideoSource : public FrameSource
+{
+public:
+  VideoSource(const std::string& filename, std::size_t capacity, DropPolicy policy,
+              std::function<void(std::size_t)> onDrop = nullptr);
+  VideoSource(int camera, std::size_t capacity, DropPolicy policy,
+              std::function<void(std::size_t)> onDrop = nullptr);
+  ~VideoSource() override;
+
+  bool isOpened() const { return _video.isOpened(); }
+
+private:
+  void start();
+
+  cv::VideoCapture _video;
+};
+
+/**
+ * @brief Results put by concurrent workers in any order, popped in id order.
+ * Ids may be skipped (dropped frames); every id must be either put or skipped.
+ */
+template<typename T>
+class OrderedResults
+{
+public:
+  void put(std::size_t id, std::unique_ptr<T> result)
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _pending[id] = std::move(result);
+    _ready.notify_all();
+  }
+
+  void skip(std::size_t id) { put(id, nullptr); }
+
+  /// @brief No more results: pop() returns the pending ones, then false.
+  void close()
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _closed = true;
+    _ready.notify_all();
+  }
+
+  /// @brief Wait for the result following the last popped one.
+  /// @return false once closed and all the results popped
+  bool pop(std::unique_ptr<T>& result)
+  {
+    std::unique_lock<std::mutex> lock(_mutex);
+    while (true)
+    {
+      _ready.wait(lock, [this] {
+        return (!_pending.empty() && _pending.begin()->first == _next) || _closed;
+      });
+      if (_pending.empty())
+        return false;
+      // After close, an id neither put nor skipped is not waited for.
+      auto first = _pending.begin();
+      _next = first->first + 1;
+      result = std::move(first->second);
+      _pending.erase(first);
+      if (result)
+        return true;
+    }
+  }
+
+private:
+  std::mutex _mutex;
+  std::condition_variable _ready;
+  std::map<std::size_t, std::unique_ptr<T>> _pending;
+  std::size_t _next = 0;
+  bool _closed = false;
+};
+
+} // namespace cctag
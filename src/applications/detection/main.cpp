@@ -5,11 +5,12 @@
  * License, v. 2.0. If a copy of the MPL was not distributed with this
  * file, You can obtain one at http://mozilla.org/MPL/2.0/.
  */
-#include "cctag/utils/FileDebug.hpp"
-#include "cctag/utils/VisualDebug.hpp"
+#include "cctag/utils/DebugSink.hpp"
 #include "cctag/utils/Exceptions.hpp"
+#include "cctag/utils/Trace.hpp"
 #include "cctag/Detection.hpp"
 #include "CmdLine.hpp"
+#include "FrameSource.hpp"
 
 #ifdef WITH_CUDA
 #include "cctag/cuda/device_prop.hpp"
@@ -40,7 +41,12 @@
 #include <iostream>
 #include <string>
 #include <fstream>
+#include <algorithm>
+#include <atomic>
 #include <exception>
+#include <functional>
+#include <memory>
+#include <thread>
 
 #include <tbb/tbb.h>
 
@@ -51,6 +57,15 @@ using boost::timer;
 
 namespace bfs = boost::filesystem;
 
+// CSV output of the detection counters (--stats), written in frame order, and
+// the high-water marks of the edge point buffers over all the frames.
+static std::ofstream statsFile;
+static std::size_t edgePointsHighWater = 0;
+static std::size_t votersHighWater = 0;
+// Where the debug output of every detection goes (CCTAG_SERIALIZE builds).
+static bfs::path debugRootPath;
+static std::string debugOutputFolder;
+
 /**
  * @brief Check if a string is an integer number.
  * 
@@ -98,20 +113,22 @@ void drawMarkers(const boost::ptr_list<CCTag> &markers, cv::Mat &image)
  * 
  * @param[in] frameId The number of the frame.
  * @param[in] pipeId The pipe id (used for multiple streams).
- * @param[in] src The image to process.
+ * @param[in] src The image to process, gray or color.
  * @param[in] params The parameters for the detection.
  * @param[in] bank The marker bank.
  * @param[out] markers The list of detected markers.
+ * @param[out] stats The detection counters of the frame, if not null.
  * @param[out] outStream The output stream on which to write debug information.
  * @param[out] debugFileName The filename for the image to save with the detected 
  * markers.
  */
 void detection(std::size_t frameId,
                int pipeId,
-               const cv::Mat & src,
+               const ImageView & src,
                const cctag::Parameters & params,
                const cctag::CCTagMarkersBank & bank,
                boost::ptr_list<CCTag> &markers,
+               cctag::DetectionStats * stats,
                std::ostream & outStream,
                std::string debugFileName = "")
 {
@@ -124,24 +141,31 @@ void detection(std::size_t frameId,
   // Process markers detection
   boost::timer t;
 
-  CCTagVisualDebug::instance().initBackgroundImage(src);
-  CCTagVisualDebug::instance().setImageFileName(debugFileName);
-  CCTagFileDebug::instance().setPath(CCTagVisualDebug::instance().getPath());
+  // Every detection has a sink of its own: the frames are processed
+  // concurrently by the detection workers.
+  cctag::DebugSink debug;
+  debug.visual().initializeFolders(debugRootPath, debugOutputFolder, params._nCrowns);
+#ifdef CCTAG_SERIALIZE
+  // The debug images are drawn over the gray frame.
+  cv::Mat background;
+  src.copyLumaTo(background);
+  debug.visual().initBackgroundImage(background);
+#endif
+  debug.visual().setImageFileName(debugFileName);
+  debug.file().setPath(debug.visual().getPath());
 
   static cctag::logtime::Mgmt* durations = nullptr;
 
   //Call the main CCTag detection function
-  cctagDetection(markers, pipeId, frameId, src, params, bank, true, durations);
+  cctagDetection(markers, pipeId, frameId, src, params, bank, true, durations, stats, &debug);
 
   if(durations)
   {
     durations->print(std::cerr);
   }
 
-  CCTagFileDebug::instance().outPutAllSessions();
-  CCTagFileDebug::instance().clearSessions();
-  CCTagVisualDebug::instance().outPutAllSessions();
-  CCTagVisualDebug::instance().clearSessions();
+  debug.file().outPutAllSessions();
+  debug.visual().outPutAllSessions();
 
   std::cout << "Total time: " << t.elapsed() << std::endl;
   CCTAG_COUT_NOENDL("Id : ");
@@ -176,6 +200,90 @@ void detection(std::size_t frameId,
   std::cout << std::endl << nMarkers << " markers detected and identified" << std::endl;
 }
 
+/**
+ * @brief Append the counters of a frame to the --stats file. Only called from
+ * the main thread, in frame order.
+ */
+void writeStats(const cctag::DetectionStats & stats)
+{
+  stats.writeCsv(statsFile);
+  edgePointsHighWater = std::max(edgePointsHighWater, stats.edgePointsHighWater());
+  votersHighWater = std::max(votersHighWater, stats.votersHighWater());
+}
+
+/**
+ * @brief Detection of one frame, kept until its turn to be output.
+ */
+struct FrameResult
+{
+  Frame frame;
+  boost::ptr_list<CCTag> markers;
+  cctag::DetectionStats stats;
+  std::string output; ///< what detection() wrote for the frame
+};
+
+/**
+ * @brief Detect the markers of the frames of a source on nWorkers threads,
+ * each pulling the next decoded frame as soon as it is done with the previous
+ * one, and hand the results over to emit in frame order on the calling thread.
+ * The --stats rows are written there too, in the same order.
+ * 
+ * @param[in] source The decoded frames.
+ * @param[in] results Where the workers put the results, shared with the drop
+ * policy of the source.
+ * @param[in] nWorkers The number of frames detected concurrently; worker i uses pipe i.
+ * @param[in] emit Called with every result in frame order; returns false to stop.
+ */
+void detectFrames(FrameSource & source,
+                  OrderedResults<FrameResult> & results,
+                  std::size_t nWorkers,
+                  const cctag::Parameters & params,
+                  const cctag::CCTagMarkersBank & bank,
+                  const std::function<bool(FrameResult &)> & emit)
+{
+  const bool withStats = statsFile.is_open();
+  std::atomic<std::size_t> runningWorkers(nWorkers);
+  std::vector<std::thread> workers;
+  for(std::size_t iWorker = 0; iWorker < nWorkers; ++iWorker)
+  {
+    workers.emplace_back([&, iWorker]()
+    {
+      Frame frame;
+      while(source.next(frame))
+      {
+        std::unique_ptr<FrameResult> result(new FrameResult);
+        if(!frame.image.empty())
+        {
+          // A color frame is converted straight into the first pyramid level.
+          std::ostringstream output;
+          detection(frame.id, int(iWorker), ImageView(frame.image), params, bank, result->markers,
+                    withStats ? &result->stats : nullptr, output, frame.name);
+          result->output = output.str();
+        }
+        const std::size_t frameId = frame.id;
+        result->frame = std::move(frame);
+        results.put(frameId, std::move(result));
+      }
+      if(--runningWorkers == 0)
+        results.close();
+    });
+  }
+
+  std::unique_ptr<FrameResult> result;
+  while(results.pop(result))
+  {
+    if(withStats && !result->frame.image.empty())
+      writeStats(result->stats);
+    if(!emit(*result))
+      break;
+  }
+
+  // The workers finish their current frame and find no next one.
+  source.stop();
+  for(std::thread & worker : workers)
+    worker.join();
+}
+
 /*************************************************************/
 /*                    Main entry                             */
 
@@ -191,6 +299,19 @@ int main(int argc, char** argv)
   }
 
   cmdline.print(argv[0]);
+
+  // Convert the bank to the binary format, which is mapped instead of parsed
+  // when it is loaded.
+  if(!cmdline._writeBankFilename.empty())
+  {
+    const std::size_t nCrowns = std::atoi(cmdline._nCrowns.c_str());
+    const CCTagMarkersBank bank = cmdline._cctagBankFilename.empty()
+      ? CCTagMarkersBank(nCrowns) : CCTagMarkersBank(cmdline._cctagBankFilename);
+    bank.writeBinary(cmdline._writeBankFilename);
+    std::cout << "Wrote the bank of " << bank.getMarkers().size() << " markers to "
+              << cmdline._writeBankFilename << std::endl;
+    return EXIT_SUCCESS;
+  }
   
   bool useCamera = false;
 
@@ -264,6 +385,14 @@ int main(int argc, char** argv)
     bank = CCTagMarkersBank(cmdline._cctagBankFilename);
   }
 
+  cctag::trace::setEnabled(!cmdline._traceFilename.empty());
+
+  if(!cmdline._statsFilename.empty())
+  {
+    statsFile.open(cmdline._statsFilename);
+    cctag::DetectionStats::writeCsvHeader(statsFile);
+  }
+
 #ifdef WITH_CUDA
   if(cmdline._useCuda)
   {
@@ -282,6 +411,15 @@ int main(int argc, char** argv)
   cctag::device_prop_t deviceInfo(false);
 #endif // WITH_CUDA
 
+  // Every worker detects on a pipe of its own, and there are only as many CUDA
+  // pipes as requested.
+  std::size_t nWorkers = cmdline._workers != 0 ? cmdline._workers
+                                               : std::max(std::thread::hardware_concurrency(), 1u);
+#ifdef WITH_CUDA
+  if(cmdline._useCuda)
+    nWorkers = std::min<std::size_t>(nWorkers, std::max(cmdline._parallel, 1));
+#endif // WITH_CUDA
+
   bfs::path myPath(bfs::absolute(cmdline._filename));
   std::string ext(myPath.extension().string());
   boost::algorithm::to_lower(ext);
@@ -290,16 +428,24 @@ int main(int argc, char** argv)
   std::string outputFileName;
   if(!bfs::is_directory(myPath))
   {
-    CCTagVisualDebug::instance().initializeFolders(parentPath, cmdline._outputFolderName, params._nCrowns);
+    debugRootPath = parentPath;
     outputFileName = parentPath.string() + "/" + cmdline._outputFolderName + "/cctag" + std::to_string(nCrowns) + "CC.out";
   }
   else
   {
-    CCTagVisualDebug::instance().initializeFolders(myPath, cmdline._outputFolderName, params._nCrowns);
+    debugRootPath = myPath;
     outputFileName = myPath.string() + "/" + cmdline._outputFolderName + "/cctag" + std::to_string(nCrowns) + "CC.out";
   }
+  debugOutputFolder = cmdline._outputFolderName;
+  // Create the debug folders before the output file is opened in them.
+  cctag::DebugSink().visual().initializeFolders(debugRootPath, debugOutputFolder, params._nCrowns);
   std::ofstream outputFile;
   outputFile.open(outputFileName);
+#ifdef PRINT_TO_CERR
+  std::ostream & resultStream = std::cerr;
+#else
+  std::ostream & resultStream = outputFile;
+#endif
 
 #if USE_DEVIL
   if( (ext == ".bmp") ||
@@ -336,11 +482,15 @@ int main(int argc, char** argv)
 
     const int pipeId = 0;
     boost::ptr_list<CCTag> markers;
+    cctag::DetectionStats stats;
+    cctag::DetectionStats * pStats = statsFile.is_open() ? &stats : nullptr;
 #ifdef PRINT_TO_CERR
-    detection(0, pipeId, graySrc, params, bank, markers, std::cerr, myPath.stem().string());
+    detection(0, pipeId, ImageView(graySrc), params, bank, markers, pStats, std::cerr, myPath.stem().string());
 #else // PRINT_TO_CERR
-    detection(0, pipeId, graySrc, params, bank, markers, outputFile, myPath.stem().string());
+    detection(0, pipeId, ImageView(graySrc), params, bank, markers, pStats, outputFile, myPath.stem().string());
 #endif // PRINT_TO_CERR
+    if(pStats)
+      writeStats(stats);
   }
 #else // USE_DEVIL
   if((ext == ".png") || (ext == ".jpg"))
@@ -350,18 +500,20 @@ int main(int argc, char** argv)
 
     POP_INFO("looking at image " << myPath.string());
 
-    // Gray scale conversion
-    cv::Mat src = cv::imread(cmdline._filename);
-    cv::Mat graySrc;
-    cv::cvtColor(src, graySrc, CV_BGR2GRAY);
+    // Gray scale conversion, done by the decoder
+    cv::Mat graySrc = cv::imread(cmdline._filename, cv::IMREAD_GRAYSCALE);
 
     const int pipeId = 0;
     boost::ptr_list<CCTag> markers;
+    cctag::DetectionStats stats;
+    cctag::DetectionStats * pStats = statsFile.is_open() ? &stats : nullptr;
 #ifdef PRINT_TO_CERR
-    detection(0, pipeId, graySrc, params, bank, markers, std::cerr, myPath.stem().string());
+    detection(0, pipeId, ImageView(graySrc), params, bank, markers, pStats, std::cerr, myPath.stem().string());
 #else // PRINT_TO_CERR
-    detection(0, pipeId, graySrc, params, bank, markers, outputFile, myPath.stem().string());
+    detection(0, pipeId, ImageView(graySrc), params, bank, markers, pStats, outputFile, myPath.stem().string());
 #endif // PRINT_TO_CERR
+    if(pStats)
+      writeStats(stats);
   }
 #endif // USE_DEVIL
   else if(ext == ".avi" || ext == ".mov" || useCamera)
@@ -369,14 +521,18 @@ int main(int argc, char** argv)
     CCTAG_COUT("*** Video mode ***");
     POP_INFO("looking at video " << myPath.string());
 
-    // open video and check
-    cv::VideoCapture video;
+    // A live camera keeps producing frames while they are detected: with
+    // --latest-only the frames the workers cannot keep up with are dropped.
+    OrderedResults<FrameResult> results;
+    const DropPolicy policy = cmdline._latestOnly ? DropPolicy::LatestOnly : DropPolicy::Block;
+    const auto onDrop = [&results](std::size_t frameId) { results.skip(frameId); };
+    std::unique_ptr<VideoSource> video;
     if(useCamera)
-      video.open(std::atoi(cmdline._filename.c_str()));
+      video.reset(new VideoSource(std::atoi(cmdline._filename.c_str()), cmdline._prefetch, policy, onDrop));
     else
-      video.open(cmdline._filename);
+      video.reset(new VideoSource(cmdline._filename, cmdline._prefetch, policy, onDrop));
     
-    if(!video.isOpened())
+    if(!video->isOpened())
     {
       CCTAG_COUT("Unable to open the video : " << cmdline._filename);
       return EXIT_FAILURE;
@@ -386,64 +542,38 @@ int main(int argc, char** argv)
     cv::namedWindow(windowName, cv::WINDOW_NORMAL);
 
     std::cerr << "Starting to read video frames" << std::endl;
-    std::size_t frameId = 0;
     
     // time to wait in milliseconds for keyboard input, used to switch from
     // live to debug mode
     int delay = 10;
 
-    while(true)
+    // The window is only updated from the main thread.
+    detectFrames(*video, results, nWorkers, params, bank, [&](FrameResult & result)
     {
-      cv::Mat frame;
-      video >> frame;
-      if(frame.empty())
-        break;
-      
-      cv::Mat imgGray;
-
-      if(frame.channels() == 3 || frame.channels() == 4)
-        cv::cvtColor(frame, imgGray, cv::COLOR_BGR2GRAY);
-      else
-        frame.copyTo(imgGray);
-
-      // Set the output folder
-      std::stringstream outFileName;
-      outFileName << std::setfill('0') << std::setw(5) << frameId;
-      
-      boost::ptr_list<CCTag> markers;
+      resultStream << result.output;
 
-      // Invert the image for the projection scenario
-      //cv::Mat imgGrayInverted;
-      //bitwise_not ( imgGray, imgGrayInverted );
-
-      // Call the CCTag detection
-      const int pipeId = 0;
-#ifdef PRINT_TO_CERR
-      detection(frameId, pipeId, imgGray, params, bank, markers, std::cerr, outFileName.str());
-#else
-      detection(frameId, pipeId, imgGray, params, bank, markers, outputFile, outFileName.str());
-#endif
-      
+      cv::Mat & frame = result.frame.image;
       // if the original image is b/w convert it to BGRA so we can draw colors
       if(frame.channels() == 1)
-        cv::cvtColor(imgGray, frame, cv::COLOR_GRAY2BGRA);
+        cv::cvtColor(frame, frame, cv::COLOR_GRAY2BGRA);
       
-      drawMarkers(markers, frame);
+      drawMarkers(result.markers, frame);
       cv::imshow(windowName, frame);
-      if( cv::waitKey(delay) == 27 ) break;
+      if( cv::waitKey(delay) == 27 ) return false;
       char key = (char) cv::waitKey(delay);
       // stop capturing by pressing ESC
       if(key == 27) 
-        break;
+        return false;
       if(key == 'l' || key == 'L')
         delay = 10;
       // delay = 0 will wait for a key to be pressed
       if(key == 'd' || key == 'D')
         delay = 0;
-      
-      ++frameId;
-    }
+      return true;
+    });
 
+    if(video->dropped() != 0)
+      std::cerr << video->dropped() << " frames dropped" << std::endl;
   }
   else if(bfs::is_directory(myPath))
   {
@@ -454,43 +584,28 @@ int main(int argc, char** argv)
     std::copy(bfs::directory_iterator(myPath), bfs::directory_iterator(), std::back_inserter(vFileInFolder)); // is directory_entry, which is
     std::sort(vFileInFolder.begin(), vFileInFolder.end());
 
-    std::size_t frameId = 0;
-
-    std::map<int, bfs::path> files[2];
+    // The frame ids are the ranks of the images among the files of the folder.
+    std::vector<bfs::path> images;
     for(const auto & fileInFolder : vFileInFolder)
     {
-      files[frameId & 1].insert(std::pair<int, bfs::path>(frameId, fileInFolder));
-      frameId++;
+      const std::string subExt(bfs::extension(fileInFolder));
+      if((subExt == ".png") || (subExt == ".jpg") || (subExt == ".PNG") || (subExt == ".JPG"))
+        images.push_back(fileInFolder);
     }
 
-    tbb::parallel_for(0, 2, [&](size_t fileListIdx)
+    // The images are decoded while the previous ones are detected, and every
+    // worker takes the next image as soon as it is free.
+    OrderedResults<FrameResult> results;
+    ImageFilesSource source(images, cmdline._decoders, cmdline._prefetch);
+    detectFrames(source, results, nWorkers, params, bank, [&](FrameResult & result)
     {
-      for(const auto & fileInFolder : files[fileListIdx])
-      {
-        const std::string subExt(bfs::extension(fileInFolder.second));
-
-        if((subExt == ".png") || (subExt == ".jpg") || (subExt == ".PNG") || (subExt == ".JPG"))
-        {
-
-          std::cerr << "Processing image " << fileInFolder.second.string() << std::endl;
-
-          cv::Mat src;
-          src = cv::imread(fileInFolder.second.string());
-
-          cv::Mat imgGray;
-          cv::cvtColor(src, imgGray, CV_BGR2GRAY);
-
-          // Call the CCTag detection
-          int pipeId = (fileInFolder.first & 1);
-          boost::ptr_list<CCTag> markers;
-#ifdef PRINT_TO_CERR
-          detection(fileInFolder.first, pipeId, imgGray, params, bank, markers, std::cerr, fileInFolder.second.stem().string());
-#else
-          detection(fileInFolder.first, pipeId, imgGray, params, bank, markers, outputFile, fileInFolder.second.stem().string());
-#endif
-          std::cerr << "Done processing image " << fileInFolder.second.string() << std::endl;
-        }
-      }
+      const bfs::path & image = images[result.frame.id];
+      if(result.frame.image.empty())
+        std::cerr << "Could not read image " << image.string() << std::endl;
+      else
+        std::cerr << "Done processing image " << image.string() << std::endl;
+      resultStream << result.output;
+      return true;
     });
   }
   else
@@ -499,6 +614,23 @@ int main(int argc, char** argv)
     throw std::logic_error("Unrecognized input.");
   }
   outputFile.close();
+
+  if(statsFile.is_open())
+  {
+    statsFile.close();
+    std::cout << "Statistics written to " << cmdline._statsFilename << std::endl
+              << "Edge points high-water mark: " << edgePointsHighWater
+              << " / " << EdgePointCollection::MAX_POINTS << std::endl
+              << "Voters high-water mark: " << votersHighWater
+              << " / " << EdgePointCollection::MAX_VOTERLIST_SIZE << std::endl;
+  }
+
+  if(cctag::trace::enabled())
+  {
+    std::ofstream traceFile(cmdline._traceFilename);
+    cctag::trace::writeChromeTrace(traceFile);
+    std::cout << "Trace written to " << cmdline._traceFilename << std::endl;
+  }
   return EXIT_SUCCESS;
 }
 
@@ -6,16 +6,30 @@
  * file, You can obtain one at http://mozilla.org/MPL/2.0/.
  */
 #include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <mutex>
+#include <tbb/global_control.h>
+#include <tbb/parallel_for.h>
+#include <tbb/task_arena.h>
 #include "Regression.h"
+#include "../common/Measure.hpp"
 
 static void RemoveAllFiles(const boost::filesystem::path& dirPath);
 static std::vector<boost::filesystem::path> CollectFiles(const boost::filesystem::path& dirPath);
 static bool SortTags(FrameLog& log);
+static void AddRunTimes(std::vector<float>& runTimes, const std::vector<float>& frameTimes);
+static double MannWhitneyPValue(const std::vector<float>& reference, const std::vector<float>& test);
+
+// Fewer timed runs per file than this are not enough for a significance test.
+static const size_t MinRunCount = 5;
 
 /////////////////////////////////////////////////////////////////////////////
 
-TestRunner::TestRunner(const std::string& inputDir, const std::string& outputDir, boost::optional<bool> useCuda) :
-  _inputDirPath(inputDir), _outputDirPath(outputDir), _useCuda(useCuda)
+TestRunner::TestRunner(const std::string& inputDir, const std::string& outputDir, boost::optional<bool> useCuda,
+  const TimingOptions& timing, bool accuracyOnly) :
+  _inputDirPath(inputDir), _outputDirPath(outputDir), _useCuda(useCuda),
+  _timing(accuracyOnly ? TimingOptions() : timing), _accuracyOnly(accuracyOnly)
 {
   if (!exists(_inputDirPath) || !is_directory(_inputDirPath))
     throw std::runtime_error("TestRunner: inputDir is not a directory");
@@ -31,41 +45,63 @@ void TestRunner::adjustParameters(cctag::Parameters& parameters)
     parameters._useCuda = *_useCuda;
 }
 
+// Timed files run one at a time, so that they do not slow each other down.
+template<typename F>
+void TestRunner::forEachFile(const std::vector<boost::filesystem::path>& filePaths, F process)
+{
+  std::mutex logMutex;
+  const size_t count = filePaths.size();
+  const auto body = [&](size_t i) {
+    {
+      std::lock_guard<std::mutex> lock(logMutex);
+      std::clog << "Processing file " << i + 1 << "/" << count << ": " << filePaths[i] << std::endl;
+    }
+    process(filePaths[i]);
+  };
+  
+  if (_accuracyOnly)
+    tbb::parallel_for(size_t(0), count, body);
+  else
+    for (size_t i = 0; i < count; ++i)
+      body(i);
+}
+
 // Input directory must contain images.
 // NB! parameters is by-val since we may need to adjust them.
 void TestRunner::generateReferenceResults(cctag::Parameters parameters)
 {
   adjustParameters(parameters);
-  size_t i = 1, count = _inputFilePaths.size();
-  for (const auto& inputFilePath: _inputFilePaths) {
-    std::clog << "Processing file " << i++ << "/" << count << ": " << inputFilePath << std::endl;
-    FileLog fileLog = FileLog::detect(inputFilePath.native(), parameters);
+  forEachFile(_inputFilePaths, [&](const boost::filesystem::path& inputFilePath) {
+    FileLog fileLog = FileLog::detect(inputFilePath.native(), parameters, _timing);
     auto outputPath = _outputDirPath / inputFilePath.filename().replace_extension(".xml");
     fileLog.save(outputPath.native());
-  }
+  });
 }
 
 // Input directory must contain XML files; parameters and input file will be read from those.
 void TestRunner::generateTestResults()
 {
-  size_t i = 1, count = _inputFilePaths.size();
-  for (const auto& inputFilePath: _inputFilePaths)
-  if (inputFilePath.extension() == ".xml") {
-    std::clog << "Processing file " << i++ << "/" << count << ": " << inputFilePath << std::endl;
+  std::vector<boost::filesystem::path> xmlFilePaths;
+  std::copy_if(_inputFilePaths.begin(), _inputFilePaths.end(), std::back_inserter(xmlFilePaths),
+    [](const boost::filesystem::path& p) { return p.extension() == ".xml"; });
+  
+  forEachFile(xmlFilePaths, [&](const boost::filesystem::path& inputFilePath) {
     FileLog fileLog;
     fileLog.load(inputFilePath.native());
     adjustParameters(fileLog.parameters);
-    fileLog = FileLog::detect(fileLog.filename, fileLog.parameters);
+    fileLog = FileLog::detect(fileLog.filename, fileLog.parameters, _timing);
     auto outputPath = _outputDirPath / inputFilePath.filename();
     fileLog.save(outputPath.native());
-  }
+  });
 }
 
 /////////////////////////////////////////////////////////////////////////////
 // TestChecker assumption: all IDs in the frame are different.
 
-TestChecker::TestChecker(const std::string& referenceDir, const std::string& testDir, float epsilon) :
-  _referenceDirPath(referenceDir), _testDirPath(testDir), _epsilon(epsilon), _failed(false)
+TestChecker::TestChecker(const std::string& referenceDir, const std::string& testDir, float epsilon,
+  const PerformanceTolerance& tolerance) :
+  _referenceDirPath(referenceDir), _testDirPath(testDir), _epsilon(epsilon), _tolerance(tolerance),
+  _failed(false), _performanceRegressed(false)
 {
   if (!exists(_referenceDirPath) || !is_directory(_referenceDirPath))
     throw std::runtime_error("TestChecker: referenceDir is not a directory");
@@ -108,9 +144,78 @@ void TestChecker::check(const boost::filesystem::path& testFilePath)
   FileLog referenceLog, testLog;
   referenceLog.load(referenceFilePath.native());
   testLog.load(testFilePath.native());
+  comparePerformance(referenceLog, testLog);
   compare(referenceLog, testLog);
 }
 
+// Compares the timed runs of the file, and the peak memory. Every frame is
+// detected the same number of times: the i-th run of the file is the i-th run
+// of all its frames, and its time their sum. The runs of different frames are
+// not pooled, as the spread between the frames would hide the one between the
+// runs. A slower median time is a regression only if the Mann-Whitney U test
+// finds it significant; the stage times are reported to locate it.
+void TestChecker::comparePerformance(const FileLog& referenceLog, const FileLog& testLog)
+{
+  std::vector<float> referenceTimes, testTimes;
+  std::map<std::string, std::pair<std::vector<float>, std::vector<float>>> stageTimes;
+  for (const auto& frameLog: referenceLog.frameLogs) {
+    AddRunTimes(referenceTimes, frameLog.elapsedTimes);
+    for (const auto& stage: frameLog.stageTimes)
+      AddRunTimes(stageTimes[stage.first].first, stage.second);
+  }
+  for (const auto& frameLog: testLog.frameLogs) {
+    AddRunTimes(testTimes, frameLog.elapsedTimes);
+    for (const auto& stage: frameLog.stageTimes)
+      AddRunTimes(stageTimes[stage.first].second, stage.second);
+  }
+  
+  const auto printPercentiles = [](const std::vector<float>& times) {
+    std::clog << std::fixed << std::setprecision(2)
+      << cctag::measure::percentile(times, 50) * 1e3f << "/" << cctag::measure::percentile(times, 95) * 1e3f
+      << "/" << cctag::measure::percentile(times, 99) * 1e3f;
+  };
+  
+  if (!referenceTimes.empty() && !testTimes.empty()) {
+    const float change = cctag::measure::percentile(testTimes, 50) / cctag::measure::percentile(referenceTimes, 50) - 1;
+    const double pValue = MannWhitneyPValue(referenceTimes, testTimes);
+    std::clog << "  time p50/p95/p99 (ms), reference ";
+    printPercentiles(referenceTimes);
+    std::clog << " (" << referenceTimes.size() << " runs), test ";
+    printPercentiles(testTimes);
+    std::clog << " (" << testTimes.size() << " runs), p=" << std::setprecision(4) << pValue << std::endl;
+    
+    for (const auto& stage: stageTimes) {
+      if (stage.second.first.empty() || stage.second.second.empty())
+        continue;
+      std::clog << "    " << std::left << std::setw(28) << stage.first << std::right << "reference ";
+      printPercentiles(stage.second.first);
+      std::clog << ", test ";
+      printPercentiles(stage.second.second);
+      std::clog << std::endl;
+    }
+    
+    if (change > _tolerance.time) {
+      const bool enoughRuns = referenceTimes.size() >= MinRunCount && testTimes.size() >= MinRunCount;
+      std::clog << "  " << (enoughRuns && pValue < _tolerance.significance ? "REGRESSION" : "warning")
+        << ": median time +" << std::setprecision(1) << change * 100 << "%";
+      if (!enoughRuns)
+        std::clog << ", too few runs for a significance test";
+      std::clog << std::endl;
+      _performanceRegressed |= enoughRuns && pValue < _tolerance.significance;
+    }
+  }
+  
+  if (referenceLog.peakRssKb && testLog.peakRssKb) {
+    const float change = float(testLog.peakRssKb) / referenceLog.peakRssKb - 1;
+    std::clog << "  peak RSS (MB), reference " << std::fixed << std::setprecision(1) << referenceLog.peakRssKb / 1024.f
+      << ", test " << testLog.peakRssKb / 1024.f << std::endl;
+    if (change > _tolerance.memory) {
+      std::clog << "  REGRESSION: peak RSS +" << change * 100 << "%" << std::endl;
+      _performanceRegressed = true;
+    }
+  }
+}
+
 void TestChecker::compare(FileLog& referenceLog, FileLog& testLog)
 {
   const auto frameOrdCmp = [](const FrameLog& f1, const FrameLog& f2) { return f1.frame < f2.frame; };
@@ -171,6 +276,137 @@ void TestChecker::compare(const DetectedTag& referenceTag, const DetectedTag& te
 
 /////////////////////////////////////////////////////////////////////////////
 
+ThreadCountChecker::ThreadCountChecker(const std::string& inputDir) :
+  _inputDirPath(inputDir), _failed(false)
+{
+  if (!exists(_inputDirPath) || !is_directory(_inputDirPath))
+    throw std::runtime_error("ThreadCountChecker: inputDir is not a directory");
+  _inputFilePaths = CollectFiles(_inputDirPath);
+}
+
+// NB! parameters is by-val since the deterministic mode is forced.
+bool ThreadCountChecker::check(cctag::Parameters parameters, const std::vector<int>& threadCounts)
+{
+  parameters._deterministic = true;
+
+  // Without raising the soft limit of TBB, an arena gets no more threads than
+  // the machine has cores, whatever it is asked for.
+  const int maxThreadCount = *std::max_element(threadCounts.begin(), threadCounts.end());
+  tbb::global_control parallelism(tbb::global_control::max_allowed_parallelism, maxThreadCount);
+  
+  size_t i = 1, count = _inputFilePaths.size();
+  for (const auto& inputFilePath: _inputFilePaths)
+  if (FileLog::isSupportedFormat(inputFilePath.native())) {
+    std::clog << "Processing file " << i++ << "/" << count << ": " << inputFilePath << std::endl;
+    
+    FileLog referenceLog;
+    for (int threadCount: threadCounts) {
+      FileLog fileLog;
+      tbb::task_arena arena(threadCount);
+      int concurrency = 0;
+      arena.execute([&]() {
+        concurrency = tbb::this_task_arena::max_concurrency();
+        fileLog = FileLog::detect(inputFilePath.native(), parameters);
+      });
+      std::clog << "  " << threadCount << " threads requested: arena concurrency " << concurrency
+        << ", allowed parallelism "
+        << tbb::global_control::active_value(tbb::global_control::max_allowed_parallelism) << std::endl;
+      
+      if (threadCount == threadCounts.front()) {
+        referenceLog = fileLog;
+      }
+      else if (!identical(referenceLog, fileLog)) {
+        std::clog << "  FAILED: results with " << threadCount << " threads differ from results with "
+          << threadCounts.front() << " thread(s)" << std::endl;
+        _failed = true;
+      }
+    }
+  }
+  return !_failed;
+}
+
+// Tags must be the same and in the same order; no tolerance.
+bool ThreadCountChecker::identical(const FileLog& referenceLog, const FileLog& testLog)
+{
+  if (referenceLog.frameLogs.size() != testLog.frameLogs.size())
+    return false;
+  
+  const size_t frameCount = referenceLog.frameLogs.size();
+  for (size_t i = 0; i < frameCount; ++i) {
+    const auto& referenceTags = referenceLog.frameLogs[i].tags;
+    const auto& testTags = testLog.frameLogs[i].tags;
+    const bool same = referenceTags.size() == testTags.size() &&
+      std::equal(referenceTags.begin(), referenceTags.end(), testTags.begin(),
+      [](const DetectedTag& t1, const DetectedTag& t2) {
+        return t1.id == t2.id && t1.status == t2.status && t1.x == t2.x && t1.y == t2.y && t1.quality == t2.quality;
+      });
+    if (!same)
+      return false;
+  }
+  return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
+SampleScheduleChecker::SampleScheduleChecker(const std::string& inputDir) :
+  _inputDirPath(inputDir), _mismatchCount(0)
+{
+  if (!exists(_inputDirPath) || !is_directory(_inputDirPath))
+    throw std::runtime_error("SampleScheduleChecker: inputDir is not a directory");
+  _inputFilePaths = CollectFiles(_inputDirPath);
+}
+
+// NB! parameters is by-val since the full length run overrides the schedule.
+void SampleScheduleChecker::check(cctag::Parameters parameters)
+{
+  cctag::Parameters fullParameters = parameters;
+  fullParameters._imagedCenterMinSampleCutLength = fullParameters._sampleCutLength;
+  
+  size_t i = 1, count = _inputFilePaths.size();
+  for (const auto& inputFilePath: _inputFilePaths)
+  if (FileLog::isSupportedFormat(inputFilePath.native())) {
+    std::clog << "Processing file " << i++ << "/" << count << ": " << inputFilePath << std::endl;
+    FileLog fullLog = FileLog::detect(inputFilePath.native(), fullParameters);
+    FileLog scheduledLog = FileLog::detect(inputFilePath.native(), parameters);
+    
+    const size_t frameCount = std::min(fullLog.frameLogs.size(), scheduledLog.frameLogs.size());
+    for (size_t frame = 0; frame < frameCount; ++frame)
+      compare(fullLog.frameLogs[frame], scheduledLog.frameLogs[frame]);
+  }
+}
+
+void SampleScheduleChecker::compare(FrameLog& fullLog, FrameLog& scheduledLog)
+{
+  _fullElapsedAcc(fullLog.elapsedTime);
+  _scheduledElapsedAcc(scheduledLog.elapsedTime);
+  
+  // Duplicate IDs are not expected here, their tags are compared in order anyway.
+  SortTags(fullLog);
+  SortTags(scheduledLog);
+  
+  auto itFull = fullLog.tags.begin();
+  auto itScheduled = scheduledLog.tags.begin();
+  while (itFull != fullLog.tags.end() && itScheduled != scheduledLog.tags.end()) {
+    if (itFull->id < itScheduled->id) {
+      ++_mismatchCount;
+      ++itFull;
+    }
+    else if (itScheduled->id < itFull->id) {
+      ++_mismatchCount;
+      ++itScheduled;
+    }
+    else {
+      _displacementAcc(std::hypot(itFull->x - itScheduled->x, itFull->y - itScheduled->y));
+      ++itFull;
+      ++itScheduled;
+    }
+  }
+  _mismatchCount += std::distance(itFull, fullLog.tags.end());
+  _mismatchCount += std::distance(itScheduled, scheduledLog.tags.end());
+}
+
+/////////////////////////////////////////////////////////////////////////////
+
 static void RemoveAllFiles(const boost::filesystem::path& dirPath)
 {
   using namespace boost::filesystem;
@@ -193,6 +429,51 @@ static std::vector<boost::filesystem::path> CollectFiles(const boost::filesystem
   return filePaths;
 }
 
+// Adds the times of the runs of a frame to the times of the runs of the file.
+// A stage that does not run in every run of a frame (e.g. no candidate to
+// identify) has fewer times: they are added to the first runs, which is close
+// enough to locate a regression.
+static void AddRunTimes(std::vector<float>& runTimes, const std::vector<float>& frameTimes)
+{
+  if (runTimes.size() < frameTimes.size())
+    runTimes.resize(frameTimes.size(), 0.f);
+  for (size_t i = 0; i < frameTimes.size(); ++i)
+    runTimes[i] += frameTimes[i];
+}
+
+// One-sided Mann-Whitney U test, with the normal approximation and mid-ranks
+// for ties: probability of test times at least this much larger than the
+// reference times if both came from the same distribution.
+static double MannWhitneyPValue(const std::vector<float>& reference, const std::vector<float>& test)
+{
+  std::vector<std::pair<float, bool>> all;  // time, is test
+  for (float t: reference)
+    all.emplace_back(t, false);
+  for (float t: test)
+    all.emplace_back(t, true);
+  std::sort(all.begin(), all.end());
+  
+  double testRankSum = 0;
+  for (size_t i = 0; i < all.size();) {
+    size_t j = i;
+    while (j < all.size() && all[j].first == all[i].first)
+      ++j;
+    const double midRank = (i + 1 + j) / 2.0;
+    for (size_t k = i; k < j; ++k)
+      if (all[k].second)
+        testRankSum += midRank;
+    i = j;
+  }
+  
+  const double n1 = reference.size(), n2 = test.size();
+  const double u = testRankSum - n2 * (n2 + 1) / 2;
+  const double sigma = std::sqrt(n1 * n2 * (n1 + n2 + 1) / 12);
+  if (sigma == 0)
+    return 1;
+  const double z = (u - n1 * n2 / 2) / sigma;
+  return 0.5 * std::erfc(z / std::sqrt(2.0));
+}
+
 // Removes all tags with status != 1, then sorts them by id. Returns true if there are no duplicate tags.
 static bool SortTags(FrameLog& log)
 {
@@ -14,30 +14,47 @@
 #include <boost/accumulators/statistics/stats.hpp>
 #include <boost/accumulators/statistics/mean.hpp>
 #include <boost/accumulators/statistics/variance.hpp>
+#include <boost/accumulators/statistics/max.hpp>
+#include <boost/accumulators/statistics/count.hpp>
 #include "TestLog.h"
 
 namespace bacc = boost::accumulators;
 
+// In accuracy-only mode, the files are processed in parallel and not timed.
 class TestRunner
 {
   const boost::filesystem::path _inputDirPath;
   const boost::filesystem::path _outputDirPath;
   const boost::optional<bool> _useCuda;
+  const TimingOptions _timing;
+  const bool _accuracyOnly;
   std::vector<boost::filesystem::path> _inputFilePaths;
   
   void adjustParameters(cctag::Parameters& parameters);
+  template<typename F>
+  void forEachFile(const std::vector<boost::filesystem::path>& filePaths, F process);
   
 public:
-  TestRunner(const std::string& inputDir, const std::string& outputDir, boost::optional<bool> useCuda);
+  TestRunner(const std::string& inputDir, const std::string& outputDir, boost::optional<bool> useCuda,
+    const TimingOptions& timing, bool accuracyOnly);
   void generateReferenceResults(cctag::Parameters parameters);
   void generateTestResults();
 };
 
+// Allowed slowdown and memory growth of the test results.
+struct PerformanceTolerance
+{
+  float time = 0.1f;          // relative increase of the median frame time
+  float memory = 0.1f;        // relative increase of the peak RSS
+  float significance = 0.01f; // p-value below which a slower frame time is not due to chance
+};
+
 class TestChecker
 {
   const boost::filesystem::path _referenceDirPath;
   const boost::filesystem::path _testDirPath;
   const float _epsilon;
+  const PerformanceTolerance _tolerance;
   
   using PathVector = std::vector<boost::filesystem::path>;
   
@@ -56,18 +73,68 @@ class TestChecker
     bacc::stats<bacc::tag::mean,
                 bacc::tag::variance>> _qualityDiffAcc;  // over all tags in the dataset
   bool _failed;
+  bool _performanceRegressed;
   
   void check(const boost::filesystem::path& testFilePath);
+  void comparePerformance(const FileLog& referenceLog, const FileLog& testLog);
   void compare(FileLog& referenceLog, FileLog& testLog);
   void compare(FrameLog& referenceLog, FrameLog& testLog, size_t frame);
   void compare(const DetectedTag& referenceTag, const DetectedTag& testTag, size_t frame);
   boost::filesystem::path testToReferencePath(const boost::filesystem::path& testPath);
   
 public:
-  TestChecker(const std::string& referenceDir, const std::string& testDir, float epsilon);
+  TestChecker(const std::string& referenceDir, const std::string& testDir, float epsilon,
+    const PerformanceTolerance& tolerance);
   bool check();
+  // Whether a file of timed results is significantly slower or larger than its reference.
+  bool performanceRegressed() const { return _performanceRegressed; }
   float elapsedTimeDifferenceMean() { return bacc::mean(_elapsedDiffAcc); }
   float elapsedTimeDifferenceStdev() { return sqrt(bacc::variance(_elapsedDiffAcc)); }
   float qualityDifferenceMean() { return bacc::mean(_qualityDiffAcc); }
   float qualityDifferenceStdev() { return sqrt(bacc::variance(_qualityDiffAcc)); }
 };
+
+// Runs the detection in deterministic mode on every input file with different
+// numbers of threads and checks that all the runs give bit-exact results.
+class ThreadCountChecker
+{
+  const boost::filesystem::path _inputDirPath;
+  std::vector<boost::filesystem::path> _inputFilePaths;
+  bool _failed;
+
+  static bool identical(const FileLog& referenceLog, const FileLog& testLog);
+
+public:
+  explicit ThreadCountChecker(const std::string& inputDir);
+  bool check(cctag::Parameters parameters, const std::vector<int>& threadCounts);
+};
+
+// Compares the detection with the coarse-to-fine signal sampling of the imaged
+// center optimization against the detection with full length signals only.
+// Reports the elapsed time and the center displacement of the tags identified
+// in both runs.
+class SampleScheduleChecker
+{
+  const boost::filesystem::path _inputDirPath;
+  std::vector<boost::filesystem::path> _inputFilePaths;
+  bacc::accumulator_set<float,
+    bacc::stats<bacc::tag::mean>> _fullElapsedAcc;      // over all frames in the dataset
+  bacc::accumulator_set<float,
+    bacc::stats<bacc::tag::mean>> _scheduledElapsedAcc; // over all frames in the dataset
+  bacc::accumulator_set<float,
+    bacc::stats<bacc::tag::mean,
+                bacc::tag::max>> _displacementAcc;      // over all tags in the dataset
+  size_t _mismatchCount;
+
+  void compare(FrameLog& fullLog, FrameLog& scheduledLog);
+
+public:
+  explicit SampleScheduleChecker(const std::string& inputDir);
+  void check(cctag::Parameters parameters);
+  float fullElapsedTimeMean() { return bacc::mean(_fullElapsedAcc); }
+  float scheduledElapsedTimeMean() { return bacc::mean(_scheduledElapsedAcc); }
+  float displacementMean() { return bacc::mean(_displacementAcc); }
+  float displacementMax() { return bacc::max(_displacementAcc); }
+  size_t displacementCount() { return bacc::count(_displacementAcc); }
+  size_t mismatchCount() { return _mismatchCount; }
+};
@@ -5,6 +5,7 @@
  * License, v. 2.0. If a copy of the MPL was not distributed with this
  * file, You can obtain one at http://mozilla.org/MPL/2.0/.
  */
+#include <algorithm>
 #include <cmath>
 #include <fstream>
 #include <chrono>
@@ -15,22 +16,66 @@
 #include <boost/archive/xml_iarchive.hpp>
 #include <opencv2/videoio.hpp>
 #include <opencv2/opencv.hpp>
+#include "cctag/utils/Trace.hpp"
 #include "TestLog.h"
+#include "../common/Measure.hpp"
 
 using namespace cctag;
 
+static float Median(std::vector<float> values)
+{
+  const auto middle = values.begin() + values.size() / 2;
+  std::nth_element(values.begin(), middle, values.end());
+  return *middle;
+}
+
+// The timed runs are traced to get the time of every stage; the last run
+// gives the tags.
 FrameLog FrameLog::detect(size_t frame, const cv::Mat& src, const Parameters& parameters,
-  const cctag::CCTagMarkersBank& bank)
+  const cctag::CCTagMarkersBank& bank, const TimingOptions& timing)
 {
   using namespace std::chrono;
   CCTag::List markers;
   
-  const auto t0 = high_resolution_clock::now();
-  cctagDetection(markers, 0, frame, src, parameters, bank, true, nullptr);
-  const auto t1 = high_resolution_clock::now();
-  const auto td = duration_cast<milliseconds>(t1 - t0).count() / 1000.f;
+  for (size_t i = 0; i < timing.warmupCount; ++i) {
+    markers.clear();
+    cctagDetection(markers, 0, frame, src, parameters, bank, true, nullptr);
+  }
+  
+  const bool timed = timing.repeatCount > 0;
+  const bool wasTracing = trace::enabled();
+  if (timed)
+    trace::setEnabled(true);
   
-  return FrameLog(frame, td, markers);
+  float elapsedTime = 0;
+  std::vector<float> elapsedTimes;
+  std::map<std::string, std::vector<float>> stageTimes;
+  const size_t runCount = std::max<size_t>(timing.repeatCount, 1);
+  for (size_t i = 0; i < runCount; ++i) {
+    markers.clear();
+    if (timed)
+      trace::clear();
+    
+    const auto t0 = high_resolution_clock::now();
+    cctagDetection(markers, 0, frame, src, parameters, bank, true, nullptr);
+    const auto t1 = high_resolution_clock::now();
+    elapsedTime = duration_cast<microseconds>(t1 - t0).count() / 1e6f;
+    
+    if (timed) {
+      elapsedTimes.push_back(elapsedTime);
+      for (const auto& stage : trace::totalDurations())
+        stageTimes[stage.first].push_back(stage.second / 1e9f);
+    }
+  }
+  
+  if (timed) {
+    trace::setEnabled(wasTracing);
+    elapsedTime = Median(elapsedTimes);
+  }
+  FrameLog frameLog(frame, elapsedTime, markers);
+  frameLog.elapsedTimes = std::move(elapsedTimes);
+  frameLog.stageTimes = std::move(stageTimes);
+  return frameLog;
 }
 
 /////////////////////////////////////////////////////////////////////////////
@@ -68,18 +113,28 @@ bool FileLog::isSupportedFormat(const std::string& filename)
   return isSupportedImage(filename) || isSupportedVideo(filename);
 }
 
-FileLog FileLog::detect(const std::string& filename, const Parameters& parameters)
+// The peak memory is only measured with timed runs, as the files are then
+// processed one at a time.
+FileLog FileLog::detect(const std::string& filename, const Parameters& parameters,
+  const TimingOptions& timing)
 {
   if (parameters._nCrowns != 3 && parameters._nCrowns != 4)
     throw std::runtime_error("FileLog: unsupported number of crowns; can only be 3 or 4");
-  if (isSupportedImage(filename))
-    return detectImage(filename, parameters);
-  if(isSupportedVideo(filename))
-    return detectVideo(filename, parameters);
-  throw std::runtime_error(std::string("FileLog: unsupported format for file ") + filename);
+  if (!isSupportedImage(filename) && !isSupportedVideo(filename))
+    throw std::runtime_error(std::string("FileLog: unsupported format for file ") + filename);
+  
+  // The peak is reset so that every file reports its own; where it cannot be
+  // reset, the peak is not measured.
+  const bool measurePeak = timing.repeatCount > 0 && measure::resetPeakRss();
+  FileLog fileLog = isSupportedImage(filename) ?
+    detectImage(filename, parameters, timing) : detectVideo(filename, parameters, timing);
+  if (measurePeak)
+    fileLog.peakRssKb = measure::peakRssKb();
+  return fileLog;
 }
 
-FileLog FileLog::detectImage(const std::string& filename, const cctag::Parameters& parameters)
+FileLog FileLog::detectImage(const std::string& filename, const cctag::Parameters& parameters,
+  const TimingOptions& timing)
 {
   FileLog fileLog(filename, parameters);
   CCTagMarkersBank bank(parameters._nCrowns);
@@ -90,12 +145,13 @@ FileLog FileLog::detectImage(const std::string& filename, const cctag::Parameter
     throw std::runtime_error(std::string("FileLog: unable to read image file: ") + filename);
   cv::cvtColor(src, gray, CV_BGR2GRAY);
   
-  auto frameLog = FrameLog::detect(0, gray, parameters, bank);
+  auto frameLog = FrameLog::detect(0, gray, parameters, bank, timing);
   fileLog.frameLogs.push_back(frameLog);
   return fileLog;
 }
 
-FileLog FileLog::detectVideo(const std::string& filename, const cctag::Parameters& parameters)
+FileLog FileLog::detectVideo(const std::string& filename, const cctag::Parameters& parameters,
+  const TimingOptions& timing)
 {
   FileLog fileLog(filename, parameters);
   CCTagMarkersBank bank(parameters._nCrowns);
@@ -110,7 +166,7 @@ FileLog FileLog::detectVideo(const std::string& filename, const cctag::Parameter
   for (size_t i = 0; i < lastFrame; ++i) {
     video >> src;
     cv::cvtColor(src, gray, CV_BGR2GRAY);
-    auto frameLog = FrameLog::detect(i, gray, parameters, bank);
+    auto frameLog = FrameLog::detect(i, gray, parameters, bank, timing);
     fileLog.frameLogs.push_back(frameLog);
   }
   
@@ -7,9 +7,15 @@
  */
 #pragma once
 
+#include <map>
+#include <string>
 #include <vector>
 #include <opencv/cv.h>
+#include <boost/serialization/map.hpp>
 #include <boost/serialization/nvp.hpp>
+#include <boost/serialization/string.hpp>
+#include <boost/serialization/vector.hpp>
+#include <boost/serialization/version.hpp>
 #include "cctag/Detection.hpp"
 #include "cctag/Params.hpp"
 
@@ -38,17 +44,31 @@ struct DetectedTag
   { }
 };
 
+// How the detection of every frame is timed. Without timed runs, only the
+// elapsed time of the single detection is recorded.
+struct TimingOptions
+{
+  size_t warmupCount = 0;   // untimed detections first
+  size_t repeatCount = 0;   // timed detections, with the time of every stage
+};
+
 struct FrameLog
 {
   size_t frame;
-  float elapsedTime;
+  float elapsedTime;                                    // median of the timed runs, if any
+  std::vector<float> elapsedTimes;                      // of every timed run
+  std::map<std::string, std::vector<float>> stageTimes; // of every timed run, by tracing span name
   std::vector<DetectedTag> tags;
   
   template<typename Archive>
-  void serialize(Archive& ar, const unsigned)
+  void serialize(Archive& ar, const unsigned version)
   {
     ar & BOOST_SERIALIZATION_NVP(frame);
     ar & BOOST_SERIALIZATION_NVP(elapsedTime);
+    if (version >= 1) {
+      ar & BOOST_SERIALIZATION_NVP(elapsedTimes);
+      ar & BOOST_SERIALIZATION_NVP(stageTimes);
+    }
     ar & BOOST_SERIALIZATION_NVP(tags);
   }
   
@@ -59,7 +79,7 @@ struct FrameLog
   { }
 
   static FrameLog detect(size_t frame, const cv::Mat& src, const cctag::Parameters& parameters,
-    const cctag::CCTagMarkersBank& bank);
+    const cctag::CCTagMarkersBank& bank, const TimingOptions& timing = TimingOptions());
 };
 
 struct FileLog
@@ -67,13 +87,16 @@ struct FileLog
   std::string filename;
   cctag::Parameters parameters;
   std::vector<FrameLog> frameLogs;
+  size_t peakRssKb = 0;   // peak resident set size of the detection; 0 if not measured
   
   template<typename Archive>
-  void serialize(Archive& ar, const unsigned)
+  void serialize(Archive& ar, const unsigned version)
   {
     ar & BOOST_SERIALIZATION_NVP(filename);
     ar & BOOST_SERIALIZATION_NVP(parameters);
     ar & BOOST_SERIALIZATION_NVP(frameLogs);
+    if (version >= 1)
+      ar & BOOST_SERIALIZATION_NVP(peakRssKb);
   }
   
   FileLog() = default;
@@ -86,11 +109,17 @@ struct FileLog
   void load(const std::string& filename);
   
   static bool isSupportedFormat(const std::string& filename);
-  static FileLog detect(const std::string& filename, const cctag::Parameters& parameters);
+  static FileLog detect(const std::string& filename, const cctag::Parameters& parameters,
+    const TimingOptions& timing = TimingOptions());
   
 private:
   static bool isSupportedImage(const std::string& filename);
   static bool isSupportedVideo(const std::string& filename);
-  static FileLog detectImage(const std::string& filename, const cctag::Parameters& parameters);
-  static FileLog detectVideo(const std::string& filename, const cctag::Parameters& parameters);
+  static FileLog detectImage(const std::string& filename, const cctag::Parameters& parameters,
+    const TimingOptions& timing);
+  static FileLog detectVideo(const std::string& filename, const cctag::Parameters& parameters,
+    const TimingOptions& timing);
 };
+
+BOOST_CLASS_VERSION(FrameLog, 1)
+BOOST_CLASS_VERSION(FileLog, 1)
@@ -8,6 +8,7 @@
 #include <iostream>
 #include <fstream>
 #include <string>
+#include <vector>
 #include <boost/archive/xml_iarchive.hpp>
 #include <boost/program_options.hpp>
 #include "Regression.h"
@@ -17,6 +18,13 @@ static std::string DestinationDir;
 static std::string ParametersFile;
 static float Epsilon;
 static boost::optional<bool> UseCuda;
+static TimingOptions Timing;
+static bool AccuracyOnly;
+static PerformanceTolerance Tolerance;
+static bool PerformanceGate;
+
+// Thread counts compared by check-threads; the first one gives the reference results.
+static const std::vector<int> ThreadCounts{ 1, 4, 64 };
 
 static std::string ParseOptions(int argc, char **argv)
 {
@@ -28,6 +36,8 @@ static std::string ParseOptions(int argc, char **argv)
     ("gen-ref", "Generate reference results from images in the source directory")
     ("gen-test", "Generate test results based on settings from reference results in the source directory")
     ("compare", "Compare reference results in the source directory with results in the destination directory")
+    ("check-threads", "Check that the deterministic mode gives identical results on images in the source directory with 1, 4 and 64 threads")
+    ("check-sampling", "Compare the coarse-to-fine signal sampling of the imaged center optimization against full length signals on images in the source directory")
     ("use-cuda", value<bool>()->notifier([](bool v) { UseCuda = v; }),
       "Overrides implementation specified by parameters")
     ("help", "Print help");
@@ -39,7 +49,20 @@ static std::string ParseOptions(int argc, char **argv)
     ("parameters", value<std::string>(&ParametersFile), "Detection parameters file")
     ("epsilon", value<float>(&Epsilon)->default_value(0.5f), "Position tolerance for x/y coordinates");
   
+  options_description perf_desc("Performance options");
+  perf_desc.add_options()
+    ("warmup", value<size_t>(&Timing.warmupCount)->default_value(0), "gen-ref, gen-test: untimed detections of every frame first")
+    ("repeat", value<size_t>(&Timing.repeatCount)->default_value(0),
+      "gen-ref, gen-test: timed detections of every frame, recording the time of every stage and the peak memory")
+    ("accuracy-only", "gen-ref, gen-test: process the files in parallel, without timing")
+    ("perf-gate", "compare: also fail on significant time regressions and on memory regressions")
+    ("time-tolerance", value<float>(&Tolerance.time)->default_value(Tolerance.time), "compare: allowed relative increase of the median frame time")
+    ("memory-tolerance", value<float>(&Tolerance.memory)->default_value(Tolerance.memory), "compare: allowed relative increase of the peak RSS")
+    ("significance", value<float>(&Tolerance.significance)->default_value(Tolerance.significance),
+      "compare: p-value below which a slower frame time is significant");
+  
   all_desc.add(data_desc);
+  all_desc.add(perf_desc);
   
   variables_map vm;
   store(parse_command_line(argc, argv, all_desc), vm);
@@ -77,35 +100,93 @@ static std::string ParseOptions(int argc, char **argv)
     mode = "compare";
   }
   
+  if (vm.count("check-threads")) {
+    if (!mode.empty())
+      throw error("only one mode option can be specified");
+    if (!vm.count("src-dir") || !vm.count("parameters"))
+      throw error("check-threads: src-dir and parameters are mandatory");
+    mode = "check-threads";
+  }
+  
+  if (vm.count("check-sampling")) {
+    if (!mode.empty())
+      throw error("only one mode option can be specified");
+    if (!vm.count("src-dir") || !vm.count("parameters"))
+      throw error("check-sampling: src-dir and parameters are mandatory");
+    mode = "check-sampling";
+  }
+  
   if (mode.empty())
     throw error("exactly one mode option must be specified");
   
+  AccuracyOnly = vm.count("accuracy-only") > 0;
+  PerformanceGate = vm.count("perf-gate") > 0;
+  if (AccuracyOnly && (vm["warmup"].as<size_t>() || vm["repeat"].as<size_t>()))
+    throw error("accuracy-only runs are not timed; cannot specify warmup or repeat");
+  
   notify(vm);
   return mode;
 }
 
-static void GenerateReference()
+static cctag::Parameters LoadParameters()
 {
-  TestRunner testRunner(SourceDir, DestinationDir, UseCuda);
   cctag::Parameters parameters;
+  std::ifstream ifs(ParametersFile);
+  boost::archive::xml_iarchive ia(ifs);
+  ia >> boost::serialization::make_nvp("CCTagsParams", parameters);
+  return parameters;
+}
+
+static void GenerateReference()
+{
+  TestRunner testRunner(SourceDir, DestinationDir, UseCuda, Timing, AccuracyOnly);
+  testRunner.generateReferenceResults(LoadParameters());
+}
+
+static bool CheckThreadCounts()
+{
+  cctag::Parameters parameters = LoadParameters();
+  if (UseCuda)
+    parameters._useCuda = *UseCuda;
   
-  {
-    std::ifstream ifs(ParametersFile);
-    boost::archive::xml_iarchive ia(ifs);
-    ia >> boost::serialization::make_nvp("CCTagsParams", parameters);
-  }
+  ThreadCountChecker checker(SourceDir);
+  bool ok = checker.check(parameters, ThreadCounts);
+  
+  if (ok) std::clog << "All checks PASSED" << std::endl;
+  else std::clog << "Some checks FAILED" << std::endl;
+  return ok;
+}
 
-  testRunner.generateReferenceResults(parameters);
+static void CheckSampleSchedule()
+{
+  cctag::Parameters parameters = LoadParameters();
+  if (UseCuda)
+    parameters._useCuda = *UseCuda;
+  
+  SampleScheduleChecker checker(SourceDir);
+  checker.check(parameters);
+  
+  std::clog << "Sample schedule report (min. sample cut length " << parameters._imagedCenterMinSampleCutLength
+    << ", full length " << parameters._sampleCutLength << "):\n";
+  std::clog << "  time,         full=" << checker.fullElapsedTimeMean() << ",scheduled=" << checker.scheduledElapsedTimeMean() << std::endl;
+  std::clog << "  displacement, mean=" << checker.displacementMean() << ",max=" << checker.displacementMax()
+    << " over " << checker.displacementCount() << " tags" << std::endl;
+  std::clog << "  tags identified in one run only: " << checker.mismatchCount() << std::endl;
 }
 
 static bool ReportChecks()
 {
-  TestChecker testChecker(SourceDir, DestinationDir, Epsilon);
+  TestChecker testChecker(SourceDir, DestinationDir, Epsilon, Tolerance);
   bool ok = testChecker.check();
   
   if (ok) std::clog << "All checks PASSED" << std::endl;
   else std::clog << "Some checks FAILED" << std::endl;
   
+  if (testChecker.performanceRegressed()) {
+    std::clog << "Performance REGRESSED" << (PerformanceGate ? "" : " (not gated, see --perf-gate)") << std::endl;
+    ok = ok && !PerformanceGate;
+  }
+  
   std::clog << "Performance difference report:\n";
   std::clog << "  time,    mean=" << testChecker.elapsedTimeDifferenceMean() << ",stdev=" << testChecker.elapsedTimeDifferenceStdev() << std::endl;
   std::clog << "  quality, mean=" << testChecker.qualityDifferenceMean() << ",stdev=" << testChecker.qualityDifferenceStdev() << std::endl;
@@ -127,7 +208,7 @@ int main(int argc, char **argv)
     }
     
     if (mode == "gen-test") {
-      TestRunner testRunner(SourceDir, DestinationDir, UseCuda);
+      TestRunner testRunner(SourceDir, DestinationDir, UseCuda, Timing, AccuracyOnly);
       testRunner.generateTestResults();
       return EXIT_SUCCESS;
     }
@@ -137,6 +218,16 @@ int main(int argc, char **argv)
       return ok ? EXIT_SUCCESS : EXIT_FAILURE;
     }
     
+    if (mode == "check-threads") {
+      bool ok = CheckThreadCounts();
+      return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    
+    if (mode == "check-sampling") {
+      CheckSampleSchedule();
+      return EXIT_SUCCESS;
+    }
+    
     throw std::logic_error("internal error: invalid mode");
   }
   catch (boost::program_options::error& e) {
@@ -0,0 +1,315 @@
+/*
+ * Copyright 2016, Simula Research Laboratory
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+#include "Scene.hpp"
+
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+
+namespace cctag {
+namespace synthetic {
+
+namespace {
+
+const float kPi = 3.14159265f;
+
+// The printed marker lies on a white disc; its white margin is this fraction
+// of the outer radius.
+const float kPaperRadius = 1.25f;
+
+const float kBackground = 140.f;
+const float kPaper = 235.f;
+const float kInk = 25.f;
+
+// Samples per pixel side when rendering the markers.
+const int kSubSamples = 3;
+
+// Number of placement attempts per requested tag.
+const std::size_t kPlacementAttempts = 50;
+
+// Smallest outer radius chosen by default: below it, the inner crowns are
+// only a couple of pixels wide.
+const float kMinDefaultRadius = 12.f;
+
+struct Placement
+{
+  cv::Matx33d homography; // marker plane, in units of the outer radius -> image
+  cv::Point2f center;
+  float footprint;        // radius of a disc containing the imaged white disc
+};
+
+cv::Point2f project(const cv::Matx33d& h, double u, double v)
+{
+  const cv::Vec3d p = h * cv::Vec3d(u, v, 1.);
+  return cv::Point2f(float(p[0] / p[2]), float(p[1] / p[2]));
+}
+
+/*
+ * Pinhole camera with a focal length of the largest image side, looking at a
+ * marker tilted around a random axis of its plane. The depth is chosen so
+ * that the marker would have the requested radius if it was not tilted, and
+ * the marker center projects onto the requested image point.
+ */
+cv::Matx33d markerHomography(const SceneOptions& options, const cv::Point2f& center, float radius,
+                             std::mt19937& rng)
+{
+  std::uniform_real_distribution<float> angle(0.f, 2.f * kPi);
+  std::uniform_real_distribution<float> tilt(0.f, options.maxTiltDeg * kPi / 180.f);
+
+  const double f = std::max(options.width, options.height);
+  const cv::Matx33d K(f, 0, options.width / 2., 0, f, options.height / 2., 0, 0, 1);
+
+  // Rotation of theta around the unit axis a of the marker plane:
+  // cos(theta) I + sin(theta) [a]x + (1 - cos(theta)) a a^T.
+  const float axis = angle(rng);
+  const double theta = tilt(rng);
+  const double ax = std::cos(axis);
+  const double ay = std::sin(axis);
+  const double c = std::cos(theta);
+  const double s = std::sin(theta);
+  const cv::Matx33d tilted(c + (1 - c) * ax * ax, (1 - c) * ax * ay, s * ay,
+                           (1 - c) * ax * ay, c + (1 - c) * ay * ay, -s * ax,
+                           -s * ay, s * ax, c);
+  const float psi = angle(rng);
+  const cv::Matx33d inPlane(std::cos(psi), -std::sin(psi), 0, std::sin(psi), std::cos(psi), 0, 0, 0, 1);
+  const cv::Matx33d R = tilted * inPlane;
+
+  const double z = f / radius;
+  const cv::Vec3d t(z * (center.x - options.width / 2.) / f, z * (center.y - options.height / 2.) / f, z);
+  const cv::Matx33d Rt(R(0, 0), R(0, 1), t[0],
+                       R(1, 0), R(1, 1), t[1],
+                       R(2, 0), R(2, 1), t[2]);
+  return K * Rt;
+}
+
+// Whether the point at the distance r from the center, in units of the outer
+// radius, is black: the rings start at the inverse of the radius ratios, from
+// a white center to a black outer ring.
+bool isInk(const std::vector<float>& ratios, float r)
+{
+  if (r >= 1.f)
+    return false;
+  std::size_t nTransitions = 0;
+  for (float ratio : ratios)
+    nTransitions += 1.f / ratio <= r;
+  return nTransitions % 2;
+}
+
+void renderMarker(cv::Mat& image, const Placement& placement, const std::vector<float>& ratios)
+{
+  const cv::Matx33d inverse = placement.homography.inv();
+  const int x0 = std::max(0, int(placement.center.x - placement.footprint));
+  const int x1 = std::min(image.cols - 1, int(placement.center.x + placement.footprint) + 1);
+  const int y0 = std::max(0, int(placement.center.y - placement.footprint));
+  const int y1 = std::min(image.rows - 1, int(placement.center.y + placement.footprint) + 1);
+
+  // Pixel centers are at integer coordinates, as in the detection.
+  for (int y = y0; y <= y1; ++y)
+  {
+    float* row = image.ptr<float>(y);
+    for (int x = x0; x <= x1; ++x)
+    {
+      float sum = 0.f;
+      for (int sy = 0; sy < kSubSamples; ++sy)
+      {
+        for (int sx = 0; sx < kSubSamples; ++sx)
+        {
+          const cv::Vec3d p = inverse * cv::Vec3d(x + (sx + 0.5) / kSubSamples - 0.5,
+                                                   y + (sy + 0.5) / kSubSamples - 0.5, 1.);
+          const float u = float(p[0] / p[2]);
+          const float v = float(p[1] / p[2]);
+          const float r = std::sqrt(u * u + v * v);
+          if (r >= kPaperRadius)
+            sum += row[x];
+          else
+            sum += isInk(ratios, r) ? kInk : kPaper;
+        }
+      }
+      row[x] = sum / (kSubSamples * kSubSamples);
+    }
+  }
+}
+
+// Lines, rectangles, circles and ellipses of random gray levels.
+void renderClutter(cv::Mat& image, std::size_t nClutter, std::mt19937& rng)
+{
+  const float scale = std::min(image.cols, image.rows);
+  std::uniform_real_distribution<float> x(0.f, image.cols);
+  std::uniform_real_distribution<float> y(0.f, image.rows);
+  std::uniform_real_distribution<float> size(0.01f * scale, 0.15f * scale);
+  std::uniform_real_distribution<float> gray(20.f, 240.f);
+  std::uniform_real_distribution<float> angle(0.f, 360.f);
+  std::uniform_int_distribution<int> shape(0, 3);
+  std::uniform_int_distribution<int> thickness(-2, 6); // filled when <= 0
+
+  for (std::size_t i = 0; i < nClutter; ++i)
+  {
+    const cv::Point center(int(x(rng)), int(y(rng)));
+    const cv::Scalar color(gray(rng));
+    int thick = thickness(rng);
+    if (thick <= 0)
+      thick = cv::FILLED;
+    switch (shape(rng))
+    {
+      case 0:
+        cv::line(image, center, cv::Point(int(x(rng)), int(y(rng))), color, std::max(thick, 1), cv::LINE_AA);
+        break;
+      case 1:
+      {
+        const cv::Point corner(int(center.x + size(rng)), int(center.y + size(rng)));
+        cv::rectangle(image, center, corner, color, thick, cv::LINE_AA);
+        break;
+      }
+      case 2:
+        cv::circle(image, center, int(size(rng)), color, thick, cv::LINE_AA);
+        break;
+      default:
+        cv::ellipse(image, center, cv::Size(int(size(rng)), int(size(rng))), angle(rng), 0, 360, color, thick, cv::LINE_AA);
+        break;
+    }
+  }
+}
+
+// Quadrilateral covering a side of the marker, up to 0.6 to 0.9 of its radius
+// from the center, which stays visible.
+void renderOccluder(cv::Mat& image, const GroundTruthTag& tag, std::mt19937& rng)
+{
+  std::uniform_real_distribution<float> angle(0.f, 2.f * kPi);
+  std::uniform_real_distribution<float> depth(0.6f, 0.9f);
+  std::uniform_real_distribution<float> gray(20.f, 240.f);
+
+  const float a = angle(rng);
+  const cv::Point2f d(std::cos(a), std::sin(a));
+  const cv::Point2f n(-d.y, d.x);
+  const cv::Point2f c(tag.x, tag.y);
+  const float r = tag.radius;
+  const float inner = depth(rng) * r;
+  const float outer = 1.2f * r;
+  const cv::Point corners[] = {
+    c + d * inner + n * (0.6f * r), c + d * inner - n * (0.6f * r),
+    c + d * outer - n * (0.6f * r), c + d * outer + n * (0.6f * r) };
+  cv::fillConvexPoly(image, corners, 4, cv::Scalar(gray(rng)), cv::LINE_AA);
+}
+
+// Brightness decreasing linearly along a random direction.
+void applyIllumination(cv::Mat& image, float gradient, std::mt19937& rng)
+{
+  std::uniform_real_distribution<float> angle(0.f, 2.f * kPi);
+  const float a = angle(rng);
+  const float dx = std::cos(a) / image.cols;
+  const float dy = std::sin(a) / image.rows;
+  const float offset = std::min(0.f, dx * image.cols) + std::min(0.f, dy * image.rows);
+  const float range = std::abs(dx * image.cols) + std::abs(dy * image.rows);
+
+  for (int y = 0; y < image.rows; ++y)
+  {
+    float* row = image.ptr<float>(y);
+    for (int x = 0; x < image.cols; ++x)
+      row[x] *= 1.f - gradient * (dx * x + dy * y - offset) / range;
+  }
+}
+
+void applyNoise(cv::Mat& image, float sigma, std::mt19937& rng)
+{
+  std::normal_distribution<float> noise(0.f, sigma);
+  for (int y = 0; y < image.rows; ++y)
+  {
+    float* row = image.ptr<float>(y);
+    for (int x = 0; x < image.cols; ++x)
+      row[x] += noise(rng);
+  }
+}
+
+} // namespace
+
+std::vector<GroundTruthTag> renderScene(cv::Mat& image, const SceneOptions& options,
+                                        const CCTagMarkersBank& bank, std::mt19937& rng)
+{
+  // Default radii leave room around every tag.
+  const float cell = std::sqrt(float(options.width) * options.height / std::max<std::size_t>(options.nTags, 1));
+  float maxRadius = options.maxRadius > 0.f ? options.maxRadius
+                  : std::max(kMinDefaultRadius, std::min(0.3f * cell, 0.2f * std::min(options.width, options.height)));
+  float minRadius = options.minRadius > 0.f ? options.minRadius : 0.5f * maxRadius;
+  if (minRadius > maxRadius)
+    std::swap(minRadius, maxRadius);
+
+  cv::Mat scene(options.height, options.width, CV_32FC1, cv::Scalar(kBackground));
+  renderClutter(scene, options.nClutter, rng);
+
+  std::uniform_real_distribution<float> radius(minRadius, maxRadius);
+  std::uniform_real_distribution<float> unit(0.f, 1.f);
+  std::uniform_int_distribution<int> id(0, int(bank.getMarkers().size()) - 1);
+
+  std::vector<Placement> placements;
+  std::vector<GroundTruthTag> tags;
+  for (std::size_t attempt = 0; tags.size() < options.nTags && attempt < kPlacementAttempts * options.nTags; ++attempt)
+  {
+    const float r = radius(rng);
+    if (2 * kPaperRadius * r >= std::min(options.width, options.height))
+      continue;
+    const cv::Point2f center(kPaperRadius * r + unit(rng) * (options.width - 2 * kPaperRadius * r),
+                             kPaperRadius * r + unit(rng) * (options.height - 2 * kPaperRadius * r));
+
+    Placement placement{ markerHomography(options, center, r, rng), center, 0.f };
+    GroundTruthTag tag{ id(rng), center.x, center.y, 0.f, unit(rng) < options.occlusionRate };
+
+    // The perspective enlarges the near side of a tilted marker.
+    const int nOuterPoints = 64;
+    for (int i = 0; i < nOuterPoints; ++i)
+    {
+      const float a = 2.f * kPi * i / nOuterPoints;
+      tag.radius += float(cv::norm(project(placement.homography, std::cos(a), std::sin(a)) - center));
+      placement.footprint = std::max(placement.footprint, float(cv::norm(
+        project(placement.homography, kPaperRadius * std::cos(a), kPaperRadius * std::sin(a)) - center)));
+    }
+    tag.radius /= nOuterPoints;
+
+    const bool overlaps = std::any_of(placements.begin(), placements.end(), [&placement](const Placement& p)
+    {
+      return cv::norm(p.center - placement.center) < p.footprint + placement.footprint;
+    });
+    if (overlaps)
+      continue;
+
+    renderMarker(scene, placement, bank.getMarkers()[tag.id]);
+    if (tag.occluded)
+      renderOccluder(scene, tag, rng);
+
+    placements.push_back(placement);
+    tags.push_back(tag);
+  }
+
+  if (options.illuminationGradient > 0.f)
+    applyIllumination(scene, options.illuminationGradient, rng);
+  if (options.blurSigma > 0.f)
+    cv::GaussianBlur(scene, scene, cv::Size(0, 0), options.blurSigma);
+  if (options.noiseSigma > 0.f)
+    applyNoise(scene, options.noiseSigma, rng);
+
+  scene.convertTo(image, CV_8UC1);
+  return tags;
+}
+
+void writeGroundTruthCsvHeader(std::ostream& ostr)
+{
+  ostr << "frame,id,x,y,radius,occluded\n" << std::fixed << std::setprecision(3);
+}
+
+void writeGroundTruthCsv(std::ostream& ostr, std::size_t frame, const std::vector<GroundTruthTag>& tags)
+{
+  for (const GroundTruthTag& tag : tags)
+  {
+    ostr << frame << ',' << tag.id << ',' << tag.x << ',' << tag.y << ','
+         << tag.radius << ',' << tag.occluded << '\n';
+  }
+}
+
+} // namespace synthetic
+} // namespace cctag
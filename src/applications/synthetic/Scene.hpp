@@ -0,0 +1,69 @@
+/*
+ * Copyright 2016, Simula Research Laboratory
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+#pragma once
+
+#include <cctag/CCTagMarkersBank.hpp>
+
+#include <opencv2/core/core.hpp>
+
+#include <cstddef>
+#include <ostream>
+#include <random>
+#include <vector>
+
+namespace cctag {
+namespace synthetic {
+
+/**
+ * @brief Settings of a synthetic scene. Radii are the outer radii of the
+ * markers in pixels, before the perspective; 0 lets the renderer fit them to
+ * the image size and the number of tags.
+ */
+struct SceneOptions
+{
+  int width = 1920;
+  int height = 1080;
+  std::size_t nTags = 10;
+  float minRadius = 0.f;
+  float maxRadius = 0.f;
+  float maxTiltDeg = 50.f;           // angle between the marker plane and the image plane
+  float blurSigma = 0.8f;            // Gaussian blur (px), 0 to disable
+  float noiseSigma = 2.f;            // additive Gaussian noise (gray levels)
+  float illuminationGradient = 0.3f; // relative brightness drop across the image, in [0,1)
+  float occlusionRate = 0.f;         // fraction of the tags partly covered by an occluder
+  std::size_t nClutter = 20;         // random shapes in the background
+};
+
+/**
+ * @brief Exact position of a rendered marker: the projection of its center,
+ * which is the point the detection estimates, not the center of the imaged
+ * outer ellipse.
+ */
+struct GroundTruthTag
+{
+  int id;
+  float x;
+  float y;
+  float radius;     // mean imaged outer radius (px)
+  bool occluded;
+};
+
+/**
+ * @brief Render a gray scene of markers of the bank, each one under its own
+ * homography, in non overlapping places.
+ * @return the rendered markers; fewer than options.nTags if the image is too
+ * crowded to place them all
+ */
+std::vector<GroundTruthTag> renderScene(cv::Mat& image, const SceneOptions& options,
+                                        const CCTagMarkersBank& bank, std::mt19937& rng);
+
+void writeGroundTruthCsvHeader(std::ostream& ostr);
+void writeGroundTruthCsv(std::ostream& ostr, std::size_t frame, const std::vector<GroundTruthTag>& tags);
+
+} // namespace synthetic
+} // namespace cctag
@@ -0,0 +1,133 @@
+/*
+ * Copyright 2016, Simula Research Laboratory
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+#include "Scene.hpp"
+
+#include <cctag/CCTagMarkersBank.hpp>
+
+#include <opencv2/imgcodecs.hpp>
+
+#include <boost/filesystem.hpp>
+#include <boost/program_options.hpp>
+
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+
+namespace bfs = boost::filesystem;
+
+namespace {
+
+const std::map<std::string, cv::Size> kResolutions{
+  { "vga", cv::Size(640, 480) },
+  { "720p", cv::Size(1280, 720) },
+  { "1080p", cv::Size(1920, 1080) },
+  { "4k", cv::Size(3840, 2160) },
+  { "8k", cv::Size(7680, 4320) } };
+
+} // namespace
+
+/*************************************************************/
+/*                    Main entry                             */
+/*************************************************************/
+int main(int argc, char** argv)
+{
+  using namespace boost::program_options;
+
+  cctag::synthetic::SceneOptions options;
+  std::string resolution;
+  std::string outputDir;
+  std::size_t nCrowns;
+  std::size_t nFrames;
+  unsigned seed;
+
+  options_description desc("Renders frames of CCTags with their ground truth in <output>/groundtruth.csv");
+  desc.add_options()
+    ("output,o", value<std::string>(&outputDir)->required(), "Output directory of the frames and of the ground truth")
+    ("resolution,r", value<std::string>(&resolution)->default_value("1080p"), "vga, 720p, 1080p, 4k or 8k")
+    ("width", value<int>(&options.width), "Frame width, overrides the resolution")
+    ("height", value<int>(&options.height), "Frame height, overrides the resolution")
+    ("frames,f", value<std::size_t>(&nFrames)->default_value(1), "Number of frames")
+    ("tags,t", value<std::size_t>(&options.nTags)->default_value(options.nTags), "Number of tags per frame")
+    ("n-crowns,n", value<std::size_t>(&nCrowns)->default_value(3), "Number of crowns of the tags, 3 or 4")
+    ("min-radius", value<float>(&options.minRadius), "Smallest outer radius of the tags (px), fit to the frame by default")
+    ("max-radius", value<float>(&options.maxRadius), "Largest outer radius of the tags (px), fit to the frame by default")
+    ("max-tilt", value<float>(&options.maxTiltDeg)->default_value(options.maxTiltDeg), "Largest angle between a tag and the image plane (deg)")
+    ("blur", value<float>(&options.blurSigma)->default_value(options.blurSigma), "Standard deviation of the Gaussian blur (px)")
+    ("noise", value<float>(&options.noiseSigma)->default_value(options.noiseSigma), "Standard deviation of the noise (gray levels)")
+    ("illumination", value<float>(&options.illuminationGradient)->default_value(options.illuminationGradient), "Relative brightness drop across the frame")
+    ("occlusion", value<float>(&options.occlusionRate)->default_value(options.occlusionRate), "Fraction of the tags partly occluded")
+    ("clutter", value<std::size_t>(&options.nClutter)->default_value(options.nClutter), "Number of random shapes in the background")
+    ("seed", value<unsigned>(&seed)->default_value(0), "Seed of the random generator; frame i uses seed + i")
+    ("help", "Print help");
+
+  variables_map vm;
+  try
+  {
+    store(parse_command_line(argc, argv, desc), vm);
+    if (vm.count("help"))
+    {
+      std::cout << desc << std::endl;
+      return EXIT_SUCCESS;
+    }
+    notify(vm);
+  }
+  catch (const error& e)
+  {
+    std::cerr << e.what() << std::endl << desc << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  const auto found = kResolutions.find(resolution);
+  if (found == kResolutions.end())
+  {
+    std::cerr << "Unknown resolution " << resolution << std::endl << desc << std::endl;
+    return EXIT_FAILURE;
+  }
+  if (!vm.count("width"))
+    options.width = found->second.width;
+  if (!vm.count("height"))
+    options.height = found->second.height;
+
+  if (nCrowns != 3 && nCrowns != 4)
+  {
+    std::cerr << "Unsupported number of crowns; can only be 3 or 4" << std::endl;
+    return EXIT_FAILURE;
+  }
+  const cctag::CCTagMarkersBank bank(nCrowns);
+
+  bfs::create_directories(outputDir);
+  const std::string groundTruthFilename = outputDir + "/groundtruth.csv";
+  std::ofstream groundTruth(groundTruthFilename);
+  if (!groundTruth)
+  {
+    std::cerr << "Unable to open " << groundTruthFilename << std::endl;
+    return EXIT_FAILURE;
+  }
+  cctag::synthetic::writeGroundTruthCsvHeader(groundTruth);
+
+  for (std::size_t i = 0; i < nFrames; ++i)
+  {
+    // Every frame can be regenerated on its own.
+    std::mt19937 rng(seed + unsigned(i));
+    cv::Mat frame;
+    const std::vector<cctag::synthetic::GroundTruthTag> tags = cctag::synthetic::renderScene(frame, options, bank, rng);
+    if (tags.size() < options.nTags)
+      std::cerr << "Frame " << i << ": placed " << tags.size() << " of " << options.nTags << " tags" << std::endl;
+
+    std::stringstream outFileName;
+    outFileName << std::setfill('0') << std::setw(5) << i;
+    cv::imwrite(outputDir + "/" + outFileName.str() + ".png", frame);
+    cctag::synthetic::writeGroundTruthCsv(groundTruth, i, tags);
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,345 @@
+/*
+ * Copyright 2016, Simula Research Laboratory
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+
+// Runs N concurrent detection streams over the same frames, as with one
+// stream per camera, and reports how the throughput and the latencies scale
+// with N.
+
+#include "../common/Measure.hpp"
+
+#include <cctag/Detection.hpp>
+#include <cctag/Params.hpp>
+
+#include <opencv2/imgcodecs.hpp>
+
+#include <boost/algorithm/string.hpp>
+#include <boost/archive/xml_iarchive.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/program_options.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#endif
+
+namespace bfs = boost::filesystem;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct StreamResult
+{
+  std::vector<double> latenciesMs;
+};
+
+struct RunResult
+{
+  std::size_t nStreams;
+  double wallS;
+  double cpuS;
+  std::size_t peakRssKb;
+  std::vector<StreamResult> streams;
+};
+
+// User + system time of the process.
+double cpuTime()
+{
+#if defined(__unix__) || defined(__APPLE__)
+  rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_utime.tv_sec + usage.ru_utime.tv_usec * 1e-6
+       + usage.ru_stime.tv_sec + usage.ru_stime.tv_usec * 1e-6;
+#else
+  return 0;
+#endif
+}
+
+/*
+ * Every stream first detects nWarmup frames, then all of them start together
+ * and detect nFrames frames each, with a stream offset so that they do not
+ * work on the same frame at the same time.
+ */
+RunResult runStreams(std::size_t nStreams, const std::vector<cv::Mat>& frames, std::size_t nFrames,
+                     std::size_t nWarmup, const cctag::Parameters& params, const cctag::CCTagMarkersBank& bank)
+{
+  RunResult result{ nStreams, 0, 0, 0, std::vector<StreamResult>(nStreams) };
+
+  std::mutex mutex;
+  std::condition_variable condition;
+  std::size_t nReady = 0;
+  bool go = false;
+
+  // Only Linux allows a peak per run; elsewhere it is the one of the whole process.
+  cctag::measure::resetPeakRss();
+
+  std::vector<std::thread> threads;
+  for (std::size_t iStream = 0; iStream < nStreams; ++iStream)
+  {
+    threads.emplace_back([&, iStream]()
+    {
+      cctag::CCTag::List markers;
+      for (std::size_t i = 0; i < nWarmup; ++i)
+      {
+        markers.clear();
+        cctag::cctagDetection(markers, int(iStream), i, frames[(iStream + i) % frames.size()], params, bank, false);
+      }
+
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        ++nReady;
+        condition.notify_all();
+        condition.wait(lock, [&go] { return go; });
+      }
+
+      std::vector<double>& latencies = result.streams[iStream].latenciesMs;
+      latencies.reserve(nFrames);
+      for (std::size_t i = 0; i < nFrames; ++i)
+      {
+        markers.clear();
+        const auto t0 = Clock::now();
+        cctag::cctagDetection(markers, int(iStream), i, frames[(iStream + i) % frames.size()], params, bank, false);
+        latencies.push_back(std::chrono::duration<double, std::milli>(Clock::now() - t0).count());
+      }
+    });
+  }
+
+  Clock::time_point start;
+  double startCpu;
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    condition.wait(lock, [&nReady, nStreams] { return nReady == nStreams; });
+    start = Clock::now();
+    startCpu = cpuTime();
+    go = true;
+  }
+  condition.notify_all();
+
+  for (std::thread& thread : threads)
+    thread.join();
+
+  result.wallS = std::chrono::duration<double>(Clock::now() - start).count();
+  result.cpuS = cpuTime() - startCpu;
+  result.peakRssKb = cctag::measure::peakRssKb();
+  return result;
+}
+
+void writeCsvHeader(std::ostream& ostr)
+{
+  ostr << "streams,stream,frames,fps,p50_ms,p95_ms,p99_ms,cpu_utilisation,peak_rss_mb\n";
+}
+
+// One row per stream, then one row "all" with the aggregate fps and the
+// latencies of all the streams.
+void writeCsv(std::ostream& ostr, const RunResult& result, unsigned nCores)
+{
+  const double utilisation = result.cpuS / (result.wallS * nCores);
+  const double peakRssMb = result.peakRssKb / 1024.;
+
+  std::vector<double> all;
+  for (std::size_t iStream = 0; iStream <= result.streams.size(); ++iStream)
+  {
+    const bool aggregate = iStream == result.streams.size();
+    const std::vector<double>& latencies = aggregate ? all : result.streams[iStream].latenciesMs;
+    if (!aggregate)
+      all.insert(all.end(), latencies.begin(), latencies.end());
+
+    ostr << result.nStreams << ',';
+    if (aggregate)
+      ostr << "all";
+    else
+      ostr << iStream;
+    ostr << ',' << latencies.size() << ','
+         << std::fixed << std::setprecision(2) << latencies.size() / result.wallS << ','
+         << cctag::measure::percentile(latencies, 50) << ',' << cctag::measure::percentile(latencies, 95) << ','
+         << cctag::measure::percentile(latencies, 99) << ','
+         << std::setprecision(3) << utilisation << ','
+         << std::setprecision(1) << peakRssMb << '\n';
+  }
+  ostr.flush();
+}
+
+void printSummaryHeader(std::ostream& ostr)
+{
+  ostr << std::setw(7) << "streams" << std::setw(10) << "fps"
+       << std::setw(10) << "p50(ms)" << std::setw(10) << "p95(ms)" << std::setw(10) << "p99(ms)"
+       << std::setw(9) << "cpu" << std::setw(10) << "rss(MB)" << std::endl;
+}
+
+void printSummary(std::ostream& ostr, const RunResult& result, unsigned nCores)
+{
+  std::vector<double> all;
+  std::size_t nFrames = 0;
+  for (const StreamResult& stream : result.streams)
+  {
+    all.insert(all.end(), stream.latenciesMs.begin(), stream.latenciesMs.end());
+    nFrames += stream.latenciesMs.size();
+  }
+
+  ostr << std::setw(7) << result.nStreams
+       << std::fixed << std::setprecision(2)
+       << std::setw(10) << nFrames / result.wallS
+       << std::setw(10) << cctag::measure::percentile(all, 50)
+       << std::setw(10) << cctag::measure::percentile(all, 95)
+       << std::setw(10) << cctag::measure::percentile(all, 99)
+       << std::setw(8) << std::setprecision(0) << 100 * result.cpuS / (result.wallS * nCores) << '%'
+       << std::setw(10) << std::setprecision(1) << result.peakRssKb / 1024. << std::endl;
+}
+
+std::vector<cv::Mat> loadFrames(const std::string& input, std::size_t maxFrames)
+{
+  std::vector<std::string> filenames;
+  if (bfs::is_directory(input))
+  {
+    for (const bfs::directory_entry& entry : bfs::directory_iterator(input))
+    {
+      const std::string filename = entry.path().string();
+      if (boost::algorithm::iends_with(filename, ".png") || boost::algorithm::iends_with(filename, ".jpg"))
+        filenames.push_back(filename);
+    }
+    std::sort(filenames.begin(), filenames.end());
+  }
+  else
+  {
+    filenames.push_back(input);
+  }
+
+  std::vector<cv::Mat> frames;
+  for (const std::string& filename : filenames)
+  {
+    if (frames.size() == maxFrames)
+      break;
+    cv::Mat frame = cv::imread(filename, cv::IMREAD_GRAYSCALE);
+    if (frame.empty())
+      std::cerr << "Unable to read " << filename << std::endl;
+    else
+      frames.push_back(frame);
+  }
+  return frames;
+}
+
+// 1, 2, 4, ... up to the number of cores, which is always included.
+std::vector<std::size_t> defaultStreamCounts(unsigned nCores)
+{
+  std::vector<std::size_t> counts;
+  for (std::size_t n = 1; n < nCores; n *= 2)
+    counts.push_back(n);
+  counts.push_back(std::max(nCores, 1u));
+  return counts;
+}
+
+} // namespace
+
+/*************************************************************/
+/*                    Main entry                             */
+/*************************************************************/
+int main(int argc, char** argv)
+{
+  using namespace boost::program_options;
+
+  std::string input;
+  std::string paramsFilename;
+  std::string csvFilename;
+  std::vector<std::size_t> streamCounts;
+  std::size_t nCrowns;
+  std::size_t nFrames;
+  std::size_t nWarmup;
+  std::size_t maxFrames;
+
+  options_description desc("throughput options");
+  desc.add_options()
+    ("input,i", value<std::string>(&input)->required(), "Image, or directory of .png and .jpg images")
+    ("streams,s", value<std::vector<std::size_t>>(&streamCounts)->multitoken(), "Numbers of concurrent streams, 1, 2, 4, ... up to the core count by default")
+    ("frames,f", value<std::size_t>(&nFrames)->default_value(50), "Frames detected by every stream")
+    ("warmup", value<std::size_t>(&nWarmup)->default_value(2), "Untimed frames detected by every stream first")
+    ("max-frames", value<std::size_t>(&maxFrames)->default_value(100), "Largest number of images loaded from the input")
+    ("n-crowns,n", value<std::size_t>(&nCrowns)->default_value(3), "Number of crowns")
+    ("parameters,p", value<std::string>(&paramsFilename), "Detection parameters file")
+    ("csv", value<std::string>(&csvFilename), "CSV output file, one row per stream and per stream count")
+    ("help", "Print help");
+
+  variables_map vm;
+  try
+  {
+    store(parse_command_line(argc, argv, desc), vm);
+    if (vm.count("help"))
+    {
+      std::cout << desc << std::endl;
+      return EXIT_SUCCESS;
+    }
+    notify(vm);
+  }
+  catch (const error& e)
+  {
+    std::cerr << e.what() << std::endl << desc << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  cctag::Parameters params(nCrowns);
+  if (!paramsFilename.empty())
+  {
+    std::ifstream ifs(paramsFilename);
+    if (!ifs)
+    {
+      std::cerr << "Unable to open " << paramsFilename << std::endl;
+      return EXIT_FAILURE;
+    }
+    boost::archive::xml_iarchive ia(ifs);
+    ia >> boost::serialization::make_nvp("CCTagsParams", params);
+  }
+  const cctag::CCTagMarkersBank bank(params._nCrowns);
+
+  const std::vector<cv::Mat> frames = loadFrames(input, maxFrames);
+  if (frames.empty())
+  {
+    std::cerr << "No frame in " << input << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  const unsigned nCores = std::max(std::thread::hardware_concurrency(), 1u);
+  if (streamCounts.empty())
+    streamCounts = defaultStreamCounts(nCores);
+
+  std::ofstream csv;
+  if (!csvFilename.empty())
+  {
+    csv.open(csvFilename);
+    if (!csv)
+    {
+      std::cerr << "Unable to open " << csvFilename << std::endl;
+      return EXIT_FAILURE;
+    }
+    writeCsvHeader(csv);
+  }
+
+  std::cout << frames.size() << " frames of " << frames.front().cols << "x" << frames.front().rows
+            << ", " << nCores << " cores" << std::endl;
+  printSummaryHeader(std::cout);
+  for (std::size_t nStreams : streamCounts)
+  {
+    if (nStreams == 0)
+      continue;
+    const RunResult result = runStreams(nStreams, frames, nFrames, nWarmup, params, bank);
+    printSummary(std::cout, result, nCores);
+    if (csv.is_open())
+      writeCsv(csv, result, nCores);
+  }
+
+  return EXIT_SUCCESS;
+}
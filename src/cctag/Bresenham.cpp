@@ -7,206 +7,163 @@
  */
 #include <cctag/EdgePoint.hpp>
 #include <cctag/Bresenham.hpp>
-#include <cctag/utils/FileDebug.hpp>
-
-#include <boost/multi_array.hpp>
-#include <boost/math/special_functions/sign.hpp>
+#include <cctag/utils/DebugSink.hpp>
 
+#include <algorithm>
 #include <cmath>
 
 namespace cctag {
 
-static void updateXY(const float & dx, const float & dy, int & x, int & y,  float & e, int & stpX, int & stpY)
-{
-	float a = std::abs(dy/dx);
-	stpX = boost::math::sign<int>(dx);
-	stpY = boost::math::sign<int>(dy);
-	e += a;
-	x += stpX;
-	if (e>=0.5f)
-	{
-		y += stpY;
-		e -= 1;
-	}
-	return;
-}
-
-EdgePoint* gradientDirectionDescent(
+// The field line output of the vote is only written with CCTAG_SERIALIZE and
+// CCTAG_VOTE_DEBUG: otherwise the walkers are instantiated without the calls.
+#if defined(CCTAG_SERIALIZE) && defined(CCTAG_VOTE_DEBUG)
+static const bool kFieldLineDebug = true;
+#else
+static const bool kFieldLineDebug = false;
+#endif
+
+/* Walk along a field line from (x,y), in the octant given by the major axis
+ * (YMajor), the sign of the step along the major axis (SMajor) and along the
+ * minor one (SMinor), a being the slope |minor/major| of the gradient.
+ * At each step the major coordinate moves by SMajor and the error term e
+ * accumulates a; the minor coordinate moves by SMinor when e reaches 0.5.
+ * The first point probed is the one reached after two steps, then each point
+ * of the line and its neighbour back along the major axis, until nmax+1 steps.
+ * The minor coordinate moves at most once per step, so no bound check is
+ * needed for the steps before the closest border along both axes.
+ */
+template<bool YMajor, int SMajor, int SMinor, bool Debug>
+static EdgePoint* walkFieldLine(
         const EdgePointCollection& canny,
-        const EdgePoint& p,
-        int dir,
+        int x,
+        int y,
+        float a,
         std::size_t nmax,
-        const cv::Mat & imgDx, 
-        const cv::Mat & imgDy, 
-        int thrGradient)
+        CCTagFileDebug& debug)
 {
-    EdgePoint* ret = nullptr;
-    float e        = 0.0f;
-    float dx       = dir * imgDx.at<short>(p.y(),p.x());
-    float dy       = dir * imgDy.at<short>(p.y(),p.x());
-
-    float dx2 = 0;
-    float dy2 = 0;
+    const int w = int( canny.shape()[0] );
+    const int h = int( canny.shape()[1] );
 
-    float dxRef = dx;
-    float dyRef = dy;
+    int& major = YMajor ? y : x;
+    int& minor = YMajor ? x : y;
+    const int majorSize = YMajor ? h : w;
+    const int minorSize = YMajor ? w : h;
 
-    float adx = std::abs( dx );
-    float ady = std::abs( dy );
+    const std::size_t safeMajor = SMajor > 0 ? majorSize - 1 - major : major;
+    const std::size_t safeMinor = SMinor > 0 ? minorSize - 1 - minor : minor;
+    const std::size_t safeSteps = std::min( safeMajor, safeMinor );
 
-    std::size_t n = 0;
+    float e = 0.0f;
+    const auto step = [&]()
+    {
+        e += a;
+        major += SMajor;
+        if (e >= 0.5f)
+        {
+            minor += SMinor;
+            e -= 1;
+        }
+        if( Debug )
+            debug.addFieldLinePoint(x, y);
+    };
+    const auto inImage = [&]()
+    {
+        return x >= 0 && x < w && y >= 0 && y < h;
+    };
 
-    int stpX = 0;
-    int stpY = 0;
+    step();
+    step();
 
-    int x = p.x();
-    int y = p.y();
-    
-    CCTagFileDebug::instance().newVote(x,y,dx,dy);
+    if( 2 > safeSteps && !inImage() )
+        return nullptr;
+    if( EdgePoint* ret = canny(x,y) )
+        return ret;
 
-    if( ady > adx )
+    for( std::size_t n = 3; n <= nmax + 1; ++n )
     {
+        step();
 
-        updateXY(dy,dx,y,x,e,stpY,stpX);
-        CCTagFileDebug::instance().addFieldLinePoint(x, y);
-        
-        n = n+1;
-
-        if ( dx*dx+dy*dy > thrGradient )
-        {
-            dx2 = imgDx.at<short>(p.y(),p.x());
-            dy2 = imgDy.at<short>(p.y(),p.x());
-            dir = boost::math::sign<float>( dx2*dxRef+dy2*dyRef );
-            dx = dir*dx2;
-            dy = dir*dy2;
-        }
+        if( n > safeSteps && !inImage() )
+            return nullptr;
+        if( EdgePoint* ret = canny(x,y) )
+            return ret;
 
-        updateXY(dy,dx,y,x,e,stpY,stpX);
-        CCTagFileDebug::instance().addFieldLinePoint(x, y);
-        n = n+1;
+        // The previous point was in the image, so is its major coordinate.
+        if( EdgePoint* ret = YMajor ? canny(x, y - SMajor) : canny(x - SMajor, y) )
+            return ret;
+    }
+    return nullptr;
+}
 
-        if( x >= 0 && x < canny.shape()[0] &&
-            y >= 0 && y < canny.shape()[1] )
-        {
-            ret = canny(x,y);
-            if( ret )
-            {
-                    return ret;
-            }
-        }
+template<bool Debug>
+static EdgePoint* walkFieldLine(
+        const EdgePointCollection& canny,
+        int x,
+        int y,
+        float dx,
+        float dy,
+        std::size_t nmax,
+        CCTagFileDebug& debug)
+{
+    // A null minor component never moves the minor coordinate (a == 0): it is
+    // walked as a positive one.
+    if( std::abs( dy ) > std::abs( dx ) )
+    {
+        const float a = std::abs( dx/dy );
+        if( dy > 0 )
+            return dx < 0 ? walkFieldLine<true, 1, -1, Debug>(canny, x, y, a, nmax, debug)
+                          : walkFieldLine<true, 1, 1, Debug>(canny, x, y, a, nmax, debug);
         else
-        {
-                return nullptr;
-        }
-
-        while( n <= nmax)
-        {
-            updateXY(dy,dx,y,x,e, stpY,stpX);
-            CCTagFileDebug::instance().addFieldLinePoint(x, y);
-            n = n+1;
-
-            if( x >= 0 && x < canny.shape()[0] &&
-                y >= 0 && y < canny.shape()[1] )
-            {
-                ret = canny(x,y);
-                if( ret )
-                {
-                    return ret;
-                }
-                else
-                {
-                    if( x >= 0 && x < canny.shape()[0] &&
-                        ( y - stpY ) >= 0 && ( y - stpY ) < canny.shape()[1] )
-                    {
-                        ret = canny(x,y - stpY);              //#
-                        if( ret )
-                        {
-                                return ret;
-                        }
-                    }
-                    else
-                    {
-                            return nullptr;
-                    }
-                }
-            }
-            else
-            {
-                    return nullptr;
-            }
-        }
+            return dx < 0 ? walkFieldLine<true, -1, -1, Debug>(canny, x, y, a, nmax, debug)
+                          : walkFieldLine<true, -1, 1, Debug>(canny, x, y, a, nmax, debug);
     }
     else
     {
-        updateXY(dx,dy,x,y,e,stpX,stpY);
-        CCTagFileDebug::instance().addFieldLinePoint(x, y);
-        n = n+1;
+        const float a = std::abs( dy/dx );
+        if( dx > 0 )
+            return dy < 0 ? walkFieldLine<false, 1, -1, Debug>(canny, x, y, a, nmax, debug)
+                          : walkFieldLine<false, 1, 1, Debug>(canny, x, y, a, nmax, debug);
+        else
+            return dy < 0 ? walkFieldLine<false, -1, -1, Debug>(canny, x, y, a, nmax, debug)
+                          : walkFieldLine<false, -1, 1, Debug>(canny, x, y, a, nmax, debug);
+    }
+}
 
-        if ( dx*dx+dy*dy > thrGradient )
-        {
-            dx2 = imgDx.at<short>(p.y(),p.x());
-            dy2 = imgDy.at<short>(p.y(),p.x());
-            dir = boost::math::sign<float>( dx2*dxRef+dy2*dyRef );
-            dx = dir*dx2;
-            dy = dir*dy2;
-        }
+EdgePoint* gradientDirectionDescent(
+        const EdgePointCollection& canny,
+        const EdgePoint& p,
+        int dir,
+        std::size_t nmax,
+        const cv::Mat & imgDx, 
+        const cv::Mat & imgDy, 
+        int thrGradient,
+        DebugSink& debug)
+{
+    const int x = p.x();
+    const int y = p.y();
+    const float dx = dir * imgDx.ptr<short>(y)[x];
+    const float dy = dir * imgDy.ptr<short>(y)[x];
 
-        updateXY(dx,dy,x,y,e,stpX,stpY);
-        CCTagFileDebug::instance().addFieldLinePoint(x, y);
-        n = n+1;
+    if( kFieldLineDebug )
+        debug.file().newVote(x,y,dx,dy);
 
-        if( x >= 0 && x < canny.shape()[0] &&
-            y >= 0 && y < canny.shape()[1] )
-        {
-            ret = canny(x,y);
-            if( ret )
-            {
-                return ret;
-            }
-        }
-        else
-        {
-            return nullptr;
-        }
+    // Above thrGradient, the direction used to be re-read from the gradient at
+    // p and re-oriented along (dx,dy): that is the direction of (dx,dy) itself,
+    // so the walk does not depend on thrGradient.
+    (void) thrGradient;
 
-        while( n <= nmax)
+    // A null gradient does not move: the walk stays on p.
+    if( dx == 0 && dy == 0 )
+    {
+        if( kFieldLineDebug )
         {
-            updateXY(dx,dy,x,y,e,stpX,stpY);
-            CCTagFileDebug::instance().addFieldLinePoint(x, y);
-            n = n+1;
-
-            if( x >= 0 && x < canny.shape()[0] &&
-                y >= 0 && y < canny.shape()[1] )
-            {
-                ret = canny(x,y);
-                if( ret )
-                {
-                    return ret;
-                }
-                else
-                {
-                    if( ( x - stpX ) >= 0 && ( x - stpX ) < canny.shape()[0] &&
-                        y >= 0 && y < canny.shape()[1] )
-                    {
-                        ret = canny(x - stpX,y);
-                        if( ret )
-                        {
-                                return ret;
-                        }
-                    }
-                    else
-                    {
-                        return nullptr;
-                    }
-                }
-            }
-            else
-            {
-                return nullptr;
-            }
+            debug.file().addFieldLinePoint(x, y);
+            debug.file().addFieldLinePoint(x, y);
         }
+        return canny(x,y);
     }
-    return nullptr;
+
+    return walkFieldLine<kFieldLineDebug>(canny, x, y, dx, dy, nmax, debug.file());
 }
 
 } // namespace cctag
@@ -19,9 +19,12 @@
 namespace cctag {
 
 class EdgePoint;
+class DebugSink;
 
 /** @brief descent in the gradient direction from a maximum gradient point (magnitude sense) to another one.
  *
+ * The walk is dispatched once per call to a walker specialised for the octant
+ * of the gradient; thrGradient is kept for compatibility and has no effect.
  */
 
 EdgePoint* gradientDirectionDescent(
@@ -31,7 +34,8 @@ EdgePoint* gradientDirectionDescent(
   std::size_t nmax,
   const cv::Mat & imgDx,
   const cv::Mat & imgDy,
-  int thrGradient);
+  int thrGradient,
+  DebugSink& debug);
 
 } // namespace cctag
 
@@ -54,6 +54,7 @@ public:
   CCTag()
     : _id(0)
     , _quality(0)
+    , _centerEvaluations(0)
     , _status(0)
 #ifdef WITH_CUDA
     , _cuda_result( nullptr )
@@ -76,6 +77,7 @@ public:
     , _points(points)
     , _mHomography(homography)
     , _quality(quality)
+    , _centerEvaluations(0)
     , _pyramidLevel(pyramidLevel)
     , _scale(scale)
 #ifdef WITH_CUDA
@@ -99,6 +101,7 @@ public:
     , _points(cctag._points)
     , _mHomography(cctag._mHomography)
     , _quality(cctag._quality)
+    , _centerEvaluations(cctag._centerEvaluations)
     , _pyramidLevel(cctag._pyramidLevel)
     , _scale(cctag._scale)
     , _rescaledOuterEllipse(cctag._rescaledOuterEllipse)
@@ -203,6 +206,17 @@ public:
     _quality = quality;
   }
 
+  /// Number of cost evaluations spent by the optimization of the imaged center (0 if not run on the CPU)
+  std::size_t centerEvaluations() const
+  {
+    return _centerEvaluations;
+  }
+
+  void setCenterEvaluations(const std::size_t nEvaluations)
+  {
+    _centerEvaluations = nEvaluations;
+  }
+
   float scale() const
   {
     return _scale;
@@ -248,6 +262,30 @@ public:
     _rescaledOuterEllipsePoints = outerEllipsePoints;
   }
 
+  void setRescaledOuterEllipsePoints(std::vector< DirectedPoint2d<Eigen::Vector3f> > && outerEllipsePoints)
+  {
+    _rescaledOuterEllipsePoints = std::move(outerEllipsePoints);
+  }
+
+  /**
+   * @brief Free the edge points of the crowns, no longer needed once the outer
+   * ellipse points are rescaled to level 0 (Parameters::_resultOnly).
+   */
+  void releasePoints()
+  {
+    std::vector< std::vector< DirectedPoint2d<Eigen::Vector3f> > >().swap(_points);
+  }
+
+  /**
+   * @brief Free the outer ellipse points and the id candidates, no longer
+   * needed once identified (Parameters::_resultOnly).
+   */
+  void releaseIdentificationData()
+  {
+    std::vector< DirectedPoint2d<Eigen::Vector3f> >().swap(_rescaledOuterEllipsePoints);
+    IdSet().swap(_idSet);
+  }
+
   const cctag::numerical::geometry::Ellipse & rescaledOuterEllipse() const
   {
     return _rescaledOuterEllipse;
@@ -389,6 +427,7 @@ protected:
   std::vector< std::vector< DirectedPoint2d<Eigen::Vector3f> > > _points;
   Eigen::Matrix3f _mHomography;
   float _quality;
+  std::size_t _centerEvaluations;
   int    _pyramidLevel;
   float _scale;
   int    _status;
@@ -420,6 +459,7 @@ static const int no_selected_cuts = -2;
 static const int opti_has_diverged = -3;
 static const int id_not_reliable = -4;
 static const int degenerate = -5;
+static const int no_ring_profile = -6;
 }
 
 } // namespace cctag
@@ -9,10 +9,13 @@
 #include <cctag/utils/Exceptions.hpp>
 #include <cctag/utils/Defines.hpp>
 
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
 #include <boost/numeric/conversion/bounds.hpp>
 #include <boost/throw_exception.hpp>
 
 #include <cmath>
+#include <cstring>
 #include <fstream>
 #include <vector>
 
@@ -57,14 +60,31 @@ CCTagMarkersBank::CCTagMarkersBank( const std::string & file )
 }
 
 
+const char CCTagMarkersBank::kBinaryMagic[8] = { 'C', 'C', 'T', 'A', 'G', 'B', 'N', 'K' };
+const std::uint32_t CCTagMarkersBank::kBinaryByteOrder;
+const std::uint32_t CCTagMarkersBank::kBinaryVersion;
+const std::uint32_t CCTagMarkersBank::kBinaryMaxRatios;
+
 void CCTagMarkersBank::read( const std::string & file )
 {
-  std::ifstream input( file.c_str() );
+  std::ifstream input( file.c_str(), std::ios::binary );
   if ( !input.good() )
   {
     BOOST_THROW_EXCEPTION( exception::Value()
                            << exception::dev() + "Unable to open the bank file: " + file );
   }
+
+  char magic[sizeof(kBinaryMagic)] = {};
+  input.read( magic, sizeof(magic) );
+  if ( input.gcount() == sizeof(magic) && std::memcmp( magic, kBinaryMagic, sizeof(magic) ) == 0 )
+  {
+    input.close();
+    readBinary( file );
+    return;
+  }
+  input.clear();
+  input.seekg( 0 );
+
   std::string str;
   while ( std::getline( input, str ) )
   {
@@ -78,6 +98,91 @@ void CCTagMarkersBank::read( const std::string & file )
   input.close();
 }
 
+void CCTagMarkersBank::readBinary( const std::string & file )
+{
+  namespace bip = boost::interprocess;
+
+  const bip::file_mapping mapping( file.c_str(), bip::read_only );
+  const bip::mapped_region region( mapping, bip::read_only );
+  const char* data = static_cast<const char*>( region.get_address() );
+  const std::size_t size = region.get_size();
+
+  BinaryHeader header;
+  if ( size < sizeof(header) )
+  {
+    BOOST_THROW_EXCEPTION( exception::Value()
+                           << exception::dev() + "Truncated binary bank file: " + file );
+  }
+  std::memcpy( &header, data, sizeof(header) );
+  if ( header.byteOrder != kBinaryByteOrder || header.version != kBinaryVersion )
+  {
+    BOOST_THROW_EXCEPTION( exception::Value()
+                           << exception::dev() + "Unsupported binary bank file (version or byte order): " + file );
+  }
+  if ( header.nMarkers == 0 )
+  {
+    return;
+  }
+  const std::size_t nRatios = header.nRatios;
+  if ( nRatios == 0 || nRatios > kBinaryMaxRatios )
+  {
+    BOOST_THROW_EXCEPTION( exception::Value()
+                           << exception::dev() + "Invalid number of ratios in binary bank file: " + file );
+  }
+  // Compared by division so that a corrupted nMarkers cannot overflow the size.
+  if ( header.nMarkers > ( size - sizeof(header) ) / ( nRatios * sizeof(float) ) )
+  {
+    BOOST_THROW_EXCEPTION( exception::Value()
+                           << exception::dev() + "Truncated binary bank file: " + file );
+  }
+
+  // The rows are copied straight from the mapping, nothing is parsed.
+  const char* ratios = data + sizeof(header);
+  _markers.reserve( _markers.size() + header.nMarkers );
+  for ( std::uint32_t i = 0; i < header.nMarkers; ++i )
+  {
+    std::vector<float> rr( nRatios );
+    std::memcpy( rr.data(), ratios + i * nRatios * sizeof(float), nRatios * sizeof(float) );
+    _markers.push_back( std::move( rr ) );
+  }
+}
+
+void CCTagMarkersBank::writeBinary( const std::string & file ) const
+{
+  BinaryHeader header;
+  std::memcpy( header.magic, kBinaryMagic, sizeof(header.magic) );
+  header.byteOrder = kBinaryByteOrder;
+  header.version = kBinaryVersion;
+  header.nMarkers = std::uint32_t( _markers.size() );
+  header.nRatios = _markers.empty() ? 0 : std::uint32_t( _markers.front().size() );
+
+  for ( const std::vector<float> & marker : _markers )
+  {
+    if ( marker.size() != header.nRatios )
+    {
+      BOOST_THROW_EXCEPTION( exception::Value()
+                             << exception::dev() + "The markers of a binary bank must have the same number of ratios" );
+    }
+  }
+  if ( header.nRatios > kBinaryMaxRatios )
+  {
+    BOOST_THROW_EXCEPTION( exception::Value()
+                           << exception::dev() + "Too many ratios per marker for a binary bank" );
+  }
+
+  std::ofstream output( file.c_str(), std::ios::binary );
+  if ( !output.good() )
+  {
+    BOOST_THROW_EXCEPTION( exception::Value()
+                           << exception::dev() + "Unable to create the bank file: " + file );
+  }
+  output.write( reinterpret_cast<const char*>( &header ), sizeof(header) );
+  for ( const std::vector<float> & marker : _markers )
+  {
+    output.write( reinterpret_cast<const char*>( marker.data() ), marker.size() * sizeof(float) );
+  }
+}
+
 std::size_t CCTagMarkersBank::identify( const std::vector<float> & marker ) const
 {
   std::vector< std::vector<float> >::const_iterator itm = _markers.begin();
@@ -15,6 +15,7 @@
 #include <boost/spirit/include/qi.hpp>
 
 #include <cstddef>
+#include <cstdint>
 #include <fstream>
 #include <iostream>
 #include <string>
@@ -31,14 +32,42 @@ public:
   
   virtual ~CCTagMarkersBank() = default;
 
+  /**
+   * @brief Append the markers of a bank file, either a text file (one marker
+   * per line, e.g. "1/2 0.4") or a binary bank written by writeBinary(), which
+   * is memory-mapped instead of parsed.
+   */
   void read( const std::string & file );
+
+  /**
+   * @brief Write the bank in the binary format: a BinaryHeader followed by the
+   * ratios of the markers, row by row, as native floats.
+   */
+  void writeBinary( const std::string & file ) const;
+
   std::size_t identify( const std::vector<float> & marker ) const;
   inline const std::vector< std::vector<float> > & getMarkers() const
   {
     return _markers;
   }
 
+  struct BinaryHeader
+  {
+    char magic[8];           // kBinaryMagic
+    std::uint32_t byteOrder; // kBinaryByteOrder as written by the producer
+    std::uint32_t version;
+    std::uint32_t nMarkers;
+    std::uint32_t nRatios;   // ratios per marker
+  };
+
+  static const char kBinaryMagic[8];
+  static const std::uint32_t kBinaryByteOrder = 0x01020304;
+  static const std::uint32_t kBinaryVersion = 1;
+  static const std::uint32_t kBinaryMaxRatios = 64; // sanity bound on nRatios, 5 or 7 in practice
+
 private:
+  void readBinary( const std::string & file );
+
   template <typename Iterator>
   bool cctagLineParse( Iterator first, Iterator last, std::vector<float>& rr )
   {
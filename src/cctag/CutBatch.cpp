@@ -0,0 +1,83 @@
+/*
+ * Copyright 2016, Simula Research Laboratory
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+#include <cctag/CutBatch.hpp>
+
+namespace cctag {
+
+void CutBatch::clear()
+{
+  _startX.clear();
+  _startY.clear();
+  _stopX.clear();
+  _stopY.clear();
+  _stopDX.clear();
+  _stopDY.clear();
+  _beginSig.clear();
+  _endSig.clear();
+  _signals.clear();
+  _outOfBounds.clear();
+}
+
+void CutBatch::reserve( std::size_t nCuts )
+{
+  _startX.reserve(nCuts);
+  _startY.reserve(nCuts);
+  _stopX.reserve(nCuts);
+  _stopY.reserve(nCuts);
+  _stopDX.reserve(nCuts);
+  _stopDY.reserve(nCuts);
+  _beginSig.reserve(nCuts);
+  _endSig.reserve(nCuts);
+  _signals.reserve( nCuts * _stride );
+  _outOfBounds.reserve( (nCuts+63)/64 );
+}
+
+void CutBatch::pushBack(
+        const Point2d<Eigen::Vector3f> & start,
+        const DirectedPoint2d<Eigen::Vector3f> & stop,
+        float beginSig,
+        float endSig )
+{
+  _startX.push_back( start.x() );
+  _startY.push_back( start.y() );
+  _stopX.push_back( stop.x() );
+  _stopY.push_back( stop.y() );
+  _stopDX.push_back( stop.dX() );
+  _stopDY.push_back( stop.dY() );
+  _beginSig.push_back( beginSig );
+  _endSig.push_back( endSig );
+  _signals.resize( size() * _stride );
+  if ( _outOfBounds.size() * 64 < size() )
+    _outOfBounds.push_back( 0 );
+  setOutOfBounds( size()-1, false );
+}
+
+void CutBatch::popBack()
+{
+  setOutOfBounds( size()-1, false );
+  _startX.pop_back();
+  _startY.pop_back();
+  _stopX.pop_back();
+  _stopY.pop_back();
+  _stopDX.pop_back();
+  _stopDY.pop_back();
+  _beginSig.pop_back();
+  _endSig.pop_back();
+  _signals.resize( size() * _stride );
+  _outOfBounds.resize( (size()+63)/64 );
+}
+
+void CutBatch::resizeSignals( std::size_t nSamples )
+{
+  const std::size_t floatsPerAlignment = kAlignment / sizeof(float);
+  _nSamples = nSamples;
+  _stride = ( nSamples + floatsPerAlignment - 1 ) / floatsPerAlignment * floatsPerAlignment;
+  _signals.resize( size() * _stride );
+}
+
+} // namespace cctag
@@ -0,0 +1,118 @@
+/*
+ * Copyright 2016, Simula Research Laboratory
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+#ifndef _CCTAG_CUTBATCH_HPP_
+#define	_CCTAG_CUTBATCH_HPP_
+
+#include <cctag/ImageCut.hpp>
+
+#include <boost/align/aligned_allocator.hpp>
+
+#include <cstdint>
+#include <vector>
+
+namespace cctag {
+
+/**
+ * @brief A set of image cuts stored as structure of arrays: the cut extremities
+ * in one array per coordinate, all the rectified signals in a single aligned
+ * matrix (one row per cut) and the out of bounds flags in a bitmask.
+ * Used by the identification, from the collection of the cuts to the reading
+ * of the rectified signals, instead of std::vector<ImageCut>.
+ */
+class CutBatch
+{
+public:
+  // Alignment (in bytes) of the signal matrix and of each of its rows.
+  static const std::size_t kAlignment = 32;
+
+  CutBatch() = default;
+
+  std::size_t size() const { return _stopX.size(); }
+  bool empty() const { return _stopX.empty(); }
+
+  // Remove all the cuts, the number of samples is kept.
+  void clear();
+
+  void reserve( std::size_t nCuts );
+
+  /**
+   * @brief Append a cut, within the image bounds, whose nSamples() signal
+   * samples are undefined.
+   */
+  void pushBack( const Point2d<Eigen::Vector3f> & start,
+                 const DirectedPoint2d<Eigen::Vector3f> & stop,
+                 float beginSig,
+                 float endSig );
+
+  // Remove the last cut.
+  void popBack();
+
+  // Number of samples of each signal.
+  std::size_t nSamples() const { return _nSamples; }
+
+  // Resize all the signals, the sample values are then undefined.
+  void resizeSignals( std::size_t nSamples );
+
+  Point2d<Eigen::Vector3f> start( std::size_t iCut ) const
+  {
+    return Point2d<Eigen::Vector3f>( _startX[iCut], _startY[iCut] );
+  }
+
+  DirectedPoint2d<Eigen::Vector3f> stop( std::size_t iCut ) const
+  {
+    return DirectedPoint2d<Eigen::Vector3f>( _stopX[iCut], _stopY[iCut], _stopDX[iCut], _stopDY[iCut] );
+  }
+
+  float startX( std::size_t iCut ) const { return _startX[iCut]; }
+  float startY( std::size_t iCut ) const { return _startY[iCut]; }
+  float stopX( std::size_t iCut ) const { return _stopX[iCut]; }
+  float stopY( std::size_t iCut ) const { return _stopY[iCut]; }
+  float beginSig( std::size_t iCut ) const { return _beginSig[iCut]; }
+  float endSig( std::size_t iCut ) const { return _endSig[iCut]; }
+
+  float* signal( std::size_t iCut ) { return &_signals[iCut*_stride]; }
+  const float* signal( std::size_t iCut ) const { return &_signals[iCut*_stride]; }
+
+  bool outOfBounds( std::size_t iCut ) const
+  {
+    return ( _outOfBounds[iCut/64] >> (iCut%64) ) & 1u;
+  }
+
+  void setOutOfBounds( std::size_t iCut, bool outOfBounds )
+  {
+    const std::uint64_t bit = std::uint64_t(1) << (iCut%64);
+    if ( outOfBounds )
+      _outOfBounds[iCut/64] |= bit;
+    else
+      _outOfBounds[iCut/64] &= ~bit;
+  }
+
+  // Out of bounds flags of all the cuts, 64 cuts per word.
+  const std::vector<std::uint64_t> & outOfBoundsMask() const { return _outOfBounds; }
+  void setOutOfBoundsMask( const std::vector<std::uint64_t> & mask ) { _outOfBounds = mask; }
+
+private:
+  std::vector<float> _startX;
+  std::vector<float> _startY;
+  std::vector<float> _stopX;
+  std::vector<float> _stopY;
+  std::vector<float> _stopDX; // gradient at the stop (outer) point
+  std::vector<float> _stopDY;
+  std::vector<float> _beginSig;
+  std::vector<float> _endSig;
+
+  std::size_t _nSamples = 0;
+  std::size_t _stride = 0; // distance between two rows of the signal matrix
+  std::vector<float, boost::alignment::aligned_allocator<float, kAlignment> > _signals;
+
+  std::vector<std::uint64_t> _outOfBounds;
+};
+
+} // namespace cctag
+
+#endif
@@ -5,11 +5,10 @@
  * License, v. 2.0. If a copy of the MPL was not distributed with this
  * file, You can obtain one at http://mozilla.org/MPL/2.0/.
  */
-#include <cctag/utils/FileDebug.hpp>
+#include <cctag/utils/DebugSink.hpp>
 #include <cctag/EllipseGrowing.hpp>
 #include <cctag/Detection.hpp>
 #include <cctag/Vote.hpp>
-#include <cctag/utils/VisualDebug.hpp>
 #include <cctag/Multiresolution.hpp>
 #include <cctag/Fitting.hpp>
 #include <cctag/CCTagFlowComponent.hpp>
@@ -24,6 +23,7 @@
 #include <cctag/Canny.hpp>
 #include <cctag/utils/Defines.hpp>
 #include <cctag/utils/Talk.hpp> // for DO_TALK macro
+#include <cctag/utils/Trace.hpp>
 #ifdef WITH_CUDA
 #include "cctag/cuda/tag.h"
 #endif
@@ -44,6 +44,9 @@
 #include <list>
 #include <utility>
 #include <memory>
+#include <algorithm>
+#include <atomic>
+#include <unordered_map>
 #ifdef WITH_CUDA
 #include <cuda_runtime.h> // only for debugging
 #endif // WITH_CUDA
@@ -65,72 +68,176 @@ namespace { using CandidatePtr = std::unique_ptr<Candidate>; }
  */
 std::vector<cctag::TagPipe*> cudaPipelines;
 
-static void constructFlowComponentFromSeed(
+/* Builds the flow component of a seed. Returns an empty pointer if the seed
+ * already belongs to a reconstructed flow component. No shared state is
+ * written besides the edge collection, the caller is responsible for
+ * collecting and ranking the returned candidates.
+ * If deferredProcessedIn is given, the linking is speculative: the edge points
+ * are not flagged as processed but returned in deferredProcessedIn, see
+ * commitFlowComponentsLoopOne. */
+static CandidatePtr constructFlowComponentFromSeed(
         EdgePoint * seed,
         EdgePointCollection& edgeCollection,
-        std::vector<CandidatePtr> & vCandidateLoopOne,
+        std::vector<EdgePoint*> * deferredProcessedIn,
         const Parameters & params)
 {
-  static tbb::mutex G_SortMutex;
-  
   assert( seed );
   // Check if the seed has already been processed, i.e. belongs to an already
   // reconstructed flow component.
-  if (!edgeCollection.test_processed_in(seed))
+  if (!deferredProcessedIn && edgeCollection.test_processed_in(seed))
   {
+    return CandidatePtr();
+  }
 
-    CandidatePtr candidate(new Candidate);
+  CandidatePtr candidate(new Candidate);
 
-    candidate->_seed = seed;
-    std::list<EdgePoint*> & convexEdgeSegment = candidate->_convexEdgeSegment;
+  candidate->_seed = seed;
+  std::list<EdgePoint*> & convexEdgeSegment = candidate->_convexEdgeSegment;
 
-    // Convex edge linking from the seed in both directions. The linking
-    // is performed until the convexity is lost.
+  // Convex edge linking from the seed in both directions. The linking
+  // is performed until the convexity is lost.
+  if (deferredProcessedIn)
+  {
+    const EdgePointCollection& constEdgeCollection = edgeCollection;
+    edgeLinking(constEdgeCollection, convexEdgeSegment, *deferredProcessedIn, seed,
+            params._windowSizeOnInnerEllipticSegment, params._averageVoteMin);
+  }
+  else
+  {
     edgeLinking(edgeCollection, convexEdgeSegment, seed,
             params._windowSizeOnInnerEllipticSegment, params._averageVoteMin);
+  }
 
-    // Compute the average number of received points.
-    int nReceivedVote = 0;
-    int nVotedPoints = 0;
+  // Compute the average number of received points.
+  int nReceivedVote = 0;
+  int nVotedPoints = 0;
 
-    for (EdgePoint* p : convexEdgeSegment)
+  for (EdgePoint* p : convexEdgeSegment)
+  {
+    auto votersSize = edgeCollection.voters_size(p);
+    nReceivedVote += votersSize;
+    if (votersSize > 0)
+      ++nVotedPoints;
+  }
+
+  candidate->_averageReceivedVote = (float) (nReceivedVote*nReceivedVote) / (float) nVotedPoints;
+  return candidate;
+}
+
+/* Commits the speculative flow components by seed rank, i.e. in the order a
+ * serial run would have built them: a flow component whose seed has been
+ * reached by a previously committed one is dropped, otherwise its edge points
+ * are flagged as processed. */
+static void commitFlowComponentsLoopOne(
+        EdgePointCollection& edgeCollection,
+        std::vector<CandidatePtr> & vCandidateLoopOne,
+        const std::vector<std::vector<EdgePoint*> > & vProcessedIn)
+{
+  for (std::size_t iSeed = 0; iSeed < vCandidateLoopOne.size(); ++iSeed)
+  {
+    CandidatePtr & candidate = vCandidateLoopOne[iSeed];
+    if (!candidate)
+      continue;
+
+    if (edgeCollection.test_processed_in(candidate->_seed))
     {
-      auto votersSize = edgeCollection.voters_size(p);
-      nReceivedVote += votersSize;
-      if (votersSize > 0)
-        ++nVotedPoints;
+      candidate.reset();
+      continue;
     }
-    
+
+    for (EdgePoint* p : vProcessedIn[iSeed])
+    {
+      edgeCollection.set_processed_in(p, true);
+    }
+  }
+}
+
+/* Compacts the per-seed slots filled by the first loop and ranks the
+ * candidates by decreasing average received vote. The sort is stable on the
+ * seed order so that the ranking does not depend on the thread scheduling. */
+static void rankCandidatesLoopOne(std::vector<CandidatePtr> & vCandidateLoopOne)
+{
+  vCandidateLoopOne.erase(
+    std::remove(vCandidateLoopOne.begin(), vCandidateLoopOne.end(), nullptr),
+    vCandidateLoopOne.end());
+
+  std::stable_sort(vCandidateLoopOne.begin(), vCandidateLoopOne.end(),
+    [](const CandidatePtr& c1, const CandidatePtr& c2) { return c1->_averageReceivedVote > c2->_averageReceivedVote; });
+}
+
+/* Outcome of completeFlowComponent. A flow component may be rejected after
+ * it has been labelled, its label is then still seen by the next ones. */
+enum FlowComponentOutcome
+{
+  kFlowComponentRejected = 0,
+  kFlowComponentLabelledRejected,
+  kFlowComponentKept
+};
+
+/* Gives the flow component the label of the first of its filtered children
+ * already labelled by another flow component, or a new label. */
+static void labelFlowComponent(
+  const EdgePointCollection& edgeCollection,
+  Candidate & candidate,
+  std::atomic<std::size_t>& nSegmentOut)
+{
+  ssize_t nSegmentCommon = -1;
+
+  for(EdgePoint * p : candidate._filteredChildren)
+  {
+    if (edgeCollection.n_segment_out(p) != -1)
     {
-      tbb::mutex::scoped_lock lock(G_SortMutex);
-      candidate->_averageReceivedVote = (float) (nReceivedVote*nReceivedVote) / (float) nVotedPoints;
-      auto it = std::lower_bound(vCandidateLoopOne.begin(), vCandidateLoopOne.end(), candidate,
-        [](const CandidatePtr& c1, const CandidatePtr& c2) { return c1->_averageReceivedVote > c2->_averageReceivedVote; });
-      vCandidateLoopOne.insert(it, std::move(candidate));
+      nSegmentCommon = edgeCollection.n_segment_out(p);
+      break;
     }
   }
+
+  std::size_t nLabel;
+  if (nSegmentCommon == -1)
+  {
+    nLabel = nSegmentOut.fetch_add(1);
+  }
+  else
+  {
+    nLabel = nSegmentCommon;
+  }
+
+  for(EdgePoint * p : candidate._filteredChildren)
+  {
+    edgeCollection.n_segment_out(p) = nLabel;
+  }
+  candidate._nLabel = nLabel;
 }
 
-static void completeFlowComponent(
+/* Recovers the outer ellipse of a flow component, the candidate is completed
+ * in place. If nSegmentOut is null, the labelling is left to the caller
+ * (labelFlowComponent must then be called in rank order on the flow components
+ * which have reached that stage). */
+static FlowComponentOutcome completeFlowComponent(
   Candidate & candidate,
   const EdgePointCollection& edgeCollection,
-  std::vector<Candidate> & vCandidateLoopTwo,
-  std::size_t& nSegmentOut,
+  std::atomic<std::size_t>* nSegmentOut,
   std::size_t runId,
-  const Parameters & params)
+  const Parameters & params,
+  std::size_t* robustIterations,
+  DebugSink& debug)
 {
-  static tbb::spin_mutex G_UpdateMutex;
-  static tbb::mutex G_InsertMutex;
-  
+  FlowComponentOutcome rejected = kFlowComponentRejected;
   try
   {
+    if (params._deterministic)
+    {
+      // Robust estimations draw from a stream of their own per flow component.
+      numerical::rand_5_k_reseed(edgeCollection(candidate._seed));
+    }
+
     std::list<EdgePoint*> children;
 
     childrenOf(edgeCollection, candidate._convexEdgeSegment, children);
 
     if (children.size() < params._minPointsSegmentCandidate)
     {
-      return;
+      return rejected;
     }
 
     candidate._score = children.size();
@@ -144,48 +251,22 @@ static void completeFlowComponent(
             filteredChildren,
             SmFinal, 
             params._threshRobustEstimationOfOuterEllipse,
+            debug,
             kWeight,
-            60);
+            60,
+            robustIterations);
 
     if (filteredChildren.size() < 5)
     {
       DO_TALK( CCTAG_COUT_DEBUG(" filteredChildren.size() < 5 "); )
-      return;
+      return rejected;
     }
 
-    std::size_t nLabel = -1;
-
+    if (nSegmentOut)
     {
-      ssize_t nSegmentCommon = -1;
-
-      for(EdgePoint * p : filteredChildren)
-      {
-        if (p->_nSegmentOut != -1)
-        {
-          nSegmentCommon = p->_nSegmentOut;
-          break;
-        }
-      }
-      
-
-      if (nSegmentCommon == -1)
-      {
-        {
-          tbb::spin_mutex::scoped_lock lock(G_UpdateMutex);
-          nLabel = nSegmentOut;
-          ++nSegmentOut;
-        }
-      }
-      else
-      {
-        nLabel = nSegmentCommon;
-      }
-
-      for(EdgePoint * p : filteredChildren)
-      {
-        p->_nSegmentOut = nLabel;
-      }
+      labelFlowComponent(edgeCollection, candidate, *nSegmentOut);
     }
+    rejected = kFlowComponentLabelledRejected;
 
     std::vector<EdgePoint*> & outerEllipsePoints = candidate._outerEllipsePoints;
     cctag::numerical::geometry::Ellipse & outerEllipse = candidate._outerEllipse;
@@ -197,8 +278,6 @@ static void completeFlowComponent(
     ellipseGrowing2(edgeCollection, filteredChildren, outerEllipsePoints, outerEllipse,
                     params._ellipseGrowingEllipticHullWidth, runId, goodInit);
 
-    candidate._nLabel = nLabel;
-
     std::vector<float> vDistFinal;
     vDistFinal.clear();
     vDistFinal.reserve(outerEllipsePoints.size());
@@ -221,39 +300,35 @@ static void completeFlowComponent(
     if (SmFinal > params._thrMedianDistanceEllipse)
     {
       DO_TALK( CCTAG_COUT_DEBUG("SmFinal < params._thrMedianDistanceEllipse -- after ellipseGrowing"); )
-      return;
+      return rejected;
     }
 
     float quality = (float) outerEllipsePoints.size() / (float) rasterizeEllipsePerimeter(outerEllipse);
     if (quality > 1.1)
     {
       DO_TALK( CCTAG_COUT_DEBUG("Quality too high!"); )
-      return;
+      return rejected;
     }
 
     float ratioSemiAxes = outerEllipse.a() / outerEllipse.b();
     if ((ratioSemiAxes < 0.05) || (ratioSemiAxes > 20))
     {
       DO_TALK( CCTAG_COUT_DEBUG("Too high semi-axis ratio!"); )
-      return;
-    }
-
-    {
-      tbb::mutex::scoped_lock lock(G_InsertMutex);
-      vCandidateLoopTwo.push_back(candidate);
+      return rejected;
     }
 
 #ifdef CCTAG_SERIALIZE
     // Add children to output the filtering results (from outlierRemoval)
-    vCandidateLoopTwo.back().setchildren(children);
+    candidate.setchildren(children);
 
     // Write all selectedFlowComponent
     CCTagFlowComponent flowComponent(edgeCollection, outerEllipsePoints, children, filteredChildren,
                                      outerEllipse, candidate._convexEdgeSegment,
                                     *(candidate._seed), params._nCircles);
-    CCTagFileDebug::instance().outputFlowComponentInfos(flowComponent);
+    debug.file().outputFlowComponentInfos(flowComponent);
 #endif
 
+    return kFlowComponentKept;
   }
   catch (cv::Exception& e)
   {
@@ -263,6 +338,7 @@ static void completeFlowComponent(
   {
     DO_TALK( CCTAG_COUT_DEBUG( "Exception raised in the second main loop." ); )
   }
+  return rejected;
 }
 
 /* Brief: Aims to assemble two flow components if they lie on the same image CCTag
@@ -282,7 +358,8 @@ static void flowComponentAssembling(
         numerical::geometry::Ellipse & outerEllipse,
         std::vector<EdgePoint*>& outerEllipsePoints,
         std::vector< std::vector< DirectedPoint2d<Eigen::Vector3f> > >& cctagPoints,
-        const Parameters & params
+        const Parameters & params,
+        DebugSink& debug
 #ifndef CCTAG_SERIALIZE
         )
 #else
@@ -299,7 +376,7 @@ static void flowComponentAssembling(
   float ratioExpension = 2.5;
   numerical::geometry::Circle circularResearchArea(
          Point2d<Eigen::Vector3f>( candidate._seed->x(), candidate._seed->y() ),
-         candidate._seed->_flowLength * ratioExpension);
+         edgeCollection.flow_length(candidate._seed) * ratioExpension);
 
   {
     int i = 0;
@@ -310,8 +387,8 @@ static void flowComponentAssembling(
       {
         if (candidate._nLabel != anotherCandidate._nLabel)
         {
-          if ((anotherCandidate._seed->_flowLength / candidate._seed->_flowLength > 0.666)
-                  && (anotherCandidate._seed->_flowLength / candidate._seed->_flowLength < 1.5))
+          const float flowLengthRatio = edgeCollection.flow_length(anotherCandidate._seed) / edgeCollection.flow_length(candidate._seed);
+          if ((flowLengthRatio > 0.666) && (flowLengthRatio < 1.5))
           {
             if (isInEllipse(circularResearchArea, 
                     cctag::Point2d<Eigen::Vector3f>(float(anotherCandidate._seed->x()), float(anotherCandidate._seed->y()))))
@@ -324,25 +401,25 @@ static void flowComponentAssembling(
             }
             else
             {
-              CCTagFileDebug::instance().setResearchArea(circularResearchArea);
-              CCTagFileDebug::instance().outputFlowComponentAssemblingInfos(NOT_IN_RESEARCH_AREA);
+              debug.file().setResearchArea(circularResearchArea);
+              debug.file().outputFlowComponentAssemblingInfos(NOT_IN_RESEARCH_AREA);
             }
           }
           else
           {
-            CCTagFileDebug::instance().outputFlowComponentAssemblingInfos(FLOW_LENGTH);
+            debug.file().outputFlowComponentAssemblingInfos(FLOW_LENGTH);
           }
         }
         else
         {
-          CCTagFileDebug::instance().outputFlowComponentAssemblingInfos(SAME_LABEL);
+          debug.file().outputFlowComponentAssemblingInfos(SAME_LABEL);
         }
       }
       ++i;
   #if defined CCTAG_SERIALIZE && defined DEBUG
       if (i < vCandidateLoopTwo.size())
       {
-        CCTagFileDebug::instance().incrementFlowComponentIndex(1);
+        debug.file().incrementFlowComponentIndex(1);
       }
   #endif
     }
@@ -359,14 +436,14 @@ static void flowComponentAssembling(
     if( isAnotherSegment(edgeCollection, outerEllipse, outerEllipsePoints, 
             selectedCandidate._filteredChildren, selectedCandidate,
             cctagPoints, params._nCrowns * 2,
-            params._thrMedianDistanceEllipse) )
+            params._thrMedianDistanceEllipse, debug) )
     {
       quality = (float) outerEllipsePoints.size() / (float) rasterizeEllipsePerimeter(outerEllipse);
 
 #ifdef CCTAG_SERIALIZE
       componentCandidates.push_back(selectedCandidate);
 #endif
-      CCTagFileDebug::instance().setFlowComponentAssemblingState(true, iMax);
+      debug.file().setFlowComponentAssemblingState(true, iMax);
     }
   }
 
@@ -375,24 +452,32 @@ static void flowComponentAssembling(
   const float spendTime = d.total_milliseconds();
 }
 
-static void cctagDetectionFromEdgesLoopTwoIteration(
-  CCTag::List& markers,
+/* Returns the marker built from the iCandidate-th flow component, or an
+ * empty pointer if the candidate is rejected. */
+static std::unique_ptr<CCTag> cctagDetectionFromEdgesLoopTwoIteration(
   EdgePointCollection& edgeCollection,
   const std::vector<Candidate>& vCandidateLoopTwo,
   size_t iCandidate,
   int pyramidLevel,
   float scale,
-  const Parameters& params)
+  const Parameters& params,
+  LoopTwoOutcome& outcome,
+  DebugSink& debug)
 {
-    static tbb::mutex G_InsertMutex;
-    
+    CCTAG_TRACE_SPAN("loop two candidate", iCandidate);
+
     const Candidate& candidate = vCandidateLoopTwo[iCandidate];
 
+    if (params._deterministic)
+    {
+      numerical::rand_5_k_reseed(edgeCollection(candidate._seed));
+    }
+
 #ifdef CCTAG_SERIALIZE
-    CCTagFileDebug::instance().resetFlowComponent();
+    debug.file().resetFlowComponent();
     std::vector<Candidate> componentCandidates;
 #ifdef DEBUG
-    CCTagFileDebug::instance().resetFlowComponent();
+    debug.file().resetFlowComponent();
 #endif
 #endif
 
@@ -415,7 +500,7 @@ static void cctagDetectionFromEdgesLoopTwoIteration(
         {
           // Search for another segment
           flowComponentAssembling( edgeCollection, quality, candidate, vCandidateLoopTwo,
-                  outerEllipse, outerEllipsePoints, cctagPoints, params
+                  outerEllipse, outerEllipsePoints, cctagPoints, params, debug
 #ifndef CCTAG_SERIALIZE
                   );
 #else
@@ -427,12 +512,13 @@ static void cctagDetectionFromEdgesLoopTwoIteration(
       // Add the flowComponent from candidate to cctagPoints
       if (! addCandidateFlowtoCCTag(edgeCollection, candidate._filteredChildren,
               candidate._outerEllipsePoints, outerEllipse,
-              cctagPoints, params._nCrowns * 2))
+              cctagPoints, params._nCrowns * 2, debug))
       {
         DO_TALK( CCTAG_COUT_DEBUG("Points outside the outer ellipse OR CCTag not valid : bad gradient orientations"); )
-        CCTagFileDebug::instance().outputFlowComponentAssemblingInfos(PTSOUTSIDE_OR_BADGRADORIENT);
-        CCTagFileDebug::instance().incrementFlowComponentIndex(0);
-        return;
+        debug.file().outputFlowComponentAssemblingInfos(PTSOUTSIDE_OR_BADGRADORIENT);
+        debug.file().incrementFlowComponentIndex(0);
+        outcome = kLoopTwoBadFlowComponent;
+        return nullptr;
       }
       else
       {
@@ -457,7 +543,8 @@ static void cctagDetectionFromEdgesLoopTwoIteration(
                ( realSizeOuterEllipsePoints < 50.0  ) )
       {
               DO_TALK( CCTAG_COUT_DEBUG( "Not enough outer ellipse points: realSizeOuterEllipsePoints : " << realSizeOuterEllipsePoints << ", rasterizeEllipsePerimeter : " << rasterizeEllipsePerimeter( outerEllipse )*scale << ", quality : " << quality ); )
-              return;
+              outcome = kLoopTwoTooFewOuterPoints;
+              return nullptr;
       }
 
       cctag::Point2d<Eigen::Vector3f> markerCenter;
@@ -467,10 +554,11 @@ static void cctagDetectionFromEdgesLoopTwoIteration(
 
       if (ratioSemiAxes > 8.0 || ratioSemiAxes < 0.125)
       {
-        CCTagFileDebug::instance().outputFlowComponentAssemblingInfos(RATIO_SEMIAXIS);
-        CCTagFileDebug::instance().incrementFlowComponentIndex(0);
+        debug.file().outputFlowComponentAssemblingInfos(RATIO_SEMIAXIS);
+        debug.file().incrementFlowComponentIndex(0);
         DO_TALK( CCTAG_COUT_DEBUG("Too high ratio between semi-axes!"); )
-        return;
+        outcome = kLoopTwoSemiAxesRatio;
+        return nullptr;
       }
 
       // TODO@stian: remove allocation from loop iteration
@@ -511,11 +599,12 @@ static void cctagDetectionFromEdgesLoopTwoIteration(
       }
       if (!isValid)
       {
-        CCTagFileDebug::instance().outputFlowComponentAssemblingInfos(PTS_OUTSIDE_ELLHULL);
-        CCTagFileDebug::instance().incrementFlowComponentIndex(0);
+        debug.file().outputFlowComponentAssemblingInfos(PTS_OUTSIDE_ELLHULL);
+        debug.file().incrementFlowComponentIndex(0);
 
         DO_TALK( CCTAG_COUT_DEBUG("Distance max to high!"); )
-        return;
+        outcome = kLoopTwoOutsideHull;
+        return nullptr;
       }
 
       std::vector< Point2d<Eigen::Vector3i> > vPoint;
@@ -530,40 +619,40 @@ static void cctagDetectionFromEdgesLoopTwoIteration(
       
       quality2 *= scale;
 
-      CCTag* tag = new CCTag( -1,
+      std::unique_ptr<CCTag> tag(new CCTag( -1,
                               outerEllipse.center(),
                               cctagPoints,
                               outerEllipse,
                               markerHomography,
                               pyramidLevel,
                               scale,
-                              quality2 );
+                              quality2 ));
 #ifdef CCTAG_SERIALIZE
       tag->setFlowComponents( componentCandidates, edgeCollection);
 #endif
-      
-      {
-        tbb::mutex::scoped_lock lock(G_InsertMutex);
-        markers.push_back( tag ); // markers takes responsibility for delete
-      }
+
 #ifdef CCTAG_SERIALIZE
 #ifdef DEBUG
 
-      CCTagFileDebug::instance().outputFlowComponentAssemblingInfos(PASS_ALLTESTS);
-      CCTagFileDebug::instance().incrementFlowComponentIndex(0);
+      debug.file().outputFlowComponentAssemblingInfos(PASS_ALLTESTS);
+      debug.file().incrementFlowComponentIndex(0);
 #endif
 #endif
 
       DO_TALK( CCTAG_COUT_DEBUG("------------------------------Added marker------------------------------"); )
+      outcome = kLoopTwoMarker;
+      return tag;
     }
     catch (...)
     {
-      CCTagFileDebug::instance().outputFlowComponentAssemblingInfos(RAISED_EXCEPTION);
-      CCTagFileDebug::instance().incrementFlowComponentIndex(0);
+      debug.file().outputFlowComponentAssemblingInfos(RAISED_EXCEPTION);
+      debug.file().incrementFlowComponentIndex(0);
       // Ellipse fitting don't pass.
       //CCTAG_COUT_CURRENT_EXCEPTION;
       DO_TALK( CCTAG_COUT_DEBUG( "Exception raised" ); )
     }
+    outcome = kLoopTwoException;
+    return nullptr;
 }
 
 void cctagDetectionFromEdges(
@@ -575,24 +664,26 @@ void cctagDetectionFromEdges(
         int pyramidLevel,
         float scale,
         const Parameters & providedParams,
-        cctag::logtime::Mgmt* durations )
+        DebugSink& debug,
+        cctag::logtime::Mgmt* durations,
+        LevelStats* stats )
 {
   const Parameters& params = Parameters::OverrideLoaded ?
     Parameters::Override : providedParams;
 
   // Call for debug only. Write the vote result as an image.
-  createImageForVoteResultDebug(src, pyramidLevel);
+  createImageForVoteResultDebug(src, pyramidLevel, debug);
 
   // Set some timers
   boost::timer t3;
   boost::posix_time::ptime tstart0(boost::posix_time::microsec_clock::local_time());
 
-  std::size_t nSegmentOut = 0;
+  std::atomic<std::size_t> nSegmentOut(0);
 
 #ifdef CCTAG_SERIALIZE
   std::stringstream outFlowComponents;
   outFlowComponents << "flowComponentsLevel" << pyramidLevel << ".txt";
-  CCTagFileDebug::instance().newSession(outFlowComponents.str());
+  debug.file().newSession(outFlowComponents.str());
 #endif
 
   if( seeds.size() <= 0 )
@@ -605,14 +696,21 @@ void cctagDetectionFromEdges(
   
   const std::size_t nSeedsToProcess = std::min(seeds.size(), nMaximumNbSeeds);
 
-  std::vector<CandidatePtr> vCandidateLoopOne;
+  // One slot per seed: every iteration writes to its own slot, the slots are
+  // then compacted and ranked once the loop is over.
+  std::vector<CandidatePtr> vCandidateLoopOne(nSeedsToProcess);
+
+  // In deterministic mode, the seeds are linked speculatively and committed
+  // afterwards by seed rank.
+  std::vector<std::vector<EdgePoint*> > vProcessedIn(params._deterministic ? nSeedsToProcess : 0);
 
   // Process all the first-nSeedsToProcess seeds.
   // In the following loop, a seed will lead to a flow component if it lies
   // on the inner ellipse of a CCTag.
   // The edge points lying on the inner ellipse and their voters (lying on the outer ellipse)
   // will be collected and constitute the initial data of a flow component.
-  
+  {
+  CCTAG_TRACE_SPAN("loop one", pyramidLevel);
 #ifndef CCTAG_SERIALIZE
   tbb::parallel_for(size_t(0), nSeedsToProcess, [&](int iSeed) {
 #else 
@@ -620,27 +718,44 @@ void cctagDetectionFromEdges(
   {
 #endif
     assert( seeds[iSeed] );
-    constructFlowComponentFromSeed(seeds[iSeed], edgeCollection, vCandidateLoopOne, params);
+    vCandidateLoopOne[iSeed] = constructFlowComponentFromSeed(seeds[iSeed], edgeCollection,
+      params._deterministic ? &vProcessedIn[iSeed] : nullptr, params);
 #ifndef CCTAG_SERIALIZE
   });
 #else
   }
 #endif
 
+  if (params._deterministic)
+  {
+    commitFlowComponentsLoopOne(edgeCollection, vCandidateLoopOne, vProcessedIn);
+  }
+  rankCandidatesLoopOne(vCandidateLoopOne);
+  }
+
+  if (stats)
+  {
+    stats->candidatesLoopOne = vCandidateLoopOne.size();
+  }
+
   const std::size_t nFlowComponentToProcessLoopTwo = 
           std::min(vCandidateLoopOne.size(), params._maximumNbCandidatesLoopTwo);
 
-  std::vector<Candidate> vCandidateLoopTwo;
-  vCandidateLoopTwo.reserve(nFlowComponentToProcessLoopTwo);
+  std::vector<FlowComponentOutcome> vCandidateLoopTwoOutcome(nFlowComponentToProcessLoopTwo, kFlowComponentRejected);
+
+  // One slot per flow component for the trials of its robust estimation.
+  std::vector<std::size_t> vRobustIterations(stats ? nFlowComponentToProcessLoopTwo : 0, 0);
 
   // Second main loop:
   // From the flow components selected in the first loop, the outer ellipse will
   // be here entirely recovered.
   // The GPU implementation should stop at this point => layers ->  EdgePoint* creation.
 
-  CCTagVisualDebug::instance().initBackgroundImage(src);
-  CCTagVisualDebug::instance().newSession( "completeFlowComponent" );
-  
+  debug.visual().initBackgroundImage(src);
+  debug.visual().newSession( "completeFlowComponent" );
+
+  {
+  CCTAG_TRACE_SPAN("flow component completion", pyramidLevel);
 #ifndef CCTAG_SERIALIZE
   tbb::parallel_for(size_t(0), nFlowComponentToProcessLoopTwo, [&](size_t iCandidate) {
 #else
@@ -648,12 +763,34 @@ void cctagDetectionFromEdges(
     {
 #endif
       size_t runId = iCandidate;
-      completeFlowComponent(*vCandidateLoopOne[iCandidate], edgeCollection, vCandidateLoopTwo, nSegmentOut, runId, params);
+      vCandidateLoopTwoOutcome[iCandidate] = completeFlowComponent(*vCandidateLoopOne[iCandidate], edgeCollection,
+        params._deterministic ? nullptr : &nSegmentOut, runId, params,
+        stats ? &vRobustIterations[iCandidate] : nullptr, debug);
 #ifndef CCTAG_SERIALIZE  
     });
 #else
   }
 #endif
+
+  if (params._deterministic)
+  {
+    // Labels are given by rank, as in a serial run.
+    for(size_t iCandidate=0 ; iCandidate < nFlowComponentToProcessLoopTwo; ++iCandidate)
+    {
+      if (vCandidateLoopTwoOutcome[iCandidate] != kFlowComponentRejected)
+        labelFlowComponent(edgeCollection, *vCandidateLoopOne[iCandidate], nSegmentOut);
+    }
+  }
+  }
+
+  // Keep the loop-one ranking among the completed flow components.
+  std::vector<Candidate> vCandidateLoopTwo;
+  vCandidateLoopTwo.reserve(nFlowComponentToProcessLoopTwo);
+  for(size_t iCandidate=0 ; iCandidate < nFlowComponentToProcessLoopTwo; ++iCandidate)
+  {
+    if (vCandidateLoopTwoOutcome[iCandidate] == kFlowComponentKept)
+      vCandidateLoopTwo.push_back(*vCandidateLoopOne[iCandidate]);
+  }
   
   DO_TALK(
     CCTAG_COUT_VAR_DEBUG(vCandidateLoopTwo.size());
@@ -671,22 +808,42 @@ void cctagDetectionFromEdges(
 #if defined CCTAG_SERIALIZE && defined DEBUG
   std::stringstream outFlowComponentsAssembling;
   outFlowComponentsAssembling << "flowComponentsAssemblingLevel" << pyramidLevel << ".txt";
-  CCTagFileDebug::instance().newSession(outFlowComponentsAssembling.str());
-  CCTagFileDebug::instance().initFlowComponentsIndex(2);
+  debug.file().newSession(outFlowComponentsAssembling.str());
+  debug.file().initFlowComponentsIndex(2);
 #endif
 
   const size_t candidateLoopTwoCount = vCandidateLoopTwo.size();
+  std::vector<std::unique_ptr<CCTag>> vMarkers(candidateLoopTwoCount);
+  std::vector<LoopTwoOutcome> vMarkerOutcomes(candidateLoopTwoCount, kLoopTwoException);
 
+  {
+  CCTAG_TRACE_SPAN("loop two", pyramidLevel);
 #ifndef CCTAG_SERIALIZE
   tbb::parallel_for(size_t(0), candidateLoopTwoCount, [&](size_t iCandidate) {
 #else
   for(size_t iCandidate=0 ; iCandidate < vCandidateLoopTwo.size(); ++iCandidate)
 #endif
-    cctagDetectionFromEdgesLoopTwoIteration(markers, edgeCollection, vCandidateLoopTwo, iCandidate,
-      pyramidLevel, scale, params);
+    vMarkers[iCandidate] = cctagDetectionFromEdgesLoopTwoIteration(edgeCollection, vCandidateLoopTwo, iCandidate,
+      pyramidLevel, scale, params, vMarkerOutcomes[iCandidate], debug);
 #ifndef CCTAG_SERIALIZE
   });
 #endif
+  }
+
+  for(std::unique_ptr<CCTag>& tag : vMarkers)
+  {
+    if (tag)
+      markers.push_back( tag.release() ); // markers takes responsibility for delete
+  }
+
+  if (stats)
+  {
+    stats->candidatesLoopTwo = candidateLoopTwoCount;
+    for (std::size_t n : vRobustIterations)
+      stats->robustIterations += n;
+    for (LoopTwoOutcome outcome : vMarkerOutcomes)
+      ++stats->loopTwoOutcomes[outcome];
+  }
   
   boost::posix_time::ptime tstop2(boost::posix_time::microsec_clock::local_time());
   boost::posix_time::time_duration d2 = tstop2 - tstop1;
@@ -696,8 +853,11 @@ void cctagDetectionFromEdges(
 
 void createImageForVoteResultDebug(
         const cv::Mat & src,
-        std::size_t nLevel)
+        std::size_t nLevel,
+        DebugSink& debug)
 {
+  // Unused while the debug output below is disabled.
+  (void) debug;
 #if defined(CCTAG_SERIALIZE) && 0 // todo@lilian: fixme
   {
     std::size_t mx = 0;
@@ -722,9 +882,9 @@ void createImageForVoteResultDebug(
     }
     
     std::stringstream outFilenameVote;
-    outFilenameVote << "voteLevel" << CCTagVisualDebug::instance().getPyramidLevel();
-    CCTagVisualDebug::instance().initBackgroundImage(imgVote);
-    CCTagVisualDebug::instance().newSession(outFilenameVote.str());
+    outFilenameVote << "voteLevel" << debug.visual().getPyramidLevel();
+    debug.visual().initBackgroundImage(imgVote);
+    debug.visual().newSession(outFilenameVote.str());
   }
 #endif
 }
@@ -775,14 +935,41 @@ void cctagDetection(
         const Parameters & providedParams,
         const cctag::CCTagMarkersBank & bank,
         bool bDisplayEllipses,
-        cctag::logtime::Mgmt* durations )
+        cctag::logtime::Mgmt* durations,
+        DetectionStats* stats,
+        DebugSink* providedDebug )
+{
+    cctagDetection( markers, pipeId, frame, ImageView( imgGraySrc ),
+                    providedParams, bank, bDisplayEllipses, durations, stats, providedDebug );
+}
+
+void cctagDetection(
+        CCTag::List& markers,
+        int          pipeId,
+        std::size_t frame,
+        const ImageView & src,
+        const Parameters & providedParams,
+        const cctag::CCTagMarkersBank & bank,
+        bool bDisplayEllipses,
+        cctag::logtime::Mgmt* durations,
+        DetectionStats* stats,
+        DebugSink* providedDebug )
 
 {
     using namespace cctag;
+
+    // Without a sink from the caller, the debug output of the frame is dropped
+    // with this one.
+    DebugSink localDebug;
+    DebugSink& debug = providedDebug ? *providedDebug : localDebug;
     
     const Parameters& params = Parameters::OverrideLoaded ?
       Parameters::Override : providedParams;
 
+    CCTAG_TRACE_SPAN("frame", frame);
+
+    if( stats ) stats->reset( frame, params._numberOfProcessedMultiresLayers );
+
     if( durations ) durations->log( "start" );
   
     std::srand(1);
@@ -793,23 +980,32 @@ void cctagDetection(
     bool cuda_allocates = false;
 #endif
   
-    ImagePyramid imagePyramid( imgGraySrc.cols,
-                               imgGraySrc.rows,
+    ImagePyramid imagePyramid( src.width,
+                               src.height,
                                params._numberOfProcessedMultiresLayers,
                                cuda_allocates );
 
+    // Gray image of the frame, a header on the caller's luma plane when there
+    // is one, otherwise the result of the conversion.
+    cv::Mat imgGraySrc;
+    if( src.hasLumaPlane() ) imgGraySrc = src.lumaPlane();
+
     cctag::TagPipe* pipe1 = nullptr;
 #ifdef WITH_CUDA
     if( params._useCuda ) {
         pipe1 = initCuda( pipeId,
-                          imgGraySrc.size().width,
-	                      imgGraySrc.size().height,
+                          src.width,
+	                      src.height,
 	                      params,
 	                      durations );
 
         if( durations ) durations->log( "after initCuda" );
 
-        assert( imgGraySrc.elemSize() == 1 );
+        // The upload reads a continuous plane: strided views and the packed
+        // and color formats are converted on the host first.
+        if( imgGraySrc.empty() || !imgGraySrc.isContinuous() ) {
+            src.copyLumaTo( imgGraySrc );
+        }
         assert( imgGraySrc.isContinuous() );
         assert( imgGraySrc.type() == CV_8U );
         unsigned char* pix = imgGraySrc.data;
@@ -832,10 +1028,13 @@ void cctagDetection(
     } else { // not params.useCuda
 #endif // WITH_CUDA
 
-        imagePyramid.build( imgGraySrc,
+        imagePyramid.build( src,
                             params._cannyThrLow,
                             params._cannyThrHigh,
-                            &params );
+                            &params,
+                            debug );
+        // Converted in place of the copy into level 0.
+        if( imgGraySrc.empty() ) imgGraySrc = imagePyramid.getLevel(0)->getSrc();
 
 #ifdef WITH_CUDA
     } // not params.useCuda
@@ -849,7 +1048,9 @@ void cctagDetection(
                             frame,
                             pipe1,
                             params,
-                            durations );
+                            debug,
+                            durations,
+                            stats );
 
     if( durations ) durations->log( "after cctagMultiresDetection" );
 
@@ -869,12 +1070,14 @@ void cctagDetection(
     }
 #endif // WITH_CUDA
   
-    CCTagVisualDebug::instance().initBackgroundImage(imagePyramid.getLevel(0)->getSrc());
+    debug.visual().initBackgroundImage(imagePyramid.getLevel(0)->getSrc());
 
     // Identification step
     if (params._doIdentification)
     {
-      CCTagVisualDebug::instance().resetMarkerIndex();
+        CCTAG_TRACE_SPAN("identification");
+
+      debug.visual().resetMarkerIndex();
 
         const int numTags  = markers.size();
 
@@ -884,8 +1087,8 @@ void cctagDetection(
         }
 #endif // WITH_CUDA
 
-        std::vector<std::vector<cctag::ImageCut> > vSelectedCuts( numTags );
-        int                          detected[ numTags ];
+        std::vector<cctag::CutBatch> vSelectedCuts( numTags );
+        std::vector<int>             detected( numTags );
         int                          tagIndex = 0;
 
         for( const CCTag& cctag : markers ) {
@@ -894,7 +1097,8 @@ void cctagDetection(
                 cctag,
                 vSelectedCuts[tagIndex],
                 imagePyramid.getLevel(0)->getSrc(),
-                params );
+                params,
+                debug );
 
             tagIndex++;
         }
@@ -903,6 +1107,11 @@ void cctagDetection(
             cerr << __FILE__ << ":" << __LINE__ << " Number of markers has changed in identify_step_1" << endl;
         }
 
+        DO_TALK(
+          const int nRingProfileRejected = std::count( detected.begin(), detected.end(), status::no_ring_profile );
+          CCTAG_COUT( "Ring profile check rejected " << nRingProfileRejected << " of " << numTags << " candidates" );
+        )
+
 #ifdef WITH_CUDA
         if( pipe1 && numTags > 0 ) {
             pipe1->uploadCuts( numTags, &vSelectedCuts[0], params );
@@ -910,7 +1119,9 @@ void cctagDetection(
             tagIndex = 0;
             int debug_num_calls = 0;
             for( CCTag& cctag : markers ) {
-                if( vSelectedCuts[tagIndex].size() <= 2 ) {
+                if( detected[tagIndex] == status::no_ring_profile ) {
+                    // rejected before any cut was collected
+                } else if( vSelectedCuts[tagIndex].size() <= 2 ) {
                     detected[tagIndex] = status::no_selected_cuts;
                 } else if( detected[tagIndex] == status::id_reliable ) {
                     if( debug_num_calls >= numTags ) {
@@ -940,12 +1151,15 @@ void cctagDetection(
         }
 #endif // WITH_CUDA
 
-        tagIndex = 0;
+        std::vector<CCTag*> vMarkers;
+        vMarkers.reserve( numTags );
+        for( CCTag& cctag : markers ) {
+            vMarkers.push_back( &cctag );
+        }
 
-        CCTag::List::iterator it = markers.begin();
-        while (it != markers.end())
-        {
-            CCTag & cctag = *it;
+        const auto identifyTag = [&]( int tagIndex ) {
+            CCTAG_TRACE_SPAN("identify tag", tagIndex);
+            CCTag & cctag = *vMarkers[tagIndex];
 
             if( detected[tagIndex] == status::id_reliable ) {
                 detected[tagIndex] = cctag::identification::identify_step_2(
@@ -955,15 +1169,41 @@ void cctagDetection(
                     bank.getMarkers(),
                     imagePyramid.getLevel(0)->getSrc(),
                     pipe1,
-                    params );
+                    params,
+                    debug );
             }
 
             cctag.setStatus( detected[tagIndex] );
-            ++it;
-
-            tagIndex++;
+            if( params._resultOnly ) cctag.releaseIdentificationData();
+        };
+
+        // With enough tags to keep all the threads busy, the tags are identified
+        // in parallel. Otherwise (e.g. a few large tags), they are identified one
+        // after the other and the parallelism comes from the evaluation of the
+        // grid points in the imaged center optimization.
+        bool parallelTags = !pipe1 && numTags >= tbb::this_task_arena::max_concurrency();
+#ifdef CCTAG_SERIALIZE
+        parallelTags = false; // the visual debug sessions are not thread safe
+#endif
+        if( parallelTags ) {
+            tbb::parallel_for( 0, numTags, identifyTag );
+        } else {
+            for( int tagIndex = 0; tagIndex < numTags; ++tagIndex ) {
+                identifyTag( tagIndex );
+            }
         }
         if( durations ) durations->log( "after cctag::identification::identify" );
+
+        if( stats ) {
+            for( const CCTag& cctag : markers ) {
+                LevelStats& level = stats->levels[cctag.pyramidLevel()];
+                ++level.identificationOutcomes[DetectionStats::identificationOutcome( cctag.getStatus() )];
+                if( cctag.centerEvaluations() > 0 ) {
+                    ++level.centerOptimizations;
+                    level.centerEvaluations += cctag.centerEvaluations();
+                }
+            }
+        }
     }
 
 #ifdef WITH_CUDA
@@ -974,29 +1214,48 @@ void cctagDetection(
     }
 #endif
     
-    // Delete overlapping markers while keeping the best ones.
-    CCTag::List markersPrelim, markersFinal;
+    // Delete overlapping markers while keeping the best ones. Two passes, a
+    // replacement in the first one can make two kept markers equal.
+    std::vector<const CCTag*> vMarkersAll, vMarkersPrelim, vMarkersFinal;
+    vMarkersAll.reserve(markers.size());
     for(const CCTag & marker : markers)
     {
-        update(markersPrelim, marker);
+        vMarkersAll.push_back(&marker);
     }
+    mergeEqualMarkers(vMarkersAll, vMarkersPrelim);
+    mergeEqualMarkers(vMarkersPrelim, vMarkersFinal);
 
-    for(const CCTag & marker : markersPrelim)
+    // The kept markers are moved to the final list. A marker kept twice (it
+    // replaced several markers) is copied.
+    std::unordered_map<const CCTag*, CCTag::List::iterator> markerPositions;
+    for(CCTag::List::iterator it = markers.begin(); it != markers.end(); ++it)
     {
-      update(markersFinal, marker);
+        markerPositions.emplace(&*it, it);
+    }
+
+    CCTag::List markersFinal;
+    for(const CCTag* marker : vMarkersFinal)
+    {
+        const auto position = markerPositions.find(marker);
+        if( position != markerPositions.end() ) {
+            markersFinal.push_back(markers.release(position->second).release());
+            markerPositions.erase(position);
+        } else {
+            markersFinal.push_back(new CCTag(*marker));
+        }
     }
 
-    markers = markersFinal;
+    markers.swap(markersFinal);
   
     markers.sort();
 
-    CCTagVisualDebug::instance().initBackgroundImage(imagePyramid.getLevel(0)->getSrc());
-    CCTagVisualDebug::instance().writeIdentificationView(markers);
-    CCTagFileDebug::instance().newSession("identification.txt");
+    debug.visual().initBackgroundImage(imagePyramid.getLevel(0)->getSrc());
+    debug.visual().writeIdentificationView(markers);
+    debug.file().newSession("identification.txt");
 
     for(const CCTag & marker : markers)
     {
-        CCTagFileDebug::instance().outputMarkerInfos(marker);
+        debug.file().outputMarkerInfos(marker);
     }
 }
 
@@ -10,6 +10,8 @@
 
 #include <cctag/CCTag.hpp>
 #include <cctag/CCTagMarkersBank.hpp>
+#include <cctag/DetectionStats.hpp>
+#include <cctag/ImageView.hpp>
 #include <cctag/Types.hpp>
 #include <cctag/Params.hpp>
 #include <cctag/utils/LogTime.hpp>
@@ -22,6 +24,7 @@
 
 namespace cctag {
 
+class DebugSink;
 class EdgePoint;
 class EdgePointImage;
 
@@ -35,6 +38,10 @@ class EdgePointImage;
  * @param[in] providedParams Contains all the parameters.
  * @param[in] bank CCTag bank.
  * @param[in] bDisplayEllipses No longer used.
+ * @param[in] durations If not null, timings of the stages.
+ * @param[out] stats If not null, counters of the detection of the frame.
+ * @param[in,out] debug If not null, receives the debug output of the frame
+ * (CCTAG_SERIALIZE builds); concurrent detections must use distinct sinks.
  */
 void cctagDetection(
         CCTag::List& markers,
@@ -44,7 +51,30 @@ void cctagDetection(
         const Parameters & providedParams,
         const cctag::CCTagMarkersBank & bank,
         bool bDisplayEllipses = true,
-        logtime::Mgmt* durations = nullptr );
+        logtime::Mgmt* durations = nullptr,
+        DetectionStats* stats = nullptr,
+        DebugSink* debug = nullptr );
+
+/**
+ * @brief Perform the CCTag detection on an image held by the caller, e.g. the
+ * buffer of a camera SDK, without copying it into a cv::Mat first.
+ *
+ * The luma of the planar and semi-planar YUV formats and of gray images is read
+ * in place, strides included; the other formats are converted to gray while
+ * filling the finest pyramid level. The parameters are the ones of the cv::Mat
+ * overload.
+ */
+void cctagDetection(
+        CCTag::List& markers,
+        int          pipeId,
+        std::size_t frame,
+        const ImageView & src,
+        const Parameters & providedParams,
+        const cctag::CCTagMarkersBank & bank,
+        bool bDisplayEllipses = true,
+        logtime::Mgmt* durations = nullptr,
+        DetectionStats* stats = nullptr,
+        DebugSink* debug = nullptr );
 
 void cctagDetectionFromEdges(
         CCTag::List&            markers,
@@ -55,11 +85,14 @@ void cctagDetectionFromEdges(
         int pyramidLevel,
         float scale,
         const Parameters & providedParams,
-        logtime::Mgmt* durations );
+        DebugSink& debug,
+        logtime::Mgmt* durations,
+        LevelStats* stats = nullptr );
 
 void createImageForVoteResultDebug(
         const cv::Mat & src,
-        std::size_t nLevel);
+        std::size_t nLevel,
+        DebugSink& debug);
 
 } // namespace cctag
 
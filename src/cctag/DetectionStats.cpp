@@ -0,0 +1,106 @@
+/*
+ * Copyright 2016, Simula Research Laboratory
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+#include <cctag/DetectionStats.hpp>
+#include <cctag/CCTag.hpp>
+
+#include <algorithm>
+#include <ostream>
+
+namespace cctag {
+
+namespace {
+
+const char* const kLoopTwoOutcomeNames[kLoopTwoOutcomeCount] = {
+  "markers",
+  "reject_bad_flow_component",
+  "reject_too_few_outer_points",
+  "reject_semi_axes_ratio",
+  "reject_outside_hull",
+  "reject_exception"
+};
+
+// In the order of DetectionStats::identificationOutcome.
+const char* const kIdentificationOutcomeNames[LevelStats::kIdentificationOutcomeCount] = {
+  "id_reliable",
+  "id_no_collected_cuts",
+  "id_no_selected_cuts",
+  "id_opti_has_diverged",
+  "id_not_reliable",
+  "id_degenerate",
+  "id_no_ring_profile",
+  "id_other"
+};
+
+} // namespace
+
+void DetectionStats::reset(std::size_t frameId, std::size_t nLevels)
+{
+  frame = frameId;
+  levels.assign(nLevels, LevelStats());
+}
+
+std::size_t DetectionStats::identificationOutcome(int status)
+{
+  if (status == status::id_reliable)
+    return 0;
+  // status::no_collected_cuts (-1) ... status::no_ring_profile (-6)
+  if (status < 0 && status >= status::no_ring_profile)
+    return std::size_t(-status);
+  return LevelStats::kIdentificationOutcomeCount - 1;
+}
+
+std::size_t DetectionStats::edgePointsHighWater() const
+{
+  std::size_t highWater = 0;
+  for (const LevelStats& level : levels)
+    highWater = std::max(highWater, level.edgePoints);
+  return highWater;
+}
+
+std::size_t DetectionStats::votersHighWater() const
+{
+  std::size_t highWater = 0;
+  for (const LevelStats& level : levels)
+    highWater = std::max(highWater, level.voters);
+  return highWater;
+}
+
+void DetectionStats::writeCsvHeader(std::ostream& ostr)
+{
+  ostr << "frame,level,edge_points,voters,seeds,candidates_loop_one,candidates_loop_two,"
+          "robust_iterations,center_optimizations,center_evaluations";
+  for (const char* name : kLoopTwoOutcomeNames)
+    ostr << ',' << name;
+  for (const char* name : kIdentificationOutcomeNames)
+    ostr << ',' << name;
+  ostr << '\n';
+}
+
+void DetectionStats::writeCsv(std::ostream& ostr) const
+{
+  for (std::size_t i = 0; i < levels.size(); ++i)
+  {
+    const LevelStats& level = levels[i];
+    ostr << frame << ',' << i << ','
+         << level.edgePoints << ','
+         << level.voters << ','
+         << level.seeds << ','
+         << level.candidatesLoopOne << ','
+         << level.candidatesLoopTwo << ','
+         << level.robustIterations << ','
+         << level.centerOptimizations << ','
+         << level.centerEvaluations;
+    for (std::size_t n : level.loopTwoOutcomes)
+      ostr << ',' << n;
+    for (std::size_t n : level.identificationOutcomes)
+      ostr << ',' << n;
+    ostr << '\n';
+  }
+}
+
+} // namespace cctag
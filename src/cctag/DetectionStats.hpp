@@ -0,0 +1,81 @@
+/*
+ * Copyright 2016, Simula Research Laboratory
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+#ifndef _CCTAG_DETECTIONSTATS_HPP_
+#define _CCTAG_DETECTIONSTATS_HPP_
+
+#include <array>
+#include <cstddef>
+#include <iosfwd>
+#include <vector>
+
+namespace cctag {
+
+/**
+ * @brief Outcome of the processing of a loop two candidate: a marker, or the
+ * check of cctagDetectionFromEdgesLoopTwoIteration that rejected it.
+ */
+enum LoopTwoOutcome
+{
+  kLoopTwoMarker = 0,         // markers of the level
+  kLoopTwoBadFlowComponent,   // points outside the outer ellipse or bad gradient orientations
+  kLoopTwoTooFewOuterPoints,  // outer ellipse too sparsely covered for its size
+  kLoopTwoSemiAxesRatio,      // too elongated outer ellipse
+  kLoopTwoOutsideHull,        // outer ellipse points outside its elliptic hull
+  kLoopTwoException,          // fitting failure
+  kLoopTwoOutcomeCount
+};
+
+/**
+ * @brief Counters of one pyramid level.
+ */
+struct LevelStats
+{
+  // Outcomes of the identification, indexed by identificationOutcome().
+  static constexpr std::size_t kIdentificationOutcomeCount = 8;
+
+  std::size_t edgePoints = 0;         // edge points, to compare with EdgePointCollection::MAX_POINTS
+  std::size_t voters = 0;             // voter list entries, to compare with EdgePointCollection::MAX_VOTERLIST_SIZE
+  std::size_t seeds = 0;
+  std::size_t candidatesLoopOne = 0;  // flow components built from the seeds
+  std::size_t candidatesLoopTwo = 0;  // flow components completed into an outer ellipse
+  std::size_t robustIterations = 0;   // trials of the LMedS outer ellipse estimations
+  std::size_t centerOptimizations = 0; // markers whose imaged center was optimized on the CPU
+  std::size_t centerEvaluations = 0;  // cost evaluations of these optimizations, grid or pattern search
+  std::array<std::size_t, kLoopTwoOutcomeCount> loopTwoOutcomes{};
+  std::array<std::size_t, kIdentificationOutcomeCount> identificationOutcomes{};
+};
+
+/**
+ * @brief Counters of the detection of one frame, filled by cctagDetection when
+ * it is given a DetectionStats. Counting is done per level or per candidate
+ * outside of the hot loops, so that it costs nothing noticeable.
+ */
+struct DetectionStats
+{
+  std::size_t frame = 0;
+  std::vector<LevelStats> levels;
+
+  void reset(std::size_t frameId, std::size_t nLevels);
+
+  // Index in LevelStats::identificationOutcomes of a marker status.
+  static std::size_t identificationOutcome(int status);
+
+  // Largest level counts of the frame, for the buffers shared by the levels.
+  std::size_t edgePointsHighWater() const;
+  std::size_t votersHighWater() const;
+
+  /**
+   * @brief CSV output, one line per level.
+   */
+  static void writeCsvHeader(std::ostream& ostr);
+  void writeCsv(std::ostream& ostr) const;
+};
+
+} // namespace cctag
+
+#endif
@@ -0,0 +1,94 @@
+/*
+ * Copyright 2016, Simula Research Laboratory
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+#ifndef _CCTAG_EDGEMAPLAYOUT_HPP_
+#define _CCTAG_EDGEMAPLAYOUT_HPP_
+
+#include <cstddef>
+#include <cstdint>
+
+namespace cctag {
+
+/**
+ * @brief Memory layouts of the edge map: a layout maps a pixel (x,y) of a w x h
+ * image to a cell in [0, size()). The occupancy bitmap of the edge map uses
+ * the same cell order, 64 cells per word.
+ */
+
+// Row-major layout with the stride of the image width.
+class RowMajorEdgeMapLayout
+{
+public:
+  RowMajorEdgeMapLayout() = default;
+
+  RowMajorEdgeMapLayout(std::size_t w, std::size_t h)
+    : _width(w)
+    , _height(h)
+  {}
+
+  std::size_t index(int x, int y) const { return x + y * _width; }
+
+  std::size_t size() const { return _width * _height; }
+
+private:
+  std::size_t _width = 0;
+  std::size_t _height = 0;
+};
+
+/**
+ * @brief Layout by tiles of 8x8 pixels, the tiles being stored row by row and
+ * the pixels of a tile row by row. A field line walking a few pixels in any
+ * direction stays within a few cache lines, and the occupancy of a whole tile
+ * is one word of the bitmap.
+ */
+class TiledEdgeMapLayout
+{
+public:
+  static constexpr int kTileShift = 3;
+  static constexpr int kTileSize = 1 << kTileShift;
+  static constexpr int kTileMask = kTileSize - 1;
+
+  TiledEdgeMapLayout() = default;
+
+  TiledEdgeMapLayout(std::size_t w, std::size_t h)
+    : _tilesPerRow((w + kTileMask) >> kTileShift)
+    , _tilesPerColumn((h + kTileMask) >> kTileShift)
+  {}
+
+  std::size_t index(int x, int y) const
+  {
+    const std::size_t tile = (y >> kTileShift) * _tilesPerRow + (x >> kTileShift);
+    return (tile << (2*kTileShift)) + ((y & kTileMask) << kTileShift) + (x & kTileMask);
+  }
+
+  // Includes the padding of the tiles on the right and bottom borders.
+  std::size_t size() const { return (_tilesPerRow * _tilesPerColumn) << (2*kTileShift); }
+
+private:
+  std::size_t _tilesPerRow = 0;
+  std::size_t _tilesPerColumn = 0;
+};
+
+#ifdef CCTAG_TILED_EDGE_MAP
+using EdgeMapLayout = TiledEdgeMapLayout;
+#else
+using EdgeMapLayout = RowMajorEdgeMapLayout;
+#endif
+
+inline bool testOccupancy(const std::uint64_t* occupancy, std::size_t cell)
+{
+  return (occupancy[cell >> 6] >> (cell & 63)) & 1u;
+}
+
+inline void setOccupancy(std::uint64_t* occupancy, std::size_t cell)
+{
+  occupancy[cell >> 6] |= std::uint64_t(1) << (cell & 63);
+}
+
+} // namespace cctag
+
+#endif
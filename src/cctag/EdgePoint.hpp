@@ -26,26 +26,10 @@ class EdgePoint : public Vector3s
 public:
   EdgePoint() = default;
 
-  // XXX: should delete copy ctor; a lot of state is in EdgePointCollection
-  // That class checks incoming pointers though.
-  EdgePoint( const EdgePoint& p )
-    : Vector3s(p)
-    , _grad( p._grad )
-    , _normGrad ( p._normGrad )
-    , _flowLength (0)
-    , _processed( 0 )
-    , _isMax( -1 )
-    , _nSegmentOut(-1)
-  {}
-
   EdgePoint( const int vx, const int vy, const float vdx, const float vdy )
     : Vector3s( vx, vy, 1 )
     , _grad(vdx, vdy)
     , _normGrad(std::sqrt( vdx * vdx + vdy * vdy ))
-    , _flowLength (0)
-    , _processed( 0 )
-    , _isMax( -1 )
-    , _nSegmentOut(-1)
   {
   }
 
@@ -74,21 +58,13 @@ public:
 private:
   Eigen::Vector2f _grad;
   float _normGrad;
-public:
-  float _flowLength;
-  uint64_t _processed;   // bitfield; must be 64-bit
-  int _isMax;
-  int _nSegmentOut;     // std::size_t _nSegmentOut;
+  // The mutable state of the point (flow length, processed runs, votes,
+  // segment label) is stored by EdgePointCollection, indexed by point.
 };
 
-// Calculation: sizeof(Vector3s)==8 (3*2=6 + 2 bytes of padding to 8 bytes)
-// 4*sizeof(float) == 16; plus uint64_t + 2 ints
-static_assert(sizeof(EdgePoint) == 8+16+16, "EdgePoint not packed");
-
-inline bool receivedMoreVoteThan(const EdgePoint * const p1,  const EdgePoint * const p2)
-{
-  return (p1->_isMax > p2->_isMax);
-}
+// Calculation: sizeof(Vector3s)==6, padded to 8 bytes by the alignment of
+// the floats; 3*sizeof(float) == 12
+static_assert(sizeof(EdgePoint) == 8+12, "EdgePoint not packed");
 
 } // namespace cctag
 
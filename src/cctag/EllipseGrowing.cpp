@@ -9,8 +9,7 @@
 #include <cctag/CCTag.hpp>
 #include <cctag/EdgePoint.hpp>
 #include <cctag/Fitting.hpp>
-#include <cctag/utils/VisualDebug.hpp>
-#include <cctag/utils/FileDebug.hpp>
+#include <cctag/utils/DebugSink.hpp>
 #include <cctag/Fitting.hpp>
 #include <cctag/geometry/Circle.hpp>
 #include <cctag/geometry/Point.hpp>
@@ -23,6 +22,7 @@
 #include <opencv2/core/types_c.h>
 
 #include <boost/math/special_functions/pow.hpp>
+#include <boost/container/flat_set.hpp>
 #include <boost/foreach.hpp>
 #include <boost/math/constants/constants.hpp>
 #include <boost/mpl/bool.hpp>
@@ -42,7 +42,8 @@ namespace cctag
 
 bool initMarkerCenter(cctag::Point2d<Eigen::Vector3f> & markerCenter,
         const std::vector< std::vector< Point2d<Eigen::Vector3f> > > & markerPoints,
-        int realPixelPerimeter)
+        int realPixelPerimeter,
+        DebugSink& debug)
 {
   cctag::numerical::geometry::Ellipse innerEllipse;
 
@@ -56,7 +57,7 @@ bool initMarkerCenter(cctag::Point2d<Eigen::Vector3f> & markerCenter,
 
         for(const Point2d<Eigen::Vector3f>& pt : markerPoints[0])
         {
-          CCTagVisualDebug::instance().drawPoint(pt, cctag::color_red);
+          debug.visual().drawPoint(pt, cctag::color_red);
         }
       }
       else
@@ -79,13 +80,18 @@ bool initMarkerCenter(cctag::Point2d<Eigen::Vector3f> & markerCenter,
   return true;
 }
 
-bool addCandidateFlowtoCCTag(EdgePointCollection& edgeCollection,
+/* Body of addCandidateFlowtoCCTag for a compile time number of circles
+ * (0: nCircles). */
+template<std::size_t NCircles>
+static bool addCandidateFlowtoCCTagImpl(EdgePointCollection& edgeCollection,
         const std::vector< EdgePoint* > & filteredChildren,
         const std::vector< EdgePoint* > & outerEllipsePoints,
         const cctag::numerical::geometry::Ellipse& outerEllipse,
         std::vector< std::vector< DirectedPoint2d<Eigen::Vector3f> > >& cctagPoints,
-        std::size_t numCircles)
+        std::size_t nCircles,
+        DebugSink& debug)
 {
+  const std::size_t numCircles = NCircles ? NCircles : nCircles;
   //cctag::numerical::geometry::Ellipse innerBoundEllipse(outerEllipse.center(), outerEllipse.a()/8.0, outerEllipse.b()/8.0, outerEllipse.angle());
   cctagPoints.resize(numCircles);
 
@@ -102,7 +108,11 @@ bool addCandidateFlowtoCCTag(EdgePointCollection& edgeCollection,
     itp->reserve(filteredChildren.size());
   }
 
-  std::list<EdgePoint*> vProcessedEdgePoint;
+  // Points already collected for this candidate. The set is local rather than
+  // held in the auxiliary flags of the collection so that candidates processed
+  // concurrently do not hide points from each other.
+  boost::container::flat_set<const EdgePoint*> processedEdgePoints;
+  processedEdgePoints.reserve(filteredChildren.size() * numCircles);
 
   DO_TALK( CCTAG_COUT_VAR_DEBUG(outerEllipse); )
 
@@ -137,12 +147,10 @@ bool addCandidateFlowtoCCTag(EdgePointCollection& edgeCollection,
       }
 
 
-      if (!edgeCollection.test_processed_aux(p))
+      if (processedEdgePoints.insert(p).second)
       {
         //CCTAG_COUT(*p);
 
-        edgeCollection.set_processed_aux(p, true);
-        vProcessedEdgePoint.push_back(p);
 
         float normGrad = sqrt(p->dX() * p->dX() + p->dY() * p->dY());
 
@@ -174,12 +182,8 @@ bool addCandidateFlowtoCCTag(EdgePointCollection& edgeCollection,
         }
         else
         {
-          CCTagFileDebug::instance().outputFlowComponentAssemblingInfos(PTS_OUT_WHILE_ASSEMBLING);
+          debug.file().outputFlowComponentAssemblingInfos(PTS_OUT_WHILE_ASSEMBLING);
           cctagPoints.clear();
-
-          for (EdgePoint* point : vProcessedEdgePoint)
-            edgeCollection.set_processed_aux(point, false);
-
           return false;
         }
       }
@@ -187,15 +191,12 @@ bool addCandidateFlowtoCCTag(EdgePointCollection& edgeCollection,
     }
   }
 
-  for (EdgePoint* point : vProcessedEdgePoint)
-    edgeCollection.set_processed_aux(point, false);
-
   //std::cin.ignore().get();
 
   if (float(nGradientOut) / float(nAddedPoint) > 0.5f)
   {
     cctagPoints.clear();
-    CCTagFileDebug::instance().outputFlowComponentAssemblingInfos(BAD_GRAD_WHILE_ASSEMBLING);
+    debug.file().outputFlowComponentAssemblingInfos(BAD_GRAD_WHILE_ASSEMBLING);
     return false;
   }
   else
@@ -204,6 +205,25 @@ bool addCandidateFlowtoCCTag(EdgePointCollection& edgeCollection,
   }
 }
 
+bool addCandidateFlowtoCCTag(EdgePointCollection& edgeCollection,
+        const std::vector< EdgePoint* > & filteredChildren,
+        const std::vector< EdgePoint* > & outerEllipsePoints,
+        const cctag::numerical::geometry::Ellipse& outerEllipse,
+        std::vector< std::vector< DirectedPoint2d<Eigen::Vector3f> > >& cctagPoints,
+        std::size_t numCircles,
+        DebugSink& debug)
+{
+  switch (numCircles)
+  {
+    case 6: // 3 crowns
+      return addCandidateFlowtoCCTagImpl<6>(edgeCollection, filteredChildren, outerEllipsePoints, outerEllipse, cctagPoints, numCircles, debug);
+    case 8: // 4 crowns
+      return addCandidateFlowtoCCTagImpl<8>(edgeCollection, filteredChildren, outerEllipsePoints, outerEllipse, cctagPoints, numCircles, debug);
+    default:
+      return addCandidateFlowtoCCTagImpl<0>(edgeCollection, filteredChildren, outerEllipsePoints, outerEllipse, cctagPoints, numCircles, debug);
+  }
+}
+
 /**
  * @brief Check if points are good for ellipse growing.
  *
@@ -332,7 +352,7 @@ void connectedPoint(std::vector<EdgePoint*>& pts, int runId,
 {
   BOOST_ASSERT(img(x,y));
   const size_t threadMask = (size_t)1 << runId;
-  img(x,y)->_processed |= threadMask;  // Set as processed
+  img.processed(img.index(x,y)) |= threadMask;  // Set as processed
 
   static int xoff[] = {1, 1, 0, -1, -1, -1, 0, 1};
   static int yoff[] = {0, -1, -1, -1, 0, 1, 1, 1};
@@ -344,24 +364,23 @@ void connectedPoint(std::vector<EdgePoint*>& pts, int runId,
     if (sx >= 0 && sx < int( img.shape()[0]) &&
         sy >= 0 && sy < int( img.shape()[1]))
     {
-      EdgePoint* e = img(sx,sy);
+      // Only the coordinates and the gradient are read to test the neighbour.
+      const int ie = img.index(sx,sy);
 
-      if (e && // If unprocessed
-          isInHull(qIn, qOut, e) &&
-          !(e->_processed & threadMask))
+      if (ie >= 0 && // If unprocessed
+          isInHull(qIn, qOut, Point2d<Eigen::Vector3f>(img.x(ie), img.y(ie))) &&
+          !(img.processed(ie) & threadMask))
       {
-        Eigen::Vector2f gradE;
-        gradE(0) = e->dX();
-        gradE(1) = e->dY();
+        Eigen::Vector2f gradE = img.gradient(ie);
         
         Eigen::Vector2f eO;
-        eO(0) = qIn.center().x() - e->x();
-        eO(1) = qIn.center().y() - e->y();
+        eO(0) = qIn.center().x() - img.x(ie);
+        eO(1) = qIn.center().y() - img.y(ie);
 
         if (gradE.dot(eO) < 0)
         {
-          pts.push_back(e);
-          e->_processed |= threadMask;
+          pts.push_back(img(ie));
+          img.processed(ie) |= threadMask;
           connectedPoint(pts, runId, img, qIn, qOut, sx, sy);
         }
       }
@@ -418,7 +437,7 @@ void ellipseGrowing2(
   for(EdgePoint * children : filteredChildren)
   {
     outerEllipsePoints.push_back(children);
-    children->_processed |= threadMask;
+    img.processed(children) |= threadMask;
   }
 
   int lastSizePoints = 0;
@@ -483,12 +502,12 @@ void ellipseGrowing2(
     for(auto & vedgePoint: edgePointsSets)
     {
       for(auto & point: vedgePoint)
-        point->_processed &= ~threadMask; // Could be any value different of runId
+        img.processed(point) &= ~threadMask; // Could be any value different of runId
     }
     // Set as processed all the outerEllipsePoints
     for(auto & point: outerEllipsePoints)
     {
-      point->_processed |= threadMask;
+      img.processed(point) |= threadMask;
     }
     
   }
@@ -20,6 +20,7 @@ namespace cctag
 {
 
 class CCTag;
+class DebugSink;
 
 inline bool isInEllipse(
         const cctag::numerical::geometry::Ellipse& ellipse,
@@ -51,7 +52,8 @@ inline bool isOverlappingEllipses(
 bool initMarkerCenter(
         cctag::Point2d<Eigen::Vector3f> & markerCenter,
         const std::vector< std::vector< Point2d<Eigen::Vector3f> > > & markerPoints,
-        int realPixelPerimeter);
+        int realPixelPerimeter,
+        DebugSink& debug);
 
 bool addCandidateFlowtoCCTag(
         EdgePointCollection& edgeCollection,
@@ -59,7 +61,8 @@ bool addCandidateFlowtoCCTag(
         const std::vector< EdgePoint* > & outerEllipsePoints,
         const cctag::numerical::geometry::Ellipse& outerEllipse,
         std::vector< std::vector< DirectedPoint2d<Eigen::Vector3f> > >& cctagPoints,
-        std::size_t numCircles);
+        std::size_t numCircles,
+        DebugSink& debug);
 
 bool ellipseGrowingInit(
         const std::vector<EdgePoint*>& filteredChildren,
@@ -8,13 +8,12 @@
 #include <cctag/ICCTag.hpp>
 #include <cctag/CCTag.hpp>
 #include <cctag/Detection.hpp>
+#include <cctag/ResourceCache.hpp>
 #include <cctag/utils/LogTime.hpp>
 
 #include <boost/foreach.hpp>
-#include <boost/filesystem.hpp>
-#include <boost/archive/xml_iarchive.hpp>
 
-#include <fstream>
+#include <memory>
 
 using namespace std;
 
@@ -31,6 +30,8 @@ namespace cctag {
  * @param[in] parameterFile Path to a parameter file. If not provided default parameters will be used.
  * @param[in] cctagBankFilename Path to the cctag bank. If not provided, radii will be the ones associated to the CCTags contained in the
  * markersToPrint folder.
+ * Both files are read once and cached by path and modification time (cf. ResourceCache.hpp).
+ * A bank file that cannot be opened throws exception::Value.
  */
 void cctagDetection(
       boost::ptr_list<ICCTag> & markers,
@@ -43,29 +44,34 @@ void cctagDetection(
       const std::string & cctagBankFilename)
 {
   // Load parameters
-  cctag::Parameters params = cctag::Parameters(nRings);
+  std::shared_ptr<const cctag::Parameters> params;
     
   if ( !parameterFilename.empty() )
   {
-    if (!boost::filesystem::exists( parameterFilename )) {
+    params = cachedParameters( parameterFilename, nRings );
+    if ( !params ) {
       std::cerr << std::endl
         << "The input parameter file \""<< parameterFilename << "\" is missing" << std::endl;
       return;
-    }else{
-      std::ifstream ifs( parameterFilename.c_str() );
-      boost::archive::xml_iarchive ia(ifs);
-      ia >> boost::serialization::make_nvp("CCTagsParams", params);
-      assert(  nRings == params._nCrowns  );
     }
+    assert(  nRings == params->_nCrowns  );
+  }
+  else
+  {
+    params = std::make_shared<cctag::Parameters>( nRings );
   }
   
-  CCTagMarkersBank bank(params._nCrowns);
+  std::shared_ptr<const CCTagMarkersBank> bank;
   if ( !cctagBankFilename.empty())
   {
-    bank = CCTagMarkersBank(cctagBankFilename);
+    bank = cachedBank( cctagBankFilename );
+  }
+  else
+  {
+    bank = defaultBank( params->_nCrowns );
   }
   
-  cctagDetection(markers, pipeId, frame, graySrc, params, durations, &bank);
+  cctagDetection(markers, pipeId, frame, graySrc, *params, durations, bank.get());
 }
 
 void cctagDetection(
@@ -81,17 +87,78 @@ void cctagDetection(
   
   if ( pBank == nullptr)
   {
-    CCTagMarkersBank bank(params._nCrowns);
-    cctag::cctagDetection(cctags, pipeId, frame, graySrc, params, bank, false, durations);
+    cctag::cctagDetection(cctags, pipeId, frame, graySrc, params, *defaultBank(params._nCrowns), false, durations);
   }else
   {
     cctag::cctagDetection(cctags, pipeId, frame, graySrc, params, *pBank, false, durations);
   }
   
+  // Hand the markers over without copying them.
   markers.clear();
+  while( !cctags.empty() )
+  {
+    markers.push_back(cctags.pop_front().release());
+  }
+}
+
+void cctagDetection(
+      std::vector<CCTagResult> & results,
+      int                       pipeId,
+      std::size_t frame,
+      const cv::Mat & graySrc,
+      const cctag::Parameters & params,
+      logtime::Mgmt* durations,
+      const CCTagMarkersBank * pBank)
+{
+  cctagDetection(results, pipeId, frame, ImageView(graySrc), params, durations, pBank);
+}
+
+void cctagDetection(
+      std::vector<CCTagResult> & results,
+      int                       pipeId,
+      std::size_t frame,
+      const ImageView & src,
+      const cctag::Parameters & params,
+      logtime::Mgmt* durations,
+      const CCTagMarkersBank * pBank)
+{
+  // The markers only live until their results are copied: do not keep their
+  // points and id candidates past their last use.
+  cctag::Parameters resultOnlyParams;
+  const cctag::Parameters * detectionParams = &params;
+  if ( !params._resultOnly )
+  {
+    resultOnlyParams = params;
+    resultOnlyParams._resultOnly = true;
+    detectionParams = &resultOnlyParams;
+  }
+
+  boost::ptr_list<cctag::CCTag> cctags;
+  
+  if ( pBank == nullptr)
+  {
+    cctag::cctagDetection(cctags, pipeId, frame, src, *detectionParams, *defaultBank(params._nCrowns), false, durations);
+  }else
+  {
+    cctag::cctagDetection(cctags, pipeId, frame, src, *detectionParams, *pBank, false, durations);
+  }
+  
+  results.clear();
   for(const cctag::CCTag & cctag : cctags)
   {
-    markers.push_back(new cctag::CCTag(cctag));
+    const cctag::numerical::geometry::Ellipse & ellipse = cctag.rescaledOuterEllipse();
+    CCTagResult result;
+    result.id = cctag.id();
+    result.status = cctag.getStatus();
+    result.x = cctag.x();
+    result.y = cctag.y();
+    result.quality = cctag.quality();
+    result.ellipseCenterX = ellipse.center().x();
+    result.ellipseCenterY = ellipse.center().y();
+    result.ellipseA = ellipse.a();
+    result.ellipseB = ellipse.b();
+    result.ellipseAngle = ellipse.angle();
+    results.push_back(result);
   }
 }
 
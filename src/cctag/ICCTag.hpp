@@ -10,11 +10,14 @@
 
 #include <cctag/Params.hpp>
 #include <cctag/CCTagMarkersBank.hpp>
+#include <cctag/ImageView.hpp>
 
 #include <boost/ptr_container/ptr_list.hpp>
 
 #include <opencv2/core/core.hpp>
 
+#include <vector>
+
 namespace cctag {
 
 namespace logtime {
@@ -57,6 +60,25 @@ inline ICCTag* new_clone(const ICCTag& a)
     return a.clone();
 }
 
+/**
+ * @brief Compact result of the detection of one marker, for the consumers that
+ * only need its identity and its location (no edge points nor ellipses).
+ */
+struct CCTagResult
+{
+    MarkerID id;
+    int status;   // WARNING: only markers with status == 1 are the valid ones.
+    float x;      // imaged center
+    float y;
+    float quality;
+    // Outer ellipse in the original image
+    float ellipseCenterX;
+    float ellipseCenterY;
+    float ellipseA;
+    float ellipseB;
+    float ellipseAngle;
+};
+
 /**
  * @brief Perform the CCTag detection on a gray scale image
  * 
@@ -87,6 +109,40 @@ void cctagDetection(
       logtime::Mgmt* durations = nullptr,
       const CCTagMarkersBank * pBank = nullptr);
 
+/**
+ * @brief Perform the CCTag detection on a gray scale image, delivering compact results.
+ * The capacity of results is kept from one call to the next so that processing
+ * a sequence does not allocate results once the number of markers has stabilized.
+ * 
+ * @param[out] results Detected markers. WARNING: only markers with status == 1 are the valid ones.
+ * @param[in] pipeId Choose between several CUDA pipeline instances
+ * @param[in] frame A frame number. Can be anything (e.g. 0).
+ * @param[in] graySrc Gray scale input image.
+ * @param[in] params Contains all the parameters.
+ * @param[in] pBank CCTag bank. If not provided, the default bank for params._nCrowns is used.
+ */
+void cctagDetection(
+      std::vector<CCTagResult> & results,
+      int                       pipeId,
+      std::size_t frame,
+      const cv::Mat & graySrc,
+      const cctag::Parameters & params,
+      logtime::Mgmt* durations = nullptr,
+      const CCTagMarkersBank * pBank = nullptr);
+
+/**
+ * @brief Same as above on an image held by the caller (camera buffer, strided
+ * ROI, YUV frame), read without an intermediate copy when it has a luma plane.
+ */
+void cctagDetection(
+      std::vector<CCTagResult> & results,
+      int                       pipeId,
+      std::size_t frame,
+      const ImageView & src,
+      const cctag::Parameters & params,
+      logtime::Mgmt* durations = nullptr,
+      const CCTagMarkersBank * pBank = nullptr);
+
 }
 
 #endif	/* PONCTUALCCTAG_HPP */
@@ -14,6 +14,7 @@
 #include <cctag/SubPixEdgeOptimizer.hpp>
 
 #include <cctag/geometry/Circle.hpp>
+#include <cctag/geometry/EllipseFromPoints.hpp>
 #include <cctag/utils/Talk.hpp>
 
 #ifdef WITH_CUDA
@@ -25,7 +26,10 @@
 #include <boost/accumulators/statistics/median.hpp>
 #include <boost/accumulators/statistics/variance.hpp>
 #include <boost/assert.hpp>
+#include <boost/math/constants/constants.hpp>
 
+#include <algorithm>
+#include <array>
 #include <cmath>
 #include <vector>
 
@@ -36,6 +40,52 @@
 namespace cctag {
 namespace identification {
 
+/**
+ * @brief Generate the 1D profile (1 or -1 values) of a marker from its radius
+ * ratios, sampled from beginSig by steps of stepX.
+ * NRatios is the number of radius ratios (2*nCrowns-1) known at compile time,
+ * or 0 to use the size of radiusRatios.
+ */
+template<std::size_t NRatios>
+static void generateProfile(
+        std::vector<float> & digit,
+        const std::vector<float> & radiusRatios,
+        float beginSig,
+        float stepX)
+{
+  const std::size_t nRatios = NRatios ? NRatios : radiusRatios.size();
+  BOOST_ASSERT( radiusRatios.size() == nRatios );
+
+  // Transitions of the profile: the inverse of the radius ratios, computed
+  // once when their count is known at compile time, inline otherwise.
+  std::array<float, NRatios ? NRatios : 1> transitions;
+  if( NRatios )
+  {
+    for( std::size_t j = 0; j < nRatios; ++j )
+    {
+      transitions[j] = 1.f / radiusRatios[j];
+    }
+  }
+
+  float x = beginSig;
+  for(float & i : digit)
+  {
+    std::ssize_t ldum = 0;
+    for( std::size_t j = 0; j < nRatios; ++j )
+    {
+      const float transition = NRatios ? transitions[j] : 1.f / radiusRatios[j];
+      if( transition <= x )
+      {
+        ++ldum;
+      }
+    }
+    // set odd value to -1 and even value to 1
+    i = - ( ldum % 2 ) * 2 + 1;
+    
+    x += stepX;
+  }
+}
+
 /**
  * @brief Read and identify a 1D rectified image signal.
  * 
@@ -48,7 +98,7 @@ namespace identification {
 bool orazioDistanceRobust(
         std::vector<std::list<float> > & vScore,
         const RadiusRatioBank & rrBank,
-        const std::vector<cctag::ImageCut> & cuts,
+        const cctag::CutBatch & cuts,
         float minIdentProba)
 {
   BOOST_ASSERT( cuts.size() > 0 );
@@ -70,11 +120,13 @@ bool orazioDistanceRobust(
 #endif // GRIFF_DEBUG
   
   const size_t cut_count = cuts.size();
-  static tbb::mutex vscore_mutex;
+  const std::size_t nSamples = cuts.nSamples();
+  // Best (id, probability) per cut, gathered in cut order once all the cuts
+  // are processed so that vScore does not depend on the thread scheduling.
+  std::vector<std::pair<MarkerID, float> > bestIds(cut_count, std::make_pair(MarkerID(-1), 0.f));
 
   tbb::parallel_for(size_t(0), cut_count, [&](size_t i) {
-    const cctag::ImageCut& cut = cuts[i];
-    if ( !cut.outOfBounds() )
+    if ( !cuts.outOfBounds(i) )
     {
       MapT sortedId; // 6-nearest neighbours along with their affectation probability
       const std::size_t sizeIds = 6;
@@ -82,13 +134,13 @@ bool orazioDistanceRobust(
       idSet.reserve(sizeIds);
 
       // imgSig contains the rectified 1D signal.
-      //boost::numeric::ublas::vector<float> imgSig( cuts.front().imgSignal().size() );
-      const std::vector<float> & imgSig = cut.imgSignal();
+      const float* imgSig = cuts.signal(i);
+      const float* imgSigEnd = imgSig + nSamples;
 
       // compute some statitics
       accumulator_set< float, features< /*tag::median,*/ tag::variance > > acc;
       // Put the image signal into the accumulator
-      acc = std::for_each( imgSig.begin()+30, imgSig.end(), acc ); // todo@Lilian +30
+      acc = std::for_each( imgSig+30, imgSigEnd, acc ); // todo@Lilian +30
 
       // Mean
       const float medianSig = boost::accumulators::mean( acc );
@@ -102,27 +154,28 @@ bool orazioDistanceRobust(
       accumulator_set< float, features< tag::mean > > accSup;
       
       bool doAccumulate = false;
-      for(float i : imgSig)
+      for(const float* v = imgSig; v != imgSigEnd; ++v)
       {
-        if ( (!doAccumulate) && ( i < medianSig ) )
+        if ( (!doAccumulate) && ( *v < medianSig ) )
           doAccumulate = true;
           
         if (doAccumulate)
         {
-          if ( i < medianSig )
-            accInf( i );
+          if ( *v < medianSig )
+            accInf( *v );
           else
-            accSup( i );
+            accSup( *v );
         }
       }
       const float muw = boost::accumulators::mean( accSup );
       const float mub = boost::accumulators::mean( accInf );
 
       // Find the nearest ID in rrBank
-      const float stepX = (cut.endSig() - cut.beginSig()) / ( imgSig.size() - 1.f );
+      const float beginSig = cuts.beginSig(i);
+      const float stepX = (cuts.endSig(i) - beginSig) / ( nSamples - 1.f );
 
       // vector of 1 or -1 values
-      std::vector<float> digit( imgSig.size() );
+      std::vector<float> digit( nSamples );
 
   #ifdef GRIFF_DEBUG
       assert( rrBank.size() > 0 );
@@ -133,26 +186,16 @@ bool orazioDistanceRobust(
       {
         // Compute the idc-th profile from the radius ratio
         // todo@Lilian: to be pre-computed
-        float x = cut.beginSig();
-        for(float & i : digit)
+        switch( rrBank[idc].size() )
         {
-          std::ssize_t ldum = 0;
-          for(float j : rrBank[idc])
-          {
-            if( 1.f / j <= x )
-            {
-              ++ldum;
-            }
-          }
-          // set odd value to -1 and even value to 1
-          i = - ( ldum % 2 ) * 2 + 1;
-          
-          x += stepX;
+          case 5: generateProfile<5>( digit, rrBank[idc], beginSig, stepX ); break; // 3 crowns
+          case 7: generateProfile<7>( digit, rrBank[idc], beginSig, stepX ); break; // 4 crowns
+          default: generateProfile<0>( digit, rrBank[idc], beginSig, stepX ); break;
         }
 
         // compute distance to profile
         float distance = 0;
-        for( std::size_t i = 0 ; i < imgSig.size() ; ++i )
+        for( std::size_t i = 0 ; i < nSamples ; ++i )
         {
           distance += dis( imgSig[i], digit[i], mub, muw, varSig );
         }
@@ -181,41 +224,46 @@ bool orazioDistanceRobust(
       assert( vScore.size() > _debug_m );
   #endif // GRIFF_DEBUG
 
-      {
-        tbb::mutex::scoped_lock lock(vscore_mutex);
-        vScore[idSet.front().first].push_back(idSet.front().second);
-      }
+      bestIds[i] = idSet.front();
     }
   });
+
+  for(const std::pair<MarkerID, float> & bestId : bestIds)
+  {
+    if (bestId.first != MarkerID(-1))
+      vScore[bestId.first].push_back(bestId.second);
+  }
   return true;
 }
 
-void createRectifiedCutImage(const std::vector<ImageCut> & vCuts, cv::Mat & output)
+void createRectifiedCutImage(const CutBatch & cuts, cv::Mat & output)
 {
-  output = cv::Mat(vCuts.size(), vCuts.front().imgSignal().size(), CV_8UC1);
-  for(int i=0 ; i<vCuts.size() ; ++i)
+  output = cv::Mat(cuts.size(), cuts.nSamples(), CV_8UC1);
+  for(int i=0 ; i<cuts.size() ; ++i)
   {
-    const ImageCut & cut = vCuts[i];
-    for(int j=0 ; j < cut.imgSignal().size() ; ++j)
+    const float* signal = cuts.signal(i);
+    for(int j=0 ; j < cuts.nSamples() ; ++j)
     {
-      output.at<uchar>(i,j) = (uchar) cut.imgSignal()[j];
+      output.at<uchar>(i,j) = (uchar) signal[j];
     }
   }
 }
 
 /**
- * @brief Extract a rectified 1D signal along an image cut based on an homography.
- * 
- * @param[out] cut image cut holding the rectified image signal
- * @param[in] src source grayscale image (uchar)
- * @param[in] mHomography image->cctag homography
- * @param[in] mInvHomography cctag>image homography
+ * @brief Extract a rectified 1D signal along an image cut, given by its stop point
+ * and its signal bounds, into an external buffer.
+ * @return false if at least one sample is out of the image bounds
  */
-void extractSignalUsingHomography(
-        cctag::ImageCut & cut,
+static bool extractSignalUsingHomography(
+        float cutStopX,
+        float cutStopY,
+        float beginSig,
+        float endSig,
         const cv::Mat & src,
         const Eigen::Matrix3f & mHomography,
-        const Eigen::Matrix3f & mInvHomography)
+        const Eigen::Matrix3f & mInvHomography,
+        float* signal,
+        std::size_t nSamples)
 {
   using namespace boost;
   using namespace cctag::numerical;
@@ -223,22 +271,22 @@ void extractSignalUsingHomography(
   float xStart, xStop, yStart, yStop;
   
   float backProjStopX, backProjStopY;
-  applyHomography(backProjStopX, backProjStopY, mInvHomography, cut.stop().x(), cut.stop().y());
+  applyHomography(backProjStopX, backProjStopY, mInvHomography, cutStopX, cutStopY);
   
   // Check whether the signal to be collected start at 0.f and stop at 1.f
-  if ( cut.beginSig() != 0.f)
+  if ( beginSig != 0.f)
   {
-    xStart = backProjStopX * cut.beginSig();
-    yStart = backProjStopY * cut.beginSig();
+    xStart = backProjStopX * beginSig;
+    yStart = backProjStopY * beginSig;
   }else
   {
     xStart = 0;
     yStart = 0;
   }
-  if ( cut.endSig() != 1.f)
+  if ( endSig != 1.f)
   {
-    xStop = backProjStopX * cut.endSig();
-    yStop = backProjStopY * cut.endSig();
+    xStop = backProjStopX * endSig;
+    yStop = backProjStopY * endSig;
   }else
   {
     xStop  = backProjStopX;
@@ -246,7 +294,6 @@ void extractSignalUsingHomography(
   }
 
   // Compute the steps stepX and stepY along x and y.
-  const std::size_t nSamples = cut.imgSignal().size();
   const float stepX = ( xStop - xStart ) / ( nSamples - 1.f );
   const float stepY = ( yStop - yStart ) / ( nSamples - 1.f );
 
@@ -254,6 +301,7 @@ void extractSignalUsingHomography(
 
   float x =  xStart;
   float y =  yStart;
+  bool inBounds = true;
   
   for( std::size_t i = 0; i < nSamples; ++i )
   {
@@ -263,20 +311,55 @@ void extractSignalUsingHomography(
          yRes >= 1.f && yRes <= src.rows-1 )
     {
       // Bilinear interpolation
-      cut.imgSignal()[i] = getPixelBilinear( src, xRes, yRes);
+      signal[i] = getPixelBilinear( src, xRes, yRes);
     }
     else
     {
-      cut.setOutOfBounds(true);
+      inBounds = false;
     }
     
     x += stepX;
     y += stepY;
   }
+  return inBounds;
+}
+
+/**
+ * @brief Extract a rectified 1D signal along an image cut based on an homography.
+ * 
+ * @param[out] cut image cut holding the rectified image signal
+ * @param[in] src source grayscale image (uchar)
+ * @param[in] mHomography image->cctag homography
+ * @param[in] mInvHomography cctag>image homography
+ */
+void extractSignalUsingHomography(
+        cctag::ImageCut & cut,
+        const cv::Mat & src,
+        const Eigen::Matrix3f & mHomography,
+        const Eigen::Matrix3f & mInvHomography)
+{
+  if ( !extractSignalUsingHomography( cut.stop().x(), cut.stop().y(), cut.beginSig(), cut.endSig(),
+                                      src, mHomography, mInvHomography,
+                                      cut.imgSignal().data(), cut.imgSignal().size() ) )
+  {
+    cut.setOutOfBounds(true);
+  }
   //const float sigma = 1.f;
   //blurImageCut(sigma, cut);
 }
 
+bool extractSignalUsingHomography(
+        const cctag::CutBatch & cuts,
+        std::size_t iCut,
+        const cv::Mat & src,
+        const Eigen::Matrix3f & mHomography,
+        const Eigen::Matrix3f & mInvHomography,
+        float* signal)
+{
+  return extractSignalUsingHomography( cuts.stopX(iCut), cuts.stopY(iCut), cuts.beginSig(iCut), cuts.endSig(iCut),
+                                       src, mHomography, mInvHomography, signal, cuts.nSamples() );
+}
+
 void blurImageCut(float sigma, std::vector<float> & signal)
 {
   //const std::vector<float> kernel = { 0.0044, 0.0540, 0.2420, 0.3991, 0.2420, 0.0540, 0.0044 };
@@ -384,44 +467,48 @@ void extractSignalUsingHomographyDeprec(
 
 
 /**
- * @brief Extract a regularly sampled 1D signal along an image cut.
- * 
- * @param[out] cut image cut that will hold the 1D image signal regularly 
- *             collected from cut.beginSig() to cut.endSig()
- * @param[in] src source gray scale image (uchar)
+ * @brief Extract a regularly sampled 1D signal along an image cut, given by its
+ * extremities and its signal bounds, into an external buffer.
+ * @return false if a sample is out of the image bounds, the next ones are then not collected
  */
-void cutInterpolated(
-        cctag::ImageCut & cut,
-        const cv::Mat & src)
+static bool cutInterpolated(
+        float startX,
+        float startY,
+        float stopX,
+        float stopY,
+        float beginSig,
+        float endSig,
+        const cv::Mat & src,
+        float* signal,
+        std::size_t nSamples)
 {
   float xStart, yStart, xStop, yStop;
-  const float diffX = cut.stop().x() - cut.start().x();
-  const float diffY = cut.stop().y() - cut.start().y();
+  const float diffX = stopX - startX;
+  const float diffY = stopY - startY;
   
   // Check whether the signal to be collected start at 0.f and stop at 1.f
-  if ( cut.beginSig() != 0.f)
+  if ( beginSig != 0.f)
   {
     // Don't start at the beginning of the cut.
-    xStart = cut.start().x() + diffX * cut.beginSig();
-    yStart = cut.start().y() + diffY * cut.beginSig();
+    xStart = startX + diffX * beginSig;
+    yStart = startY + diffY * beginSig;
   }else
   {
-    xStart = cut.start().x();
-    yStart = cut.start().y();
+    xStart = startX;
+    yStart = startY;
   }
-  if ( cut.endSig() != 1.f)
+  if ( endSig != 1.f)
   {
     // Don't stop at the end of the cut.
-    xStop = cut.start().x() + diffX * cut.endSig();
-    yStop = cut.start().y() + diffY * cut.endSig();
+    xStop = startX + diffX * endSig;
+    yStop = startY + diffY * endSig;
   }else
   {
-    xStop = cut.stop().x();
-    yStop = cut.stop().y();
+    xStop = stopX;
+    yStop = stopY;
   }
   
   // Compute the steps stepX and stepY along x and y.
-  const std::size_t nSamples = cut.imgSignal().size();
   // We will work on the image while assuming an affine transformation.
   // Therefore, steps are computed in the pixel plane, regularly spaced from
   // the outer ellipse's center (cut.start()) to an outer point (cut.stop()).
@@ -436,22 +523,50 @@ void cutInterpolated(
     if ( x >= 1.f && x < src.cols-1 &&
          y >= 1.f && y < src.rows-1 )
     {
-      //CCTAG_COUT_VAR2(x,y);
       // put pixel value to rectified signal
-      cut.imgSignal()[i] = float(getPixelBilinear( src, x, y));
+      signal[i] = float(getPixelBilinear( src, x, y));
     }
     else
     {
       // push black
-      cut.setOutOfBounds(true);
-      break;
+      return false;
     }
     // Modify x and y to the next element.
-    //CCTAG_COUT_VAR2(x,y);
-    //CCTAG_COUT_VAR2(stepX,stepY);
     x += stepX;
     y += stepY;
-    //CCTAG_COUT_VAR2(x,y);
+  }
+  return true;
+}
+
+/**
+ * @brief Extract a regularly sampled 1D signal along an image cut.
+ * 
+ * @param[out] cut image cut that will hold the 1D image signal regularly 
+ *             collected from cut.beginSig() to cut.endSig()
+ * @param[in] src source gray scale image (uchar)
+ */
+void cutInterpolated(
+        cctag::ImageCut & cut,
+        const cv::Mat & src)
+{
+  if ( !cutInterpolated( cut.start().x(), cut.start().y(), cut.stop().x(), cut.stop().y(),
+                         cut.beginSig(), cut.endSig(), src,
+                         cut.imgSignal().data(), cut.imgSignal().size() ) )
+  {
+    cut.setOutOfBounds(true);
+  }
+}
+
+void cutInterpolated(
+        cctag::CutBatch & cuts,
+        std::size_t iCut,
+        const cv::Mat & src)
+{
+  if ( !cutInterpolated( cuts.startX(iCut), cuts.startY(iCut), cuts.stopX(iCut), cuts.stopY(iCut),
+                         cuts.beginSig(iCut), cuts.endSig(iCut), src,
+                         cuts.signal(iCut), cuts.nSamples() ) )
+  {
+    cuts.setOutOfBounds( iCut, true );
   }
 }
 
@@ -466,7 +581,7 @@ void cutInterpolated(
  * @param[in] beginSig offset from which the signal must be collected (in [0 1])
  */
 void collectCuts(
-        std::vector<cctag::ImageCut> & cuts,
+        cctag::CutBatch & cuts,
         const cv::Mat & src,
         const cctag::Point2d<Eigen::Vector3f> & center,
         const std::vector< cctag::DirectedPoint2d<Eigen::Vector3f> > & outerPoints,
@@ -474,20 +589,22 @@ void collectCuts(
         float beginSig )
 {
   // Collect all the 1D image signals from center to the outer points.
+  cuts.clear();
+  cuts.resizeSignals( nSamplesInCut );
   cuts.reserve( outerPoints.size() );
   for( const cctag::DirectedPoint2d<Eigen::Vector3f> & outerPoint : outerPoints )
   {
     // Here only beginSig is set based on the input argument beginSig while endSig is set to 1.f as 
     // any type of cctags encodes, by construction, a 1D bar-code until the outer ellipse (image 
     // of the unit circle).
-    cuts.emplace_back(center, outerPoint, beginSig, 1.f, nSamplesInCut );
-    cctag::ImageCut & cut = cuts.back();
-    cutInterpolated( cut, src);
-    // Remove the cut from the vector if out of the image bounds.
-    if ( cut.outOfBounds() )
+    cuts.pushBack( center, outerPoint, beginSig, 1.f );
+    const std::size_t iCut = cuts.size() - 1;
+    cutInterpolated( cuts, iCut, src );
+    // Remove the cut from the batch if out of the image bounds.
+    if ( cuts.outOfBounds(iCut) )
     {
-      CCTAG_COUT_VAR_OPTIM(cut.outOfBounds());
-      cuts.pop_back();
+      CCTAG_COUT_VAR_OPTIM(cuts.outOfBounds(iCut));
+      cuts.popBack();
     }
   }
 }
@@ -534,19 +651,24 @@ float costSelectCutFun(
  * This selection aims at "maximizing" the variance of the image signal over all the 
  * selected cuts while ensuring a "good" distribution of the selected outer points
  * around the imaged center.
+ * The collected cuts only need to be sampled coarsely: they are used to estimate
+ * the signal variance. The outer point refinement and the full sampling are only
+ * performed on the selected cuts.
  *
  * @param[out] vSelectedCuts selected image cuts
  * @param[in] selectSize number of desired cuts to select
  * @param[in] collectedCuts all the collected cuts
  * @param[in] src source gray scale image (uchar)
+ * @param[in] nSamplesInCut number of samples of the selected cuts
  */
-void selectCutCheapUniform( std::vector< cctag::ImageCut > & vSelectedCuts,
+void selectCutCheapUniform( cctag::CutBatch & vSelectedCuts,
         std::size_t selectSize,
         const cctag::numerical::geometry::Ellipse & outerEllipse,
-        std::vector<cctag::ImageCut> & collectedCuts,
+        const cctag::CutBatch & collectedCuts,
         const cv::Mat & src,
         const float scale,
-        const size_t numSamplesOuterEdgePointsRefinement)
+        const size_t numSamplesOuterEdgePointsRefinement,
+        const std::size_t nSamplesInCut)
 {
   using namespace boost::numeric;
   using namespace boost::accumulators;
@@ -556,47 +678,73 @@ void selectCutCheapUniform( std::vector< cctag::ImageCut > & vSelectedCuts,
 
   std::vector<float> varCuts;
   varCuts.reserve(collectedCuts.size());
-  for( const cctag::ImageCut & cut : collectedCuts )
+  for( std::size_t iCut = 0; iCut < collectedCuts.size(); ++iCut )
   {
+    const float* signal = collectedCuts.signal(iCut);
     accumulator_set< float, features< tag::variance > > acc;
-    acc = std::for_each( cut.imgSignal().begin(), cut.imgSignal().end(), acc );
+    acc = std::for_each( signal, signal + collectedCuts.nSamples(), acc );
     varCuts.push_back( variance( acc ) );
   }
   
   const float varMax = *std::max_element(varCuts.begin(),varCuts.end());
   
   vSelectedCuts.clear();
+  vSelectedCuts.resizeSignals(nSamplesInCut);
   vSelectedCuts.reserve(selectSize);
   
-  std::size_t sharpSize = 0;
-  
   // Initialize vector of indices of sharp cuts
-  std::vector<std::size_t> indToAdd;
-  indToAdd.reserve(varCuts.size());
+  std::vector<std::size_t> indSharp;
+  indSharp.reserve(varCuts.size());
   
   for(std::size_t iCut = 0 ; iCut < varCuts.size() ; ++iCut)
   {
-    ImageCut & cut = collectedCuts[iCut];
-    cut.stop() = DirectedPoint2d<Eigen::Vector3f>(pointOnEllipse( outerEllipse, cut.stop() ), cut.stop().dX(), cut.stop().dY() );
-    if ( outerEdgeRefinement(cut, src, scale, numSamplesOuterEdgePointsRefinement) )
-      if ( varCuts[iCut]/varMax > 0.5f )
-        indToAdd.push_back(iCut);
+    if ( varCuts[iCut]/varMax > 0.5f )
+      indSharp.push_back(iCut);
   }
   
-  const float step = std::max(1.f, (float) indToAdd.size() / (float) ( selectSize ));
+  const float step = std::max(1.f, (float) indSharp.size() / (float) ( selectSize ));
   
-  for(std::size_t k=0 ; ; ++k)
+  // Take one cut every step. If the outer point of a cut cannot be refined or
+  // the resampled cut leaves the image, the next cuts of the same step are
+  // tried instead.
+  for(std::size_t k=0 ; vSelectedCuts.size() < selectSize ; ++k)
   {
-    if ( ( std::size_t(k*step) < indToAdd.size() ) && ( vSelectedCuts.size() < selectSize) )
-    {
-      ImageCut & cut = collectedCuts[indToAdd[std::size_t(k*step)]];
-      vSelectedCuts.push_back( cut );
-    }else{
+    const std::size_t begin = std::size_t(k*step);
+    const std::size_t end = std::min(std::size_t((k+1)*step), indSharp.size());
+    if ( begin >= indSharp.size() )
       break;
+    
+    for(std::size_t i = begin ; i < end ; ++i)
+    {
+      const std::size_t iCollected = indSharp[i];
+      const DirectedPoint2d<Eigen::Vector3f> collectedStop = collectedCuts.stop(iCollected);
+      // Only the stop point is refined here, the signal is sampled in the batch.
+      ImageCut cut(collectedCuts.start(iCollected),
+                   DirectedPoint2d<Eigen::Vector3f>(pointOnEllipse( outerEllipse, collectedStop ),
+                                                    collectedStop.dX(), collectedStop.dY() ),
+                   collectedCuts.beginSig(iCollected), collectedCuts.endSig(iCollected), 0);
+      if ( outerEdgeRefinement(cut, src, scale, numSamplesOuterEdgePointsRefinement) )
+      {
+        vSelectedCuts.pushBack( cut.start(), cut.stop(), cut.beginSig(), cut.endSig() );
+        const std::size_t iCut = vSelectedCuts.size() - 1;
+        cutInterpolated( vSelectedCuts, iCut, src );
+        if ( !vSelectedCuts.outOfBounds(iCut) )
+          break;
+        vSelectedCuts.popBack();
+      }
     }
   }
 }
 
+// Derivative of gaussian kernels used to locate the outer edge along a cut.
+static constexpr std::size_t kEdgeKernelSize = 9;
+static constexpr std::size_t kEdgeKernelCount = 3;
+static constexpr float kEdgeKernels[kEdgeKernelCount][kEdgeKernelSize] = {
+  { -0.0000, -0.0003, -0.1065, -0.7863, 0, 0.7863, 0.1065, 0.0003, 0.0000 }, // sigma = 0.5
+  { -0.0044, -0.0540, -0.2376, -0.3450, 0, 0.3450, 0.2376, 0.0540, 0.0044 }, // sigma = 1
+  { -0.0366, -0.1113, -0.1801, -0.1594, 0, 0.1594, 0.1801, 0.1113, 0.0366 }  // sigma = 1.5
+};
+
 /* Ugly -> perform an iterative optimization*/
 bool outerEdgeRefinement(ImageCut & cut, const cv::Mat & src, float scale, std::size_t numSamplesOuterEdgePointsRefinement)
 {
@@ -623,24 +771,15 @@ bool outerEdgeRefinement(ImageCut & cut, const cv::Mat & src, float scale, std::
     if (cutOnOuterPoint.outOfBounds())
       return false;
     
-    
-    std::vector<float> kernelA = { -0.0000, -0.0003, -0.1065, -0.7863, 0, 0.7863, 0.1065, 0.0003, 0.0000 }; // size = 9, sigma = 0.5
-    std::vector<float> kernelB = { -0.0044, -0.0540, -0.2376, -0.3450, 0, 0.3450, 0.2376, 0.0540, 0.0044 }; // size = 9, sigma = 1
-    std::vector<float> kernelC = { -0.0366, -0.1113, -0.1801, -0.1594, 0, 0.1594, 0.1801, 0.1113, 0.0366 }; // size = 9, sigma = 1.5
-
-    std::vector<std::vector<float>> vKernels;
-    vKernels.push_back(kernelA);
-    vKernels.push_back(kernelB);
-    vKernels.push_back(kernelC);
-    
-    std::map<float,float> res;
-    
-    for(size_t i=0; i<3 ; ++i)
+    // Keep the location of the highest peak over all kernels (the first one on ties).
+    std::pair<float,float> best = convImageCut(kEdgeKernels[0], kEdgeKernelSize, cutOnOuterPoint);
+    for(size_t i=1; i<kEdgeKernelCount ; ++i)
     {
-      res.insert(convImageCut(vKernels[i], cutOnOuterPoint));
+      const std::pair<float,float> res = convImageCut(kEdgeKernels[i], kEdgeKernelSize, cutOnOuterPoint);
+      if (res.first > best.first)
+        best = res;
     }
-    // Get the location of the highest peak (last element)
-    float maxLocation = res.rbegin()->second;
+    float maxLocation = best.second;
     
     float step = cutLengthOuterPointRefine/((float)numSamplesOuterEdgePointsRefinement-1.f);
     
@@ -654,54 +793,43 @@ bool outerEdgeRefinement(ImageCut & cut, const cv::Mat & src, float scale, std::
 }
 
 std::pair<float,float> convImageCut(const std::vector<float> & kernel, ImageCut & cut)
+{
+  return convImageCut(kernel.data(), kernel.size(), cut);
+}
+
+std::pair<float,float> convImageCut(const float* kernel, std::size_t sizeKernel, const ImageCut & cut)
 {
   //double guassOneD[] = { 0.0044, 0.0540, 0.2420, 0.3991, 0.2420, 0.0540, 0.0044 };
   
-  std::vector<float> output;
-  std::size_t sizeCut = cut.imgSignal().size();
-  std::size_t sizeKernel = kernel.size();
-  output.resize(sizeCut);
-  
-  std::size_t halfSize = (sizeKernel-1)/2;
+  const std::vector<float> & signal = cut.imgSignal();
+  const std::ssize_t sizeCut = signal.size();
+  const std::ssize_t halfSize = (sizeKernel-1)/2;
   
-  //std::cout << "before = [" << std::endl;
-  //for ( std::size_t i=0 ; i<sizeCut; ++i)
-  //{
-  //  std::cout << cut.imgSignal()[i] << " , " ;
-  //}
-  //std::cout << "]; " << std::endl;
+  // Locate the maximum value of the convolved signal (its first occurrence).
+  float maxValue = -std::numeric_limits<float>::max();
+  std::ssize_t maxLocation = 0;
   
   for ( std::ssize_t i=0 ; i<sizeCut; ++i)
   {
     float tmp = 0;
     for ( std::size_t j=0 ; j<sizeKernel; ++j)
     {
-      if ( ssize_t(i-halfSize+j) < 0 )
-        tmp += cut.imgSignal()[0]*kernel[j];
-      else if( (i-halfSize+j) >=  sizeCut)
-        tmp += cut.imgSignal()[sizeCut-1]*kernel[j];
+      const std::ssize_t k = i-halfSize+j;
+      if ( k < 0 )
+        tmp += signal[0]*kernel[j];
+      else if( k >= sizeCut )
+        tmp += signal[sizeCut-1]*kernel[j];
       else
-        tmp += cut.imgSignal()[i-halfSize+j]*kernel[j];
+        tmp += signal[k]*kernel[j];
+    }
+    if (tmp > maxValue)
+    {
+      maxValue = tmp;
+      maxLocation = i;
     }
-    output[i] = tmp;
   }
   
-  //std::cout << "convolved = [" << std::endl;
-  //for ( std::size_t i=0 ; i<sizeCut; ++i)
-  //{
-  //  std::cout << output[i] << " , " ;
-  //}
-  //std::cout << "]; " << std::endl;
-  
-  //cut.imgSignal() = output;
-  
-  // Locate the maximum value.
-  std::vector<float>::iterator maxValueIt = std::max_element(output.begin(), output.end());
-  float itsLocation = (float) std::distance(output.begin(), maxValueIt);
-  
-  //CCTAG_COUT_VAR2(*maxValueIt, itsLocation);
-  
-  return std::pair<float,float>(*maxValueIt,itsLocation);// max value, its location
+  return std::pair<float,float>(maxValue, (float) maxLocation);// max value, its location
 }
 
 /**
@@ -723,6 +851,19 @@ void getSignals(
   }
 }
 
+void getSignals(
+        cctag::CutBatch & cuts,
+        const Eigen::Matrix3f & mHomography,
+        const cv::Mat & src)
+{
+  Eigen::Matrix3f mInvHomography = mHomography.inverse();
+  for( std::size_t iCut = 0; iCut < cuts.size(); ++iCut )
+  {
+    if ( !extractSignalUsingHomography( cuts, iCut, src, mHomography, mInvHomography, cuts.signal(iCut) ) )
+      cuts.setOutOfBounds( iCut, true );
+  }
+}
+
 /**
  * @brief Compute an homography (up to a 2D rotation) based on its imaged origin [0,0,1]'
  * and its imaged unit circle (represented as an ellipse, assuming only quasi-affine transformation.
@@ -800,34 +941,39 @@ void computeHomographyFromEllipseAndImagedCenter(
  * @param[in] tagIndex a sequence number for this tag
  * @param[out] mHomography optimal image->cctag homography
  * @param[out] optimalPoint optimal imaged center
- * @param[out] vCuts cuts holding the rectified 1D signals at the end of the optimization
+ * @param[out] cuts cuts holding the rectified 1D signals at the end of the optimization
  * @param[in] src source image
  * @param[in] ellipse outer ellipse (todo: is that already in the cctag object?)
  * @param[in] params parameters of the cctag algorithm
+ * @param[out] nEvaluations number of evaluations of the cost function (0 on the CUDA path)
  * @return true if the optimization has found a solution, false otherwise.
  */
 bool refineConicFamilyGlob(
         int tagIndex,
         Eigen::Matrix3f & mHomography,
         Point2d<Eigen::Vector3f> & optimalPoint,
-        std::vector< cctag::ImageCut > & vCuts, 
+        cctag::CutBatch & cuts, 
         const cv::Mat & src,
         cctag::TagPipe* cudaPipe,
         const cctag::numerical::geometry::Ellipse & outerEllipse,
         const cctag::Parameters & params,
         cctag::NearbyPoint* cctag_pointer_buffer,
-        float & residual)
+        float & residual,
+        std::size_t & nEvaluations,
+        DebugSink& debug)
 {
     using namespace cctag::numerical;
 
+    nEvaluations = 0;
+
     // Visual debug
-    CCTagVisualDebug::instance().newSession( "refineConicPts" );
-    for(const cctag::ImageCut & cut : vCuts)
+    debug.visual().newSession( "refineConicPts" );
+    for(std::size_t iCut = 0; iCut < cuts.size(); ++iCut)
     {
-        CCTagVisualDebug::instance().drawPoint( cut.stop(), cctag::color_red );
+        debug.visual().drawPoint( cuts.stop(iCut), cctag::color_red );
     }
-    CCTagVisualDebug::instance().newSession( "centerOpt" );
-    CCTagVisualDebug::instance().drawPoint( optimalPoint, cctag::color_green );
+    debug.visual().newSession( "centerOpt" );
+    debug.visual().drawPoint( optimalPoint, cctag::color_green );
 
 #ifdef WITH_CUDA
     if( cudaPipe ) {
@@ -859,26 +1005,81 @@ bool refineConicFamilyGlob(
   
         float maxSemiAxis = std::max(outerEllipse.a(),outerEllipse.b());
   
-
   // Tests against synthetic experiments have shown that we do not reach a precision
   // better than 0.02 pixel.
-  while ( neighbourSize*maxSemiAxis > 0.02 )       
+  const float precision = 0.02f;
+  
+  if ( params._imagedCenterPatternSearch )
   {
-    if ( imageCenterOptimizationGlob( mHomography,   // out
-                                      vCuts,         // out
-                                      optimalPoint,  // out
-                                      residual,      // out
-                                      neighbourSize,
-                                      src,
-                                      outerEllipse,
-                                      params ) )
+    cuts.resizeSignals(params._sampleCutLength);
+    
+    if ( !imageCenterPatternSearch( mHomography,   // out
+                                    cuts,          // out
+                                    optimalPoint,  // out
+                                    residual,      // out
+                                    neighbourSize,
+                                    src,
+                                    outerEllipse,
+                                    precision,
+                                    nEvaluations,
+                                    debug ) )
     {
-      CCTagVisualDebug::instance().drawPoint( optimalPoint, cctag::color_blue );
-      neighbourSize /= float((gridNSample-1)/2) ;
-    }else{
       return false;
     }
+    DO_TALK( CCTAG_COUT_DEBUG( "Optimization cost evaluations: " << nEvaluations ); )
+  }
+  else
+  {
+    std::vector<float> neighbourSizes;
+    while ( neighbourSize*maxSemiAxis > precision )       
+    {
+      neighbourSizes.push_back(neighbourSize);
+      neighbourSize /= float((gridNSample-1)/2) ;
+    }
+  
+    // Coarse-to-fine signal sampling: the number of samples per cut grows as the
+    // neighbourhood (i.e. the grid spacing) shrinks. The last iteration is always
+    // performed on full length signals as its residual is the one returned.
+    const std::size_t fullLength = params._sampleCutLength;
+    const std::size_t minLength = std::min(params._imagedCenterMinSampleCutLength, fullLength);
+    std::size_t nSampledPoints = 0;
+
+    // Copied from the full length cuts, so that the scratch signals of each
+    // thread are allocated once for the tag and only resized afterwards.
+    tbb::enumerable_thread_specific<cctag::CutBatch> scratches(cuts);
+  
+    for(const float size : neighbourSizes)
+    {
+      const std::size_t nSamples = std::max( minLength,
+              std::min( fullLength, std::size_t( fullLength * neighbourSizes.back() / size + 0.5f ) ) );
+      cuts.resizeSignals(nSamples);
+      nSampledPoints += gridNSample * gridNSample * cuts.size() * nSamples;
+    
+      if ( imageCenterOptimizationGlob( mHomography,   // out
+                                        cuts,          // out
+                                        optimalPoint,  // out
+                                        residual,      // out
+                                        size,
+                                        src,
+                                        outerEllipse,
+                                        params,
+                                        scratches,
+                                        nEvaluations,
+                                        debug ) )
+      {
+        debug.visual().drawPoint( optimalPoint, cctag::color_blue );
+      }else{
+        return false;
+      }
+    }
+    DO_TALK(
+      CCTAG_COUT_DEBUG( "Optimization cost evaluations: " << nEvaluations );
+      CCTAG_COUT_DEBUG( "Optimization sampled points: " << nSampledPoints << " (full length: "
+        << gridNSample * gridNSample * cuts.size() * fullLength * neighbourSizes.size() << ")" );
+    )
   }
+  // Back to full length signals, collected below.
+  cuts.resizeSignals(params._sampleCutLength);
   
   // Measure the time spent in the optimization
   boost::posix_time::ptime tend( boost::posix_time::microsec_clock::local_time() );
@@ -889,29 +1090,29 @@ bool refineConicFamilyGlob(
 #ifdef WITH_CUDA
     } // not CUDA
 #endif // WITH_CUDA
-    CCTagVisualDebug::instance().drawPoint( optimalPoint, cctag::color_red );
+    debug.visual().drawPoint( optimalPoint, cctag::color_red );
   
     // B. Get the signal associated to the optimal homography/imaged center //////
     {
         boost::posix_time::ptime tstart( boost::posix_time::microsec_clock::local_time() );
-        getSignals(vCuts,mHomography,src);
+        getSignals(cuts,mHomography,src);
         boost::posix_time::ptime tend( boost::posix_time::microsec_clock::local_time() );
         boost::posix_time::time_duration d = tend - tstart;
     }
     
     // Residual normalization
     std::vector<std::size_t> correctCutIndices;
-    correctCutIndices.reserve(vCuts.size());
+    correctCutIndices.reserve(cuts.size());
 
-    for(std::size_t iCut=0 ; iCut < vCuts.size() ; ++iCut) {
-    if ( !vCuts[iCut].outOfBounds() )
+    for(std::size_t iCut=0 ; iCut < cuts.size() ; ++iCut) {
+    if ( !cuts.outOfBounds(iCut) )
         correctCutIndices.push_back(iCut);
     }
 
     // In barCode will be written the most frequent signal for every samples along
     // the cut.
     std::vector<float> barCode;
-    const std::size_t signalSize = vCuts[0].imgSignal().size();
+    const std::size_t signalSize = cuts.nSamples();
     barCode.resize(signalSize);
 
     std::vector<float> signalAlongX;
@@ -920,7 +1121,7 @@ bool refineConicFamilyGlob(
     for(std::size_t iSignal = 0 ; iSignal < signalSize ; ++iSignal)
     {
       for(std::size_t k=0 ; k <  correctCutIndices.size() ; ++k){
-        signalAlongX[k] = vCuts[correctCutIndices[k]].imgSignal()[iSignal];
+        signalAlongX[k] = cuts.signal(correctCutIndices[k])[iSignal];
       }
       barCode[iSignal] = computeMedian( signalAlongX );
     }
@@ -960,11 +1161,53 @@ bool refineConicFamilyGlob(
       return true;
 }
 
+/**
+ * @brief Compute the residual associated to a candidate imaged center.
+ * 
+ * @param[in] point candidate imaged center
+ * @param[in] outerEllipse outer ellipse
+ * @param[out] cuts image cuts holding the rectified signal
+ * @param[in] src source gray (uchar) image
+ * @param[out] mHomography homography associated to the candidate
+ * @param[out] res residual
+ * @return false if the homography cannot be computed or if no cut-pair is readable
+ */
+static bool evaluateImagedCenter(
+        const cctag::Point2d<Eigen::Vector3f> & point,
+        const cctag::numerical::geometry::Ellipse & outerEllipse,
+        cctag::CutBatch & cuts,
+        const cv::Mat & src,
+        Eigen::Matrix3f & mHomography,
+        float & res)
+{
+  // Compute the homography so that the back projection of 'point' is the
+  // center, i.e. [0;0;1], and the back projected ellipse is the unit circle
+  try
+  {
+    computeHomographyFromEllipseAndImagedCenter(
+        outerEllipse,     // in (ellipse)
+        point,            // in (Point2d)
+        mHomography);     // out (matrix3x3)
+  } catch(...) {
+    return false;
+  }
+
+  // Compute the 1D rectified signals of the image cuts based on the 
+  // transformation mHomography.
+  bool readable = true;
+  res = costFunctionGlob(mHomography, cuts, src, readable );
+  if ( !readable )
+  {
+    CCTAG_COUT_VAR_OPTIM(readable);
+  }
+  return readable;
+}
+
 /**
  * @brief Convex optimization of the imaged center within a point's neighbourhood.
  * 
  * @param[out] mHomography optimal homography from the pixel plane to the cctag plane.
- * @param[out] vCuts vector of the image cuts whose the signal has been rectified w.r.t. the computed mHomography
+ * @param[out] cuts image cuts whose the signal has been rectified w.r.t. the computed mHomography
  * @param[in-out] center optimal imaged center
  * @param[out] minRes residual after optimization
  * @param[in] neighbourSize size of the neighbourhood to consider relatively to the outer ellipse dimensions
@@ -975,13 +1218,16 @@ bool refineConicFamilyGlob(
  */
 bool imageCenterOptimizationGlob(
         Eigen::Matrix3f & mHomography,
-        std::vector< cctag::ImageCut > & vCuts,
+        cctag::CutBatch & cuts,
         cctag::Point2d<Eigen::Vector3f> & center,
         float & minRes,
         float neighbourSize,
         const cv::Mat & src, 
         const cctag::numerical::geometry::Ellipse& outerEllipse,
-        const cctag::Parameters & params )
+        const cctag::Parameters & params,
+        tbb::enumerable_thread_specific<cctag::CutBatch> & scratches,
+        std::size_t & nEvaluations,
+        DebugSink& debug )
 {
     cctag::Point2d<Eigen::Vector3f> optimalPoint;
     Eigen::Matrix3f optimalHomography;
@@ -1001,51 +1247,67 @@ bool imageCenterOptimizationGlob(
                      GRID );        // in (enum)
 
     minRes = std::numeric_limits<float>::max();
-    Eigen::Matrix3f mTempHomography;
  
-    // For all points nearby the center ////////////////////////////////////////
-    for(const cctag::Point2d<Eigen::Vector3f> & point : nearbyPoints)
+    // B. Evaluate all points nearby the center ////////////////////////////////
+    // The grid points are evaluated concurrently, each thread rectifying the signals
+    // in its own scratch buffers. Nested in the parallel identification of the tags,
+    // the iterations can still be stolen by other threads.
+    const std::size_t nPoints = nearbyPoints.size();
+    std::vector<float> vRes(nPoints);
+    std::vector<char> vReadable(nPoints, false);
+    std::vector<char> vEvaluated(nPoints, false);
+    std::vector<Eigen::Matrix3f> vHomographies(nPoints);
+    
+    // Each thread works on its own copy of the cuts. A cut is skipped if it was
+    // out of bounds before the evaluation started, whatever the previous grid
+    // points evaluated by the thread.
+    tbb::parallel_for(size_t(0), nPoints, [&](size_t iPoint) {
+      cctag::CutBatch & scratch = scratches.local();
+      if ( scratch.nSamples() != cuts.nSamples() )
+        scratch.resizeSignals(cuts.nSamples());
+      scratch.setOutOfBoundsMask(cuts.outOfBoundsMask());
+      
+      // Compute the homography so that the back projection of the point is the
+      // center, i.e. [0;0;1], and the back projected ellipse is the unit circle
+      try
+      {
+        computeHomographyFromEllipseAndImagedCenter(
+            outerEllipse,            // in (ellipse)
+            nearbyPoints[iPoint],    // in (Point2d)
+            vHomographies[iPoint]);  // out (matrix3x3)
+      } catch(...) {
+        return;
+      }
+      
+      bool readable = true;
+      vRes[iPoint] = costFunctionGlob( vHomographies[iPoint], scratch, src, readable );
+      vReadable[iPoint] = readable;
+      vEvaluated[iPoint] = true;
+    });
+    
+    // C. Keep the first point of lowest residual ////////////////////////////////
+    for(std::size_t iPoint = 0 ; iPoint < nPoints ; ++iPoint)
     {
-        CCTagVisualDebug::instance().drawPoint( point , cctag::color_green );
-
-        // B. Compute the homography so that the back projection of 'point' is the
-        // center, i.e. [0;0;1], and the back projected ellipse is the unit circle
-
-        bool   readable = true;
-        float res;
+        debug.visual().drawPoint( nearbyPoints[iPoint] , cctag::color_green );
+        nEvaluations += vEvaluated[iPoint];
 
-        {
-            try
-            {
-                computeHomographyFromEllipseAndImagedCenter(
-                    outerEllipse,     // in (ellipse)
-                    point,            // in (Point2d)
-                    mTempHomography); // out (matrix3x3)
-            } catch(...) {
-                continue; 
-            }
-
-            // C. Compute the 1D rectified signals of vCuts image cut based on the 
-            // transformation mTempHomography.
-            res = costFunctionGlob(mTempHomography, vCuts, src, readable );
-        }
-      
         // If at least one image cut has been properly read
-        if ( readable )
+        if ( vReadable[iPoint] )
         {       
-        
                 // Update the residual and the optimized parameters
                 hasASolution = true;
-                if ( res < minRes )
+                if ( vRes[iPoint] < minRes )
                 {
-                    minRes = res;
-                    optimalPoint = point;
-                    optimalHomography = mTempHomography;
+                    minRes = vRes[iPoint];
+                    optimalPoint = nearbyPoints[iPoint];
+                    optimalHomography = vHomographies[iPoint];
                 }
-        } else { // not readable
-                CCTAG_COUT_VAR_OPTIM(readable);
         }
-    } // for(point : nearbyPoints)
+    }
+    
+    // Only the signals of the optimal point are written back in the image cuts.
+    if ( hasASolution )
+      getSignals( cuts, optimalHomography, src );
 
     center = optimalPoint;
     mHomography = optimalHomography;
@@ -1053,6 +1315,97 @@ bool imageCenterOptimizationGlob(
     return hasASolution;
 }
   
+// Safeguard on the number of cost evaluations of the pattern search.
+static const std::size_t kPatternSearchMaxEvaluations = 500;
+
+bool imageCenterPatternSearch(
+        Eigen::Matrix3f & mHomography,
+        cctag::CutBatch & cuts,
+        cctag::Point2d<Eigen::Vector3f> & center,
+        float & minRes,
+        float neighbourSize,
+        const cv::Mat & src, 
+        const cctag::numerical::geometry::Ellipse& outerEllipse,
+        float precision,
+        std::size_t & nEvaluations,
+        DebugSink& debug)
+{
+    cctag::Point2d<Eigen::Vector3f> optimalPoint;
+    Eigen::Matrix3f optimalHomography;
+    Eigen::Matrix3f mTempHomography;
+    bool hasASolution = false;
+    float res;
+
+    minRes = std::numeric_limits<float>::max();
+    nEvaluations = 0;
+
+    // A. Seed with the best point of a coarse 3x3 grid over the neighbourhood
+    std::vector<cctag::Point2d<Eigen::Vector3f> > nearbyPoints;
+    getNearbyPoints( outerEllipse, center, nearbyPoints, neighbourSize, 3, GRID );
+
+    for(const cctag::Point2d<Eigen::Vector3f> & point : nearbyPoints)
+    {
+        debug.visual().drawPoint( point , cctag::color_green );
+        ++nEvaluations;
+        if ( evaluateImagedCenter( point, outerEllipse, cuts, src, mTempHomography, res ) )
+        {
+            hasASolution = true;
+            if ( res < minRes )
+            {
+                minRes = res;
+                optimalPoint = point;
+                optimalHomography = mTempHomography;
+            }
+        }
+    }
+
+    if ( !hasASolution )
+      return false;
+
+    // B. Compass search: move to the best of the 4 axis-aligned neighbours as long
+    // as it decreases the residual, otherwise halve the step. The initial step is
+    // half the grid spacing (in pixels).
+    const float gridWidth = (nearbyPoints.back().x() - nearbyPoints.front().x());
+    float step = gridWidth / 4.f;
+    static const float kDirections[4][2] = { { 1, 0 }, { -1, 0 }, { 0, 1 }, { 0, -1 } };
+
+    while ( step > precision && nEvaluations < kPatternSearchMaxEvaluations )
+    {
+      bool hasMoved = false;
+      cctag::Point2d<Eigen::Vector3f> bestPoint = optimalPoint;
+
+      for(const auto & direction : kDirections)
+      {
+        const cctag::Point2d<Eigen::Vector3f> point(
+                optimalPoint.x() + step*direction[0],
+                optimalPoint.y() + step*direction[1] );
+        ++nEvaluations;
+        if ( evaluateImagedCenter( point, outerEllipse, cuts, src, mTempHomography, res ) && res < minRes )
+        {
+          minRes = res;
+          bestPoint = point;
+          optimalHomography = mTempHomography;
+          hasMoved = true;
+        }
+      }
+
+      if ( hasMoved )
+      {
+        optimalPoint = bestPoint;
+        debug.visual().drawPoint( optimalPoint, cctag::color_blue );
+      }
+      else
+      {
+        step /= 2.f;
+      }
+    }
+
+    center = optimalPoint;
+    mHomography = optimalHomography;
+
+    return true;
+}
+
 /**
  * @brief Compute a set of point locations nearby a given center following
  * a given type of pattern (e.g. regularly sampled points over a grid)
@@ -1153,6 +1506,122 @@ float costFunctionGlob(
   }
 }
 
+float costFunctionGlob(
+        const Eigen::Matrix3f & mHomography,
+        cctag::CutBatch & cuts,
+        const cv::Mat & src,
+        bool & flag)
+{
+  flag = true;
+  
+  // Get the rectified signals along the image cuts
+  getSignals( cuts, mHomography, src);
+
+  float res = 0;
+  std::size_t resSize = 0;
+  const std::size_t nSamples = cuts.nSamples();
+  for( std::size_t i = 0; i < cuts.size() - 1; ++i )
+  {
+    if ( cuts.outOfBounds(i) )
+      continue;
+    const float* is = cuts.signal(i);
+    for( std::size_t j = i+1; j < cuts.size(); ++j )
+    {
+      if ( !cuts.outOfBounds(j) )
+      {
+        const float* js = cuts.signal(j);
+        for (size_t ii = 0; ii < nSamples; ++ii)
+          res += std::pow(is[ii] - js[ii], 2);
+        ++resSize;
+      }
+    }
+  }
+  // If no cut-pair has been found within the image bounds.
+  if ( resSize == 0)
+  {
+    flag = false;
+    return std::numeric_limits<float>::max();
+  }else{
+    // normalize, dividing by the total number of pairs in the image bounds.
+    return res / resSize;
+  }
+}
+
+// Decimation of the cuts collected for the selection, see identify_step_1.
+static const std::size_t kCutDecimation = 4;
+
+float signalBegin(std::size_t nCrowns)
+{
+  if (nCrowns == 3)
+  {
+    // Signal begin at 25% of the unit radius (for 3 black rings markers).
+    return 1 - (2*nCrowns-1)*0.15;
+  }
+  else if (nCrowns == 4)
+  {
+    return 0.26; // todo@Lilian
+  }
+  CCTAG_COUT("Error : unknown number of crowns");
+  return 0.f;
+}
+
+bool hasRingProfile(
+        const cctag::numerical::geometry::Ellipse & ellipse,
+        const cv::Mat & src,
+        const cctag::Parameters & params)
+{
+  // Stay clear of the outer edge: only the inner circles are counted.
+  const float beginSig = signalBegin(params._nCrowns);
+  const float endSig = 0.95f;
+  const std::size_t nSamples = 6 * params._nCircles;
+  // A cut is "ring-like" if it crosses at least about half of the nCircles-1
+  // inner circles, which leaves room for blur and perspective.
+  const std::size_t minTransitions = params._nCrowns;
+  // Minimal contrast along a cut (getPixelBilinear halves the gray levels).
+  const float minContrast = 5.f;
+
+  std::size_t nValidCuts = 0;
+  std::size_t nRingLikeCuts = 0;
+
+  const float step = 2.f * boost::math::constants::pi<float>() / params._ringProfileNumCuts;
+  for (std::size_t k = 0; k < params._ringProfileNumCuts; ++k)
+  {
+    const DirectedPoint2d<Eigen::Vector3f> outerPoint(
+      cctag::numerical::geometry::extractEllipsePointAtAngle(ellipse, k * step), 0.f, 0.f);
+
+    cctag::ImageCut cut(ellipse.center(), outerPoint, beginSig, endSig, nSamples);
+    cutInterpolated(cut, src);
+    if (cut.outOfBounds())
+      continue;
+    ++nValidCuts;
+
+    const std::vector<float> & sig = cut.imgSignal();
+    const auto minMax = std::minmax_element(sig.begin(), sig.end());
+    const float contrast = *minMax.second - *minMax.first;
+    if (contrast < minContrast)
+      continue;
+
+    // Count the transitions with an hysteresis around the mid level.
+    const float low = *minMax.first + 0.35f * contrast;
+    const float high = *minMax.first + 0.65f * contrast;
+    int state = 0; // -1: black, 1: white, 0: not yet known
+    std::size_t nTransitions = 0;
+    for (float v : sig)
+    {
+      const int newState = (v < low) ? -1 : ((v > high) ? 1 : state);
+      if (state != 0 && newState != state)
+        ++nTransitions;
+      state = newState;
+    }
+
+    if (nTransitions >= minTransitions)
+      ++nRingLikeCuts;
+  }
+
+  // Do not reject what could not be seen.
+  return nValidCuts == 0 || 2 * nRingLikeCuts >= nValidCuts;
+}
+
 /**
  * @brief Identify a marker:
  *   i) its imaged center is optimized: A. 1D image cuts are selected ; B. the optimization is performed 
@@ -1168,15 +1637,22 @@ float costFunctionGlob(
 int identify_step_1(
   int tagIndex,
   const CCTag & cctag,
-  std::vector<cctag::ImageCut>& vSelectedCuts,
+  cctag::CutBatch & vSelectedCuts,
   const cv::Mat &  src,
-  const cctag::Parameters & params)
+  const cctag::Parameters & params,
+  DebugSink& debug)
 {
   // Get the outer ellipse in its original scale, i.e. in src.
   const cctag::numerical::geometry::Ellipse & ellipse = cctag.rescaledOuterEllipse();
   // Get the outer points in their original scale, i.e. in src.
   const std::vector< cctag::DirectedPoint2d<Eigen::Vector3f> > & outerEllipsePoints = cctag.rescaledOuterEllipsePoints();
 
+  // 0. Cheap rejection of the ellipses which are clearly not CCTags //////////
+  if (params._ringProfileCheck && !hasRingProfile(ellipse, src, params))
+  {
+    return status::no_ring_profile;
+  }
+
   // A. Pick a subsample of outer points ///////////////////////////////////////
   // Cheap (CPU only)
   
@@ -1208,27 +1684,13 @@ int identify_step_1(
   // Visual debug
   for(const cctag::DirectedPoint2d<Eigen::Vector3f> & point : outerPoints)
   {
-    CCTagVisualDebug::instance().drawPoint( Point2d<Eigen::Vector3f>(point.x(), point.y()), cctag::color_green );
+    debug.visual().drawPoint( Point2d<Eigen::Vector3f>(point.x(), point.y()), cctag::color_green );
   }
 
   // Set from where the rectified 1D signal should be read.
   // In fact, the white area located inside the inner ellipse does not hold
   // any information neither for the optimization nor for the reading.
-  float startSig = 0.f;
-  if (params._nCrowns == 3)
-  {
-    // Signal begin at 25% of the unit radius (for 3 black rings markers).
-    // startOffset
-    startSig = 1 - (2*params._nCrowns-1)*0.15;
-  }
-  else if (params._nCrowns == 4)
-  {
-    startSig = 0.26; // todo@Lilian
-  }
-  else
-  {
-    CCTAG_COUT("Error : unknown number of crowns");
-  }
+  const float startSig = signalBegin(params._nCrowns);
   // The "signal of interest" is located between startSig and 1.f (endSig in ImageCut)
 
 #ifdef CCTAG_OPTIM
@@ -1236,11 +1698,14 @@ int identify_step_1(
 #endif
   
   // B. Collect all cuts associated to all outer points ////////////////////////
-  std::vector<cctag::ImageCut> cuts;
+  cctag::CutBatch cuts;
   {
     boost::posix_time::ptime tstart( boost::posix_time::microsec_clock::local_time() );
     
-    collectCuts( cuts, src, ellipse.center(), outerPoints, params._sampleCutLength, startSig);
+    // The collected cuts are only used to estimate the signal variance in the
+    // selection, a decimated sampling is enough.
+    const std::size_t nSamplesCheap = std::max<std::size_t>(params._sampleCutLength / kCutDecimation, 2);
+    collectCuts( cuts, src, ellipse.center(), outerPoints, nSamplesCheap, startSig);
     
     boost::posix_time::ptime tend( boost::posix_time::microsec_clock::local_time() );
     boost::posix_time::time_duration d = tend - tstart;
@@ -1274,7 +1739,8 @@ int identify_step_1(
             cuts,
             src,
             cctag.scale(),
-            params._numSamplesOuterEdgePointsRefinement);
+            params._numSamplesOuterEdgePointsRefinement,
+            params._sampleCutLength);
     
     DO_TALK( CCTAG_COUT_OPTIM("Initial cut selection"); )
     
@@ -1314,22 +1780,24 @@ int identify_step_1(
 int identify_step_2(
   int tagIndex,
   CCTag & cctag,
-  std::vector<cctag::ImageCut>& vSelectedCuts,
+  cctag::CutBatch & vSelectedCuts,
   const std::vector< std::vector<float> > & radiusRatios, // todo: directly use the CCTagBank
   const cv::Mat &  src,
   cctag::TagPipe* cudaPipe,
-  const cctag::Parameters & params)
+  const cctag::Parameters & params,
+  DebugSink& debug)
 {
   // Get the outer ellipse in its original scale, i.e. in src.
   const cctag::numerical::geometry::Ellipse & ellipse = cctag.rescaledOuterEllipse();
 
   float residual = std::numeric_limits<float>::max();
+  std::size_t nEvaluations = 0;
     
   // C. Imaged center optimization /////////////////////////////////////////////
   // Expensive (GPU) Time bottleneck, the only function (including its sub functions) to be implemented on GPU
   // Note Inputs (CPU->GPU):
   //       i) src is already on GPU
-  //       ii) _imgSignal in all ImageCut of vSelectedCuts do not need to be transfert,
+  //       ii) the signals of vSelectedCuts do not need to be transfert,
   //       these signals will be collected inside the function.
   //       iii) cctag.homography(): 3x3 float homography, cctag.centerImg(): 2 floats (x,y), ellipse: (see Ellipse.hpp)
   // Begin GPU //////
@@ -1347,16 +1815,19 @@ int identify_step_2(
 #else
                         nullptr,
 #endif
-                        residual
+                        residual,
+                        nEvaluations,
+                        debug
                         );
   
   cctag.setQuality(1.f/residual);
+  cctag.setCenterEvaluations(nEvaluations);
   
   // End GPU ////////
   // Note Outputs (GPU->CPU):
   //        The main amount of data to transfert is only that way and is 'vSelectedCuts', 
   //        the other outputs are of negligible size.
-  //        All the ImageCut in vSelectedCuts including their attribute _imgSignal have to be transfer back to CPU.
+  //        All the cuts in vSelectedCuts including their signals have to be transfer back to CPU.
   //        This operation is done once per marker. A maximum of 30 markers will be processed per frame. The 
   //        maximum number of cuts will be of 50. The maximum length of each _imgSignal will of 100*float.
   if( !hasConverged )
@@ -1386,12 +1857,12 @@ int identify_step_2(
 #ifdef VISUAL_DEBUG // todo: write a proper function in visual debug
   cv::Mat output;
   createRectifiedCutImage(vSelectedCuts, output);
-  CCTagVisualDebug::instance().initBackgroundImage(output);
-  CCTagVisualDebug::instance().newSession( "rectifiedSignal" + 
-    std::to_string(CCTagVisualDebug::instance().getMarkerIndex()) );
-  CCTagVisualDebug::instance().incrementMarkerIndex();
+  debug.visual().initBackgroundImage(output);
+  debug.visual().newSession( "rectifiedSignal" + 
+    std::to_string(debug.visual().getMarkerIndex()) );
+  debug.visual().incrementMarkerIndex();
   // Back to session refineConicPts
-  CCTagVisualDebug::instance().newSession( "refineConicPts" );
+  debug.visual().newSession( "refineConicPts" );
 #endif // OPTIM_CENTER_VISUAL_DEBUG
     
 #ifdef GRIFF_DEBUG
@@ -1428,7 +1899,8 @@ int identify_step_2(
 
       // Set CCTag id
       cctag.setId( iMax );
-      cctag.setIdSet( idSet );
+      if ( !params._resultOnly )
+        cctag.setIdSet( idSet );
       cctag.setRadiusRatios( radiusRatios[iMax] );
 
       // Push all the ellipses based on the obtained homography.
@@ -7,9 +7,10 @@
  */
 #pragma once
 
-#include <cctag/utils/VisualDebug.hpp>
+#include <cctag/utils/DebugSink.hpp>
 #include <cctag/EllipseGrowing.hpp>
 #include <cctag/ImageCut.hpp>
+#include <cctag/CutBatch.hpp>
 #include <cctag/geometry/Ellipse.hpp>
 #include <cctag/geometry/Distance.hpp>
 #include <cctag/Statistic.hpp>
@@ -22,6 +23,8 @@
 #include <boost/math/special_functions/pow.hpp>
 #include <boost/date_time/posix_time/posix_time.hpp>
 
+#include <tbb/enumerable_thread_specific.h>
+
 #include <cmath>
 #include <vector>
 
@@ -41,6 +44,28 @@ enum NeighborType {
   COV
 };
   
+/**
+ * @brief Cheap check that the inside of an outer ellipse looks like the crowns
+ * of a CCTag. A few radial cuts are read in the affinely rectified marker, i.e.
+ * from the ellipse center to points of the outer ellipse, and the black/white
+ * transitions met along them are counted.
+ * 
+ * @param[in] ellipse outer ellipse in the original image
+ * @param[in] src original gray scale image (original scale, uchar)
+ * @param[in] params set of parameters
+ * @return false if the candidate is clearly not a CCTag
+ */
+bool hasRingProfile(
+        const cctag::numerical::geometry::Ellipse & ellipse,
+        const cv::Mat & src,
+        const cctag::Parameters & params);
+
+/**
+ * @brief Position, in the unit radius, from where the rectified 1D signal is
+ * read. The white area located inside the inner ellipse holds no information.
+ */
+float signalBegin(std::size_t nCrowns);
+
 /**
  * @brief Identify a marker:
  *   i) its imaged center is optimized: A. 1D image cuts are selected ; B. the optimization is performed 
@@ -53,16 +78,18 @@ enum NeighborType {
  * @param[in] radiusRatios bank of radius ratios along with their associated IDs.
  * @param[in] src original gray scale image (original scale, uchar)
  * @param[in] params set of parameters
+ * @param[in,out] debug debug output of the detection
  * @return status of the markers (c.f. all the possible status are located in CCTag.hpp) 
  */
 int identify_step_1(
     int tagIndex,
 	const CCTag & cctag,
-    std::vector<cctag::ImageCut>& vSelectedCuts,
+    cctag::CutBatch & vSelectedCuts,
 	// const std::vector< std::vector<float> > & radiusRatios,
 	const cv::Mat & src,
     // cctag::TagPipe* pipe,
-	const cctag::Parameters & params);
+	const cctag::Parameters & params,
+	DebugSink& debug);
 
 /**
  * @brief Identify a marker:
@@ -76,16 +103,18 @@ int identify_step_1(
  * @param[in] radiusRatios bank of radius ratios along with their associated IDs.
  * @param[in] src original gray scale image (original scale, uchar)
  * @param[in] params set of parameters
+ * @param[in,out] debug debug output of the detection
  * @return status of the markers (c.f. all the possible status are located in CCTag.hpp) 
  */
 int identify_step_2(
     int tagIndex,
 	CCTag & cctag,
-    std::vector<cctag::ImageCut>& vSelectedCuts,
+    cctag::CutBatch & vSelectedCuts,
 	const std::vector< std::vector<float> > & radiusRatios,
 	const cv::Mat & src,
     cctag::TagPipe* cudaPipe,
-	const cctag::Parameters & params);
+	const cctag::Parameters & params,
+	DebugSink& debug);
 
 using RadiusRatioBank = std::vector<std::vector<float>>;
 using CutSelectionVec =  std::vector< std::pair< cctag::Point2d<Eigen::Vector3f>, cctag::ImageCut>>;
@@ -125,7 +154,7 @@ inline void applyHomography(
 bool orazioDistanceRobust(
         std::vector<std::list<float> > & vScore,
         const RadiusRatioBank & rrBank,
-        const std::vector<cctag::ImageCut> & cuts,
+        const cctag::CutBatch & cuts,
         float minIdentProba);
 
 /**
@@ -142,6 +171,26 @@ void extractSignalUsingHomography(
         const Eigen::Matrix3f & mHomography,
         const Eigen::Matrix3f & mInvHomography);
 
+/**
+ * @brief Extract a rectified 1D signal along one cut of a batch based on an homography,
+ * without modifying the batch.
+ * 
+ * @param[in] cuts image cuts
+ * @param[in] iCut index of the cut in the batch
+ * @param[in] src source grayscale image (uchar)
+ * @param[in] mHomography image->cctag homography
+ * @param[in] mInvHomography cctag>image homography
+ * @param[out] signal rectified image signal (cuts.nSamples() samples), samples out of the image bounds are left unchanged
+ * @return false if at least one sample is out of the image bounds, true otherwise
+ */
+bool extractSignalUsingHomography(
+        const cctag::CutBatch & cuts,
+        std::size_t iCut,
+        const cv::Mat & src,
+        const Eigen::Matrix3f & mHomography,
+        const Eigen::Matrix3f & mInvHomography,
+        float* signal);
+
 /* deprecated */
 void extractSignalUsingHomographyDeprec(
         cctag::ImageCut & rectifiedCut,
@@ -162,8 +211,26 @@ void cutInterpolated(
         cctag::ImageCut & cut,
         const cv::Mat & src);
 
+/**
+ * @brief Same as above, for one cut of a batch.
+ * 
+ * @param[in,out] cuts image cuts, the signal of the iCut-th one is collected
+ * @param[in] iCut index of the cut in the batch
+ * @param[in] src source gray scale image (uchar)
+ */
+void cutInterpolated(
+        cctag::CutBatch & cuts,
+        std::size_t iCut,
+        const cv::Mat & src);
+
 std::pair<float,float> convImageCut(const std::vector<float> & kernel, ImageCut & cut);
 
+/**
+ * @brief Convolve the signal of an image cut with a kernel (replicated borders).
+ * @return the maximum of the convolved signal and its (first) location
+ */
+std::pair<float,float> convImageCut(const float* kernel, std::size_t sizeKernel, const ImageCut & cut);
+
 void blurImageCut(float sigma, cctag::ImageCut & cut);
 
 bool outerEdgeRefinement(ImageCut & cut, const cv::Mat & src, float scale, size_t numSamplesOuterEdgePointsRefinement);
@@ -179,12 +246,12 @@ bool outerEdgeRefinement(ImageCut & cut, const cv::Mat & src, float scale, size_
  * @param[in] beginSig offset from which the signal must be collected (in [0 1])
  */
 void collectCuts(
-        std::vector<cctag::ImageCut> & cuts, 
+        cctag::CutBatch & cuts, 
         const cv::Mat & src,
         const cctag::Point2d<Eigen::Vector3f> & center,
         const std::vector< cctag::DirectedPoint2d<Eigen::Vector3f> > & outerPoints,
-        std::size_t sampleCutLength,
-        std::size_t startOffset );
+        std::size_t nSamplesInCut,
+        float beginSig );
 
 /*
  * @brief Bilinear interpolation for a point whose coordinates are (x,y)
@@ -233,6 +300,18 @@ void getSignals(
         const Eigen::Matrix3f & mHomography,
         const cv::Mat & src);
 
+/**
+ * @brief Collect rectified 1D signals along a batch of image cuts.
+ * 
+ * @param[out] cuts image cuts whose the rectified signal is to be to computed
+ * @param[in] mHomography transformation image->cctag used to rectified the 1D signal
+ * @param[in] src source gray scale image (uchar)
+ */
+void getSignals(
+        cctag::CutBatch & cuts,
+        const Eigen::Matrix3f & mHomography,
+        const cv::Mat & src);
+
 /**
  * @brief Compute the optimal homography/imaged center based on the 
  * signal in the image and  the outer ellipse, supposed to be image the unit circle.
@@ -240,30 +319,34 @@ void getSignals(
  * @param[in] tagIndex a sequence number for this tag
  * @param[out] mHomography image->cctag homography to optimize
  * @param[out] optimalPoint imaged center to optimize
- * @param[out] vCuts cuts holding the rectified 1D signals at the end of the optimization
+ * @param[in,out] cuts cuts holding the rectified 1D signals at the end of the optimization
  * @param[out] residual from the optimization (normalized w.r.t. binary pattern)
  * @param[in] src source image
  * @param[in] outerEllipse outer ellipse
  * @param[in] params parameters of the cctag algorithm
+ * @param[out] nEvaluations number of evaluations of the cost function (0 on the CUDA path)
+ * @param[in,out] debug debug output of the detection
  * @return true if the optimization has found a solution, false otherwise.
  */
 bool refineConicFamilyGlob(
         int tagIndex,
         Eigen::Matrix3f & mHomography,
         Point2d<Eigen::Vector3f> & optimalPoint,
-        std::vector< cctag::ImageCut > & vCuts, 
+        cctag::CutBatch & cuts, 
         const cv::Mat & src,
         cctag::TagPipe* cudaPipe,
         const cctag::numerical::geometry::Ellipse & outerEllipse,
         const cctag::Parameters & params,
         cctag::NearbyPoint* cctag_pointer_buffer,
-        float & residual);
+        float & residual,
+        std::size_t & nEvaluations,
+        DebugSink& debug);
 
 /**
  * @brief Convex optimization of the imaged center within a point's neighbourhood.
  * 
  * @param[out] mHomography optimal homography from the pixel plane to the cctag plane.
- * @param[out] vCuts vector of the image cuts whose the signal has been rectified w.r.t. the computed mHomography
+ * @param[out] cuts image cuts whose the signal has been rectified w.r.t. the computed mHomography
  * @param[out] center optimal imaged center
  * @param[out] minRes residual after optimization
  * @param[in] neighbourSize size of the neighbourhood to consider relatively to the outer ellipse dimensions
@@ -272,16 +355,50 @@ bool refineConicFamilyGlob(
  * @param[inout] cudaPipe CUDA object handle, changing
  * @param[in] outerEllipse outer ellipse
  * @param[in] params Parameters read from config file
+ * @param[in,out] scratches per thread copies of cuts, made once per tag by the
+ * caller and reused by all its refinement steps: only their signals are resized
+ * @param[in,out] nEvaluations incremented by the number of evaluations of the cost function
+ * @param[in,out] debug debug output of the detection
  */
 bool imageCenterOptimizationGlob(
         Eigen::Matrix3f & mHomography,
-        std::vector< cctag::ImageCut > & vCuts,
+        cctag::CutBatch & cuts,
         cctag::Point2d<Eigen::Vector3f> & center,
         float & minRes,
         float neighbourSize,
         const cv::Mat & src, 
         const cctag::numerical::geometry::Ellipse & outerEllipse,
-        const cctag::Parameters & params );
+        const cctag::Parameters & params,
+        tbb::enumerable_thread_specific<cctag::CutBatch> & scratches,
+        std::size_t & nEvaluations,
+        DebugSink& debug );
+
+/**
+ * @brief Optimization of the imaged center by a pattern (compass) search seeded
+ * by the best point of a 3x3 grid over a point's neighbourhood.
+ * 
+ * @param[out] mHomography optimal homography from the pixel plane to the cctag plane.
+ * @param[out] cuts image cuts whose the signal has been rectified w.r.t. the last evaluated homography
+ * @param[inout] center optimal imaged center
+ * @param[out] minRes residual after optimization
+ * @param[in] neighbourSize size of the neighbourhood to consider relatively to the outer ellipse dimensions
+ * @param[in] src source gray (uchar) image
+ * @param[in] outerEllipse outer ellipse
+ * @param[in] precision step (in pixels) under which the search stops
+ * @param[out] nEvaluations number of evaluations of the cost function
+ * @param[in,out] debug debug output of the detection
+ */
+bool imageCenterPatternSearch(
+        Eigen::Matrix3f & mHomography,
+        cctag::CutBatch & cuts,
+        cctag::Point2d<Eigen::Vector3f> & center,
+        float & minRes,
+        float neighbourSize,
+        const cv::Mat & src, 
+        const cctag::numerical::geometry::Ellipse & outerEllipse,
+        float precision,
+        std::size_t & nEvaluations,
+        DebugSink& debug);
 
 
 /**
@@ -333,6 +450,21 @@ float costFunctionGlob(
         const cv::Mat & src,
         bool & flag);
 
+/**
+ * @brief Same as above, on a batch of image cuts.
+ * 
+ * @param[in] mHomography transformation used to rectified the 1D signal from the pixel plane to the cctag plane.
+ * @param[out] cuts image cuts holding the rectified signal according to mHomography
+ * @param[in] src source gray scale image (uchar)
+ * @param[out] flag: true if at least one image cut has been readable (within the image bounds), false otherwise.
+ * @return residual
+ */
+float costFunctionGlob(
+        const Eigen::Matrix3f & mHomography,
+        cctag::CutBatch & cuts,
+        const cv::Mat & src,
+        bool & flag);
+
 
 /**
  * @brief COmpute a median value from a vector of scalar values
@@ -7,7 +7,7 @@
  */
 #include <cctag/utils/Defines.hpp>
 #include <cctag/ImagePyramid.hpp>
-#include <cctag/utils/VisualDebug.hpp>
+#include <cctag/utils/DebugSink.hpp>
 
 #include <opencv2/imgproc/imgproc.hpp>
 
@@ -32,7 +32,12 @@ ImagePyramid::ImagePyramid( std::size_t width, std::size_t height, std::size_t n
   }
 }
 
-void ImagePyramid::build( const cv::Mat & src, float thrLowCanny, float thrHighCanny, const cctag::Parameters* params )
+void ImagePyramid::build( const cv::Mat & src, float thrLowCanny, float thrHighCanny, const cctag::Parameters* params, DebugSink& debug )
+{
+  build( ImageView(src), thrLowCanny, thrHighCanny, params, debug );
+}
+
+void ImagePyramid::build( const ImageView & src, float thrLowCanny, float thrHighCanny, const cctag::Parameters* params, DebugSink& debug )
 {
 #ifdef WITH_CUDA
     if( params->_useCuda ) {
@@ -56,8 +61,8 @@ void ImagePyramid::build( const cv::Mat & src, float thrLowCanny, float thrHighC
   {
     std::stringstream outFilenameCanny;
     outFilenameCanny << "cannyLevel" << i;
-    CCTagVisualDebug::instance().initBackgroundImage(_levels[i]->getEdges());
-    CCTagVisualDebug::instance().newSession(outFilenameCanny.str());
+    debug.visual().initBackgroundImage(_levels[i]->getEdges());
+    debug.visual().newSession(outFilenameCanny.str());
     
 #ifdef CCTAG_EXTRA_LAYER_DEBUG
     std::stringstream dX, dY;
@@ -65,26 +70,28 @@ void ImagePyramid::build( const cv::Mat & src, float thrLowCanny, float thrHighC
     
     dX << "dX" << i;
     sIntToUchar(_levels[i]->getDx(), imgDX);
-    CCTagVisualDebug::instance().initBackgroundImage(imgDX);
-    CCTagVisualDebug::instance().newSession(dX.str());   
+    debug.visual().initBackgroundImage(imgDX);
+    debug.visual().newSession(dX.str());   
     dY << "dY" << i;
     sIntToUchar(_levels[i]->getDy(), imgDY);
-    CCTagVisualDebug::instance().initBackgroundImage(imgDY);
-    CCTagVisualDebug::instance().newSession(dY.str()); 
+    debug.visual().initBackgroundImage(imgDY);
+    debug.visual().newSession(dY.str()); 
     
     outFilenameCanny << "_wt";
-    CCTagVisualDebug::instance().initBackgroundImage(_levels[i]->getCannyNotThin());
-    CCTagVisualDebug::instance().newSession(outFilenameCanny.str());
+    debug.visual().initBackgroundImage(_levels[i]->getCannyNotThin());
+    debug.visual().newSession(outFilenameCanny.str());
     
     CCTAG_COUT("src_");
-    CCTagVisualDebug::instance().coutImage<uchar>(_levels[i]->getSrc());
+    debug.visual().coutImage<uchar>(_levels[i]->getSrc());
     
     CCTAG_COUT("dx_");
-    CCTagVisualDebug::instance().coutImage<short>(_levels[i]->getDx());
+    debug.visual().coutImage<short>(_levels[i]->getDx());
     CCTAG_COUT("dy_");
-    CCTagVisualDebug::instance().coutImage<short>(_levels[i]->getDy());
+    debug.visual().coutImage<short>(_levels[i]->getDy());
 #endif
   }
+#else
+  (void) debug;
 #endif
 }
 
@@ -19,6 +19,7 @@
 namespace cctag {
 
 class Parameters; // forward declaration
+class DebugSink;
 
 class ImagePyramid
 {
@@ -35,7 +36,12 @@ public:
   
     /* The pyramid building function is never called if CUDA is used.
      */
-  void build(const cv::Mat & src, float thrLowCanny, float thrHighCanny, const cctag::Parameters* params );
+  void build(const cv::Mat & src, float thrLowCanny, float thrHighCanny, const cctag::Parameters* params, DebugSink& debug );
+
+    /* Level 0 reads the luma of the view in place when it has a luma plane,
+     * the coarser levels are subsampled from it as usual.
+     */
+  void build(const ImageView & src, float thrLowCanny, float thrHighCanny, const cctag::Parameters* params, DebugSink& debug );
 
 private:
   std::vector<Level*> _levels;
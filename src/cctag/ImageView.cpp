@@ -0,0 +1,103 @@
+/*
+ * Copyright 2016, Simula Research Laboratory
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+#include <cctag/ImageView.hpp>
+
+#include <cassert>
+#include <stdexcept>
+
+namespace cctag {
+
+namespace {
+
+PixelFormat formatOf(const cv::Mat& image)
+{
+  switch (image.type())
+  {
+    case CV_8UC1: return PixelFormat::Gray8;
+    case CV_8UC3: return PixelFormat::BGR8;
+    case CV_8UC4: return PixelFormat::BGRA8;
+    default: throw std::invalid_argument("cctag::ImageView: unsupported cv::Mat type");
+  }
+}
+
+// Luma of packed 4:2:2, one sample every two bytes starting at offset.
+void copyPackedLuma(const ImageView& view, std::size_t offset, cv::Mat& dst)
+{
+  for (int y = 0; y < view.height; ++y)
+  {
+    const unsigned char* in = view.data + y * view.stride + offset;
+    unsigned char* out = dst.ptr<unsigned char>(y);
+    for (int x = 0; x < view.width; ++x)
+      out[x] = in[2 * x];
+  }
+}
+
+} // namespace
+
+ImageView::ImageView(const unsigned char* data, int width, int height, std::size_t stride,
+                     PixelFormat format)
+  : data(data)
+  , width(width)
+  , height(height)
+  , stride(stride)
+  , format(format)
+{
+}
+
+ImageView::ImageView(const cv::Mat& image)
+  : data(image.data)
+  , width(image.cols)
+  , height(image.rows)
+  , stride(image.step)
+  , format(formatOf(image))
+{
+}
+
+bool ImageView::hasLumaPlane() const
+{
+  return format == PixelFormat::Gray8 || format == PixelFormat::NV12
+      || format == PixelFormat::NV21 || format == PixelFormat::I420;
+}
+
+cv::Mat ImageView::lumaPlane() const
+{
+  assert(hasLumaPlane());
+  // OpenCV does not write through a header it is only given to read.
+  return cv::Mat(height, width, CV_8UC1, const_cast<unsigned char*>(data), stride);
+}
+
+void ImageView::copyLumaTo(cv::Mat& dst) const
+{
+  dst.create(height, width, CV_8UC1);
+  switch (format)
+  {
+    case PixelFormat::Gray8:
+    case PixelFormat::NV12:
+    case PixelFormat::NV21:
+    case PixelFormat::I420:
+      lumaPlane().copyTo(dst);
+      break;
+    case PixelFormat::YUYV:
+      copyPackedLuma(*this, 0, dst);
+      break;
+    case PixelFormat::UYVY:
+      copyPackedLuma(*this, 1, dst);
+      break;
+    case PixelFormat::BGR8:
+      cv::cvtColor(cv::Mat(height, width, CV_8UC3, const_cast<unsigned char*>(data), stride), dst, cv::COLOR_BGR2GRAY);
+      break;
+    case PixelFormat::RGB8:
+      cv::cvtColor(cv::Mat(height, width, CV_8UC3, const_cast<unsigned char*>(data), stride), dst, cv::COLOR_RGB2GRAY);
+      break;
+    case PixelFormat::BGRA8:
+      cv::cvtColor(cv::Mat(height, width, CV_8UC4, const_cast<unsigned char*>(data), stride), dst, cv::COLOR_BGRA2GRAY);
+      break;
+  }
+}
+
+} // namespace cctag
@@ -0,0 +1,81 @@
+/*
+ * Copyright 2016, Simula Research Laboratory
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+#ifndef _CCTAG_IMAGEVIEW_HPP_
+#define _CCTAG_IMAGEVIEW_HPP_
+
+#include <opencv2/opencv.hpp>
+
+#include <cstddef>
+
+namespace cctag {
+
+/**
+ * @brief Layout of the pixels of an ImageView. Only the luma of the YUV
+ * formats is used by the detection, the chroma is never read.
+ */
+enum class PixelFormat
+{
+  Gray8, ///< 8-bit gray
+  NV12,  ///< Y plane followed by interleaved UV, 4:2:0
+  NV21,  ///< Y plane followed by interleaved VU, 4:2:0
+  I420,  ///< Y, U and V planes, 4:2:0
+  YUYV,  ///< packed Y0 U Y1 V, 4:2:2
+  UYVY,  ///< packed U Y0 V Y1, 4:2:2
+  BGR8,  ///< packed 8-bit BGR
+  RGB8,  ///< packed 8-bit RGB
+  BGRA8  ///< packed 8-bit BGRA
+};
+
+/**
+ * @brief Non owning view on an image held by the caller: a raw buffer of a
+ * camera SDK, a strided region of interest or a cv::Mat.
+ *
+ * The view must stay valid until the detection of the image returns.
+ */
+struct ImageView
+{
+  /**
+   * @param data first pixel of the view
+   * @param width width in pixels
+   * @param height height in pixels
+   * @param stride bytes between two rows; for the planar and semi-planar YUV
+   * formats, the stride of the luma plane
+   * @param format pixel layout
+   */
+  ImageView(const unsigned char* data, int width, int height, std::size_t stride,
+            PixelFormat format = PixelFormat::Gray8);
+
+  /**
+   * @brief View on the pixels of a CV_8UC1 (Gray8), CV_8UC3 (BGR8) or CV_8UC4
+   * (BGRA8) image, ROIs included.
+   */
+  explicit ImageView(const cv::Mat& image);
+
+  /// @brief Whether the luma is stored as a plane of 8-bit samples that the
+  /// detection can read in place.
+  bool hasLumaPlane() const;
+
+  /// @brief Header on the luma plane, without copy. Requires hasLumaPlane().
+  cv::Mat lumaPlane() const;
+
+  /**
+   * @brief Write the luma into dst, allocated as a width x height CV_8UC1 image
+   * if needed, in a single pass over the view.
+   */
+  void copyLumaTo(cv::Mat& dst) const;
+
+  const unsigned char* data;
+  int width;
+  int height;
+  std::size_t stride;
+  PixelFormat format;
+};
+
+} // namespace cctag
+
+#endif
@@ -19,6 +19,7 @@ Level::Level( std::size_t width, std::size_t height, int debug_info_level, bool
     : _level( debug_info_level )
     , _cuda_allocates( cuda_allocates )
     , _mat_initialized_from_cuda( false )
+    , _src_is_view( false )
     , _cols( width )
     , _rows( height )
 {
@@ -63,7 +64,51 @@ void Level::setLevel( const cv::Mat & src,
         exit( -__LINE__ );
     }
 
+    ownSrc();
     cv::resize( src, *_src, cv::Size(_src->cols,_src->rows) );
+    detectEdges( thrLowCanny, thrHighCanny, params );
+}
+
+void Level::setLevel( const ImageView & view,
+                      float thrLowCanny,
+                      float thrHighCanny,
+                      const cctag::Parameters* params )
+{
+    if( _cuda_allocates ) {
+        std::cerr << "This function makes no sense with CUDA in " << __FUNCTION__ << ":" << __LINE__ << std::endl;
+        exit( -__LINE__ );
+    }
+
+    if( static_cast<std::size_t>(view.width) != _cols || static_cast<std::size_t>(view.height) != _rows ) {
+        ownSrc();
+        cv::Mat gray;
+        view.copyLumaTo( gray );
+        cv::resize( gray, *_src, cv::Size(_src->cols,_src->rows) );
+    } else if( view.hasLumaPlane() ) {
+        *_src = view.lumaPlane();
+        _src_is_view = true;
+    } else {
+        ownSrc();
+        view.copyLumaTo( *_src );
+    }
+    detectEdges( thrLowCanny, thrHighCanny, params );
+}
+
+/* After a setLevel on a luma plane, _src shares the caller's buffer: give it
+ * back its own storage before writing into it. */
+void Level::ownSrc( )
+{
+    if( _src_is_view ) {
+        _src->release();
+        _src->create( _rows, _cols, CV_8UC1 );
+        _src_is_view = false;
+    }
+}
+
+void Level::detectEdges( float thrLowCanny,
+                         float thrHighCanny,
+                         const cctag::Parameters* params )
+{
     // ASSERT TODO : check that the data are allocated here
     // Compute derivative and canny edge extraction.
     cvRecodedCanny( *_src, *_edges, *_dx, *_dy,
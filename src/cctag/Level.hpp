@@ -8,6 +8,8 @@
 #ifndef _CCTAG_LEVEL_HPP
 #define	_CCTAG_LEVEL_HPP
 
+#include <cctag/ImageView.hpp>
+
 #include <opencv2/opencv.hpp>
 
 namespace cctag {
@@ -30,6 +32,16 @@ public:
                  float thrLowCanny,
                  float thrHighCanny,
                  const cctag::Parameters* params );
+
+  /**
+   * @brief Level at the size of the view. A luma plane is read in place and
+   * stays referenced by getSrc() until the next setLevel; other formats are
+   * converted to gray in the pass that fills the source image.
+   */
+  void setLevel( const ImageView & view,
+                 float thrLowCanny,
+                 float thrHighCanny,
+                 const cctag::Parameters* params );
 #ifdef WITH_CUDA
   void setLevel( cctag::TagPipe* cuda_pipe,
                  const cctag::Parameters& params );
@@ -57,9 +69,15 @@ public:
   
 
 private:
+  void ownSrc( );
+  void detectEdges( float thrLowCanny,
+                    float thrHighCanny,
+                    const cctag::Parameters* params );
+
   int         _level;
   bool        _cuda_allocates;
   bool        _mat_initialized_from_cuda;
+  bool        _src_is_view;
   std::size_t _cols;
   std::size_t _rows;
   
@@ -6,8 +6,8 @@
  * file, You can obtain one at http://mozilla.org/MPL/2.0/.
  */
 #include <cctag/Multiresolution.hpp>
-#include <cctag/utils/VisualDebug.hpp>
-#include <cctag/utils/FileDebug.hpp>
+#include <cctag/Statistic.hpp>
+#include <cctag/utils/DebugSink.hpp>
 #include <cctag/Vote.hpp>
 #include <cctag/EllipseGrowing.hpp>
 #include <cctag/geometry/EllipseFromPoints.hpp>
@@ -15,14 +15,22 @@
 #include <cctag/Canny.hpp>
 #include <cctag/Detection.hpp>
 #include <cctag/utils/Talk.hpp> // for DO_TALK macro
+#include <cctag/utils/Trace.hpp>
 
 #include <boost/timer.hpp>
 #include <boost/date_time/posix_time/posix_time.hpp>
 
+#include <tbb/tbb.h>
+
+#include <algorithm>
 #include <cmath>
+#include <cstdint>
 #include <sstream>
 #include <fstream>
 #include <map>
+#include <memory>
+#include <unordered_map>
+#include <vector>
 
 #include <limits>
 
@@ -40,13 +48,106 @@ namespace cctag
  *
  */
 
+namespace {
+
+/**
+ * @brief Edge points of a collection bucketed by row and sorted by abscissa
+ * within each row, so that the points of a horizontal segment are found
+ * without probing every pixel of the edge map.
+ */
+class EdgeRowIndex
+{
+public:
+  explicit EdgeRowIndex(const EdgePointCollection & edgeCollection)
+    : _width(int(edgeCollection.shape()[0]))
+    , _rowStart(edgeCollection.shape()[1] + 1, 0)
+  {
+    const int height = int(edgeCollection.shape()[1]);
+    const int nPoints = edgeCollection.get_point_count();
+
+    // Only the points referenced by the edge map are visible through
+    // edgeCollection(x,y): index exactly those.
+    std::vector<EdgePoint*> points;
+    points.reserve(nPoints);
+    for (int i = 0; i < nPoints; ++i)
+    {
+      EdgePoint* edgePoint = edgeCollection(i);
+      const int x = edgePoint->x();
+      const int y = edgePoint->y();
+      if (x >= 0 && x < _width && y >= 0 && y < height && edgeCollection(x,y) == edgePoint)
+      {
+        points.push_back(edgePoint);
+        ++_rowStart[y+1];
+      }
+    }
+    for (int y = 0; y < height; ++y)
+      _rowStart[y+1] += _rowStart[y];
+
+    _entries.resize(points.size());
+    std::vector<int> fill(_rowStart.begin(), _rowStart.end() - 1);
+    for (EdgePoint* edgePoint : points)
+      _entries[fill[edgePoint->y()]++] = Entry{ edgePoint->x(), edgePoint };
+
+    for (int y = 0; y < height; ++y)
+    {
+      std::sort(_entries.begin() + _rowStart[y], _entries.begin() + _rowStart[y+1],
+        [](const Entry & a, const Entry & b) { return a.x < b.x; });
+    }
+  }
+
+  int width() const { return _width; }
+
+  /**
+   * @brief Call f on every edge point of the row y whose abscissa lies in
+   * [begin, end], by increasing abscissa.
+   */
+  template<typename F>
+  void forEachInRow(int y, int begin, int end, F f) const
+  {
+    if (end < begin)
+      return;
+    const auto first = _entries.begin() + _rowStart[y];
+    const auto last = _entries.begin() + _rowStart[y+1];
+    auto it = std::lower_bound(first, last, begin,
+      [](const Entry & e, int x) { return e.x < x; });
+    for (; it != last && it->x <= end; ++it)
+      f(it->point);
+  }
+
+private:
+  struct Entry
+  {
+    int x;
+    EdgePoint* point;
+  };
+
+  int _width;
+  std::vector<int> _rowStart; // first entry of each row, plus the total count
+  std::vector<Entry> _entries;
+};
+
+} // namespace
+
 static bool intersectLineToTwoEllipses(
         std::ssize_t y,
         const numerical::geometry::Ellipse & qIn,
         const numerical::geometry::Ellipse & qOut,
-        const EdgePointCollection & edgeCollection,
-        std::list<EdgePoint*> & pointsInHull)
+        const EdgeRowIndex & edgeIndex,
+        std::vector<EdgePoint*> & pointsInHull)
 {
+  // Check that the gradient is opposed to the ellipse's center before pushing it.
+  const auto pushIfOpposed = [&qIn, &pointsInHull](EdgePoint* edgePoint)
+  {
+    Eigen::Vector2f centerToPoint;
+    centerToPoint(0) = qIn.center().x() - (*edgePoint).x();
+    centerToPoint(1) = qIn.center().y() - (*edgePoint).y();
+
+    if (edgePoint->gradient().dot(centerToPoint) < 0)
+    {
+      pointsInHull.push_back(edgePoint);
+    }
+  };
+
   std::vector<float> intersectionsOut = numerical::geometry::intersectEllipseWithLine(qOut, y, true);
   std::vector<float> intersectionsIn = numerical::geometry::intersectEllipseWithLine(qIn, y, true);
   BOOST_ASSERT(intersectionsOut.size() <= 2);
@@ -54,84 +155,27 @@ static bool intersectLineToTwoEllipses(
   if ((intersectionsOut.size() == 2) && (intersectionsIn.size() == 2))
   {
     std::ssize_t begin1 = std::max(0, (int) intersectionsOut[0]);
-    std::ssize_t end1 = std::min((int) edgeCollection.shape()[0] - 1, (int) intersectionsIn[0]);
+    std::ssize_t end1 = std::min(edgeIndex.width() - 1, (int) intersectionsIn[0]);
 
     std::ssize_t begin2 = std::max(0, (int) intersectionsIn[1]);
-    std::ssize_t end2 = std::min((int) edgeCollection.shape()[0] - 1, (int) intersectionsOut[1]);
+    std::ssize_t end2 = std::min(edgeIndex.width() - 1, (int) intersectionsOut[1]);
 
-    for (int x = begin1; x <= end1; ++x)
-    {
-      EdgePoint* edgePoint = edgeCollection(x,y);
-      if (edgePoint)
-      {
-        // Check that the gradient is opposed to the ellipse's center before pushing it.
-        Eigen::Vector2f centerToPoint;
-        centerToPoint(0) = qIn.center().x() - (*edgePoint).x();
-        centerToPoint(1) = qIn.center().y() - (*edgePoint).y();
-        
-        if (edgePoint->gradient().dot(centerToPoint) < 0)
-        {
-          pointsInHull.push_back(edgePoint);
-        }
-      }
-    }
-    for (int x = begin2; x <= end2; ++x)
-    {
-      EdgePoint* edgePoint = edgeCollection(x,y);
-      if (edgePoint)
-      {
-        // Check that the gradient is opposed to the ellipse's center before pushing it.
-        Eigen::Vector2f centerToPoint;
-        centerToPoint(0) = qIn.center().x() - (*edgePoint).x();
-        centerToPoint(1) = qIn.center().y() - (*edgePoint).y();
-        
-        if (edgePoint->gradient().dot(centerToPoint) < 0)
-        {
-          pointsInHull.push_back(edgePoint);
-        }
-      }
-    }
+    edgeIndex.forEachInRow(y, begin1, end1, pushIfOpposed);
+    edgeIndex.forEachInRow(y, begin2, end2, pushIfOpposed);
   }
   else if ((intersectionsOut.size() == 2) && (intersectionsIn.size() <= 1))
   {
     std::ssize_t begin = std::max(0, (int) intersectionsOut[0]);
-    std::ssize_t end = std::min((int) edgeCollection.shape()[0] - 1, (int) intersectionsOut[1]);
+    std::ssize_t end = std::min(edgeIndex.width() - 1, (int) intersectionsOut[1]);
 
-    for (int x = begin; x <= end; ++x)
-    {
-      EdgePoint* edgePoint = edgeCollection(x,y);
-      if (edgePoint)
-      {
-        // Check that the gradient is opposed to the ellipse's center before pushing it.
-        
-        Eigen::Vector2f centerToPoint;
-        centerToPoint(0) = qIn.center().x() - (*edgePoint).x();
-        centerToPoint(1) = qIn.center().y() - (*edgePoint).y();
-        
-        if (edgePoint->gradient().dot(centerToPoint) < 0)
-        {
-          pointsInHull.push_back(edgePoint);
-        }
-      }
-    }
+    edgeIndex.forEachInRow(y, begin, end, pushIfOpposed);
   }
   else if ((intersectionsOut.size() == 1) && (intersectionsIn.size() == 0))
   {
-    if ((intersectionsOut[0] >= 0) && (intersectionsOut[0] < edgeCollection.shape()[0]))
+    if ((intersectionsOut[0] >= 0) && (intersectionsOut[0] < edgeIndex.width()))
     {
-      EdgePoint* edgePoint = edgeCollection(intersectionsOut[0],y);
-      if (edgePoint)
-      {
-        // Check that the gradient is opposed to the ellipse's center before pushing it.
-        Eigen::Vector2f centerToPoint;
-        centerToPoint(0) = qIn.center().x() - (*edgePoint).x();
-        centerToPoint(1) = qIn.center().y() - (*edgePoint).y();
-        
-        if (edgePoint->gradient().dot(centerToPoint) < 0)
-        {
-          pointsInHull.push_back(edgePoint);
-        }
-      }
+      const int x = (int) intersectionsOut[0];
+      edgeIndex.forEachInRow(y, x, x, pushIfOpposed);
     }
   }
   else //if( intersections.size() == 0 )
@@ -141,11 +185,17 @@ static bool intersectLineToTwoEllipses(
   return true;
 }
 
+/**
+ * @brief Collect the edge points lying between the two ellipses bounding the
+ * outer ellipse of a marker detected on a coarse level, in the order the rows
+ * are visited: from the center downwards, then from the center upwards.
+ */
 static void selectEdgePointInEllipticHull(
-        const EdgePointCollection & edgeCollection,
+        const EdgeRowIndex & edgeIndex,
+        std::size_t height,
         const numerical::geometry::Ellipse & outerEllipse,
         float scale,
-        std::list<EdgePoint*> & pointsInHull)
+        std::vector<EdgePoint*> & pointsInHull)
 {
   numerical::geometry::Ellipse qIn, qOut;
   computeHull(outerEllipse, scale, qIn, qOut);
@@ -153,18 +203,18 @@ static void selectEdgePointInEllipticHull(
   const float yCenter = outerEllipse.center().y();
 
   int maxY = std::max(int(yCenter), 0);
-  int minY = std::min(int(yCenter), int(edgeCollection.shape()[1]) - 1);
+  int minY = std::min(int(yCenter), int(height) - 1);
 
   // Visit the bottom part of the ellipse
-  for (std::ssize_t y = maxY; y < int( edgeCollection.shape()[1]); ++y)
+  for (std::ssize_t y = maxY; y < int(height); ++y)
   {
-    if (!intersectLineToTwoEllipses(y, qIn, qOut, edgeCollection, pointsInHull))
+    if (!intersectLineToTwoEllipses(y, qIn, qOut, edgeIndex, pointsInHull))
       break;
   }
   // Visit the upper part of the ellipse
   for (std::ssize_t y = minY; y >= 0; --y)
   {
-    if (!intersectLineToTwoEllipses(y, qIn, qOut, edgeCollection, pointsInHull))
+    if (!intersectLineToTwoEllipses(y, qIn, qOut, edgeIndex, pointsInHull))
       break;
   }
 }
@@ -192,6 +242,160 @@ void update(
   }
 }
 
+namespace {
+
+// Radius of the disk compared by CCTag::isEqual: the outer ellipse center with
+// half of its minor semi-axis.
+inline float equalityRadius(const CCTag& marker)
+{
+  return marker.rescaledOuterEllipse().b() * 0.5f;
+}
+
+/**
+ * @brief Spatial index of markers over the center of their outer ellipse.
+ * The markers are grouped by octave of their equality radius, the markers of a
+ * group being hashed in a grid whose cells are as large as their largest radius.
+ */
+class MarkerIndex
+{
+public:
+  void insert(std::size_t slot, const CCTag& marker)
+  {
+    const int markerOctave = octave(marker);
+    auto it = _groups.find(markerOctave);
+    if (it == _groups.end())
+    {
+      // Radii of the octave are lower than 2^(octave+1).
+      it = _groups.emplace(markerOctave, Group(std::ldexp(1.f, markerOctave + 1))).first;
+    }
+    Group & group = it->second;
+    group.cells[cellKey(marker, group)].push_back(slot);
+    ++group.size;
+  }
+
+  void erase(std::size_t slot, const CCTag& marker)
+  {
+    Group & group = _groups.at(octave(marker));
+    std::vector<std::size_t> & cell = group.cells[cellKey(marker, group)];
+    cell.erase(std::find(cell.begin(), cell.end(), slot));
+    --group.size;
+  }
+
+  // Slots of all the indexed markers which may be equal to marker, in no
+  // particular order. A margin is taken on the distance, the final decision
+  // is left to CCTag::isEqual.
+  void query(const CCTag& marker, std::vector<std::size_t>& slots) const
+  {
+    slots.clear();
+    const float x = marker.rescaledOuterEllipse().center().x();
+    const float y = marker.rescaledOuterEllipse().center().y();
+    const float radius = equalityRadius(marker);
+
+    for(const auto & item : _groups)
+    {
+      const Group & group = item.second;
+      if (group.size == 0)
+        continue;
+      
+      // Two markers are equal only if the center of one of them lies in the
+      // disk of the other one.
+      const float searchRadius = std::max(radius, group.cellSize) * 1.1f + 1.f;
+      const long xMin = std::floor((x - searchRadius) / group.cellSize);
+      const long xMax = std::floor((x + searchRadius) / group.cellSize);
+      const long yMin = std::floor((y - searchRadius) / group.cellSize);
+      const long yMax = std::floor((y + searchRadius) / group.cellSize);
+
+      if ( (xMax - xMin + 1) * (yMax - yMin + 1) > long(group.cells.size()) )
+      {
+        // Cheaper to go through all the cells of the group.
+        for(const auto & cell : group.cells)
+          slots.insert(slots.end(), cell.second.begin(), cell.second.end());
+        continue;
+      }
+      
+      for(long cx = xMin; cx <= xMax; ++cx)
+      for(long cy = yMin; cy <= yMax; ++cy)
+      {
+        const auto it = group.cells.find(packKey(cx, cy));
+        if (it != group.cells.end())
+          slots.insert(slots.end(), it->second.begin(), it->second.end());
+      }
+    }
+  }
+
+private:
+  struct Group
+  {
+    explicit Group(float cellSize) : cellSize(cellSize) { }
+    float cellSize;
+    std::size_t size = 0;
+    std::unordered_map<std::uint64_t, std::vector<std::size_t> > cells;
+  };
+  
+  std::map<int, Group> _groups; // by octave
+
+  static int octave(const CCTag& marker)
+  {
+    const float radius = equalityRadius(marker);
+    return radius >= 1.f ? std::ilogb(radius) : 0;
+  }
+  
+  static std::uint64_t packKey(long cx, long cy)
+  {
+    return (std::uint64_t(std::uint32_t(cx)) << 32) | std::uint32_t(cy);
+  }
+
+  static std::uint64_t cellKey(const CCTag& marker, const Group& group)
+  {
+    return packKey(std::floor(marker.rescaledOuterEllipse().center().x() / group.cellSize),
+                   std::floor(marker.rescaledOuterEllipse().center().y() / group.cellSize));
+  }
+};
+
+} // namespace
+
+void mergeEqualMarkers(
+        const std::vector<const CCTag*>& markers,
+        std::vector<const CCTag*>& merged)
+{
+  merged.clear();
+  merged.reserve(markers.size());
+
+  // Only the markers with a positive status can be merged, they are the only
+  // ones to be indexed.
+  MarkerIndex index;
+  std::vector<std::size_t> candidates;
+
+  for(const CCTag* marker : markers)
+  {
+    bool flag = false;
+    if (marker->getStatus() > 0)
+    {
+      index.query(*marker, candidates);
+      for(const std::size_t slot : candidates)
+      {
+        const CCTag* currentMarker = merged[slot];
+        if (currentMarker->isEqual(*marker))
+        {
+          if (marker->quality() > currentMarker->quality())
+          {
+            index.erase(slot, *currentMarker);
+            merged[slot] = marker;
+            index.insert(slot, *marker);
+          }
+          flag = true;
+        }
+      }
+    }
+    if (!flag)
+    {
+      if (marker->getStatus() > 0)
+        index.insert(merged.size(), *marker);
+      merged.push_back(marker);
+    }
+  }
+}
+
 static void cctagMultiresDetection_inner(
         size_t                  i,
         CCTag::List&            pyramidMarkers,
@@ -201,8 +405,12 @@ static void cctagMultiresDetection_inner(
         EdgePointCollection&    edgeCollection,
         cctag::TagPipe*        cuda_pipe,
         const Parameters &      params,
-        cctag::logtime::Mgmt*   durations )
+        DebugSink&              debug,
+        cctag::logtime::Mgmt*   durations,
+        LevelStats*             stats )
 {
+    CCTAG_TRACE_SPAN("level", i);
+
     DO_TALK( CCTAG_COUT_OPTIM(":::::::: Multiresolution level " << i << "::::::::"); )
 
     // Data structure for getting vote winners
@@ -219,7 +427,7 @@ static void cctagMultiresDetection_inner(
       }
       level->setLevel( cuda_pipe, params );
 
-      CCTagVisualDebug::instance().setPyramidLevel(i);
+      debug.visual().setPyramidLevel(i);
     } else { // not cuda_pipe
 #endif // defined(WITH_CUDA)
     edgesPointsFromCanny( edgeCollection,
@@ -227,41 +435,49 @@ static void cctagMultiresDetection_inner(
                           level->getDx(),
                           level->getDy());
 
-    CCTagVisualDebug::instance().setPyramidLevel(i);
+    debug.visual().setPyramidLevel(i);
 
     // Voting procedure applied on every edge points.
     vote( edgeCollection,
           seeds,        // output
           level->getDx(),
           level->getDy(),
-          params );
+          params,
+          debug );
     
     if( seeds.size() > 1 ) {
         // Sort the seeds based on the number of received votes.
-        std::sort(seeds.begin(), seeds.end(), receivedMoreVoteThan);
+        std::sort(seeds.begin(), seeds.end(),
+          [&edgeCollection](const EdgePoint* p1, const EdgePoint* p2)
+          { return edgeCollection.is_max(p1) > edgeCollection.is_max(p2); });
     }
 
 #if defined(WITH_CUDA)
     } // not cuda_pipe
 #endif // defined(WITH_CUDA)
 
+    if( stats ) {
+        stats->edgePoints = edgeCollection.get_point_count();
+        stats->voters = edgeCollection.voter_count();
+        stats->seeds = seeds.size();
+    }
 
     cctagDetectionFromEdges(
         pyramidMarkers,
         edgeCollection,
         level->getSrc(),
         seeds,
-        frame, i, std::pow(2.0, (int) i), params,
-        durations );
+        frame, i, std::pow(2.0, (int) i), params, debug,
+        durations, stats );
 
-    CCTagVisualDebug::instance().initBackgroundImage(level->getSrc());
+    debug.visual().initBackgroundImage(level->getSrc());
     std::stringstream outFilename2;
     outFilename2 << "viewLevel" << i;
-    CCTagVisualDebug::instance().newSession(outFilename2.str());
+    debug.visual().newSession(outFilename2.str());
 
     for(const CCTag & marker : pyramidMarkers)
     {
-        CCTagVisualDebug::instance().drawMarker(marker, false);
+        debug.visual().drawMarker(marker, false);
     }
 }
 
@@ -272,7 +488,9 @@ void cctagMultiresDetection(
         std::size_t   frame,
         cctag::TagPipe*    cuda_pipe,
         const Parameters&   params,
-        cctag::logtime::Mgmt* durations )
+        DebugSink&          debug,
+        cctag::logtime::Mgmt* durations,
+        DetectionStats* stats )
 {
   //	* For each pyramid level:
   //	** launch CCTag detection based on the canny edge detection output.
@@ -295,7 +513,9 @@ void cctagMultiresDetection(
                                   vEdgePointCollections.back(),
                                   cuda_pipe,
                                   params,
-                                  durations );
+                                  debug,
+                                  durations,
+                                  stats ? &stats->levels[i] : nullptr );
   }
   if( durations ) durations->log( "after cctagMultiresDetection_inner" );
   
@@ -304,21 +524,45 @@ void cctagMultiresDetection(
   for (std::size_t i = 0 ; i < params._numberOfProcessedMultiresLayers ; ++i)
   {
     CCTag::List & markersList = pyramidMarkers[i];
-    for(const CCTag & marker : markersList)
-      markers.push_back(new CCTag(marker));
+    markers.transfer(markers.end(), markersList);
   }
   
   if( durations ) durations->log( "after update markers" );
   
-  CCTagVisualDebug::instance().initBackgroundImage(imagePyramid.getLevel(0)->getSrc());
-  CCTagVisualDebug::instance().writeLocalizationView(markers);
+  debug.visual().initBackgroundImage(imagePyramid.getLevel(0)->getSrc());
+  debug.visual().writeLocalizationView(markers);
 
   // Final step: extraction of the detected markers in the original (scale) image.
-  CCTagVisualDebug::instance().newSession("multiresolution");
+  debug.visual().newSession("multiresolution");
 
   // Project markers from the top of the pyramid to the bottom (original image).
+  // The markers are projected independently of each other: in deterministic
+  // mode, the random stream of a marker is its index in the list, whatever the
+  // thread it is projected on.
+  std::vector<CCTag*> vMarkers;
+  vMarkers.reserve(markers.size());
+  bool needProjection = false;
   for(CCTag & marker : markers)
   {
+    vMarkers.push_back(&marker);
+    needProjection |= marker.pyramidLevel() > 0;
+  }
+
+  // The edge points of the first processed level are indexed once for all the markers.
+  const EdgePointCollection & edgeCollection = vEdgePointCollections.front();
+  std::unique_ptr<EdgeRowIndex> edgeIndex;
+  if (needProjection)
+    edgeIndex.reset(new EdgeRowIndex(edgeCollection));
+  if( durations ) durations->log( "after edge row index" );
+
+  // Per thread buffer for the points in the hull, reused from one marker to the next.
+  tbb::enumerable_thread_specific<std::vector<EdgePoint*>> hullBuffers;
+
+  const auto projectMarker = [&](std::size_t iMarker)
+  {
+    CCTAG_TRACE_SPAN("project marker", iMarker);
+    CCTag & marker = *vMarkers[iMarker];
+    const std::size_t randStream = iMarker;
     int i = marker.pyramidLevel();
     // if the marker has to be rescaled into the original image
     if (i > 0)
@@ -332,9 +576,9 @@ void cctagMultiresDetection(
         boost::posix_time::ptime t0(boost::posix_time::microsec_clock::local_time());
       #endif
       
-      
-      std::list<EdgePoint*> pointsInHull;
-      selectEdgePointInEllipticHull(vEdgePointCollections.front(), rescaledOuterEllipse, scale, pointsInHull);
+      std::vector<EdgePoint*> & pointsInHull = hullBuffers.local();
+      pointsInHull.clear();
+      selectEdgePointInEllipticHull(*edgeIndex, edgeCollection.shape()[1], rescaledOuterEllipse, scale, pointsInHull);
 
       #ifdef CCTAG_OPTIM
         boost::posix_time::ptime t1(boost::posix_time::microsec_clock::local_time());
@@ -343,12 +587,18 @@ void cctagMultiresDetection(
       std::vector<EdgePoint*> rescaledOuterEllipsePoints;
 
       float SmFinal = 1e+10;
+
+      if (params._deterministic)
+      {
+        numerical::rand_5_k_reseed(randStream);
+      }
       
       cctag::outlierRemoval(
               pointsInHull,
               rescaledOuterEllipsePoints,
               SmFinal,
               20.0,
+              debug,
               NO_WEIGHT,
               60); 
       
@@ -374,11 +624,11 @@ void cctagMultiresDetection(
                   e->dY()
           );
           
-          CCTagVisualDebug::instance().drawPoint(Point2d<Eigen::Vector3f>(e->x(), e->y()), cctag::color_red);
+          debug.visual().drawPoint(Point2d<Eigen::Vector3f>(e->x(), e->y()), cctag::color_red);
         }
         marker.setCenterImg(cctag::Point2d<Eigen::Vector3f>(marker.centerImg().x() * scale, marker.centerImg().y() * scale));
         marker.setRescaledOuterEllipse(rescaledOuterEllipse);
-        marker.setRescaledOuterEllipsePoints(rescaledOuterEllipsePointsDouble);
+        marker.setRescaledOuterEllipsePoints(std::move(rescaledOuterEllipsePointsDouble));
       }
       catch (...)
       {
@@ -389,14 +639,30 @@ void cctagMultiresDetection(
     {
       marker.setRescaledOuterEllipsePoints(marker.points().back());
     }
+    if (params._resultOnly)
+      marker.releasePoints();
+  };
+
+  bool parallelMarkers = true;
+#ifdef CCTAG_SERIALIZE
+  parallelMarkers = false; // the visual debug sessions are not thread safe
+#endif
+  if (parallelMarkers)
+  {
+    tbb::parallel_for(std::size_t(0), vMarkers.size(), projectMarker);
+  }
+  else
+  {
+    for (std::size_t iMarker = 0; iMarker < vMarkers.size(); ++iMarker)
+      projectMarker(iMarker);
   }
   if( durations ) durations->log( "after marker projection" );
   
   // Log
-  CCTagFileDebug::instance().newSession("data.txt");
+  debug.file().newSession("data.txt");
   for(const CCTag & marker : markers)
   {
-    CCTagFileDebug::instance().outputMarkerInfos(marker);
+    debug.file().outputMarkerInfos(marker);
   }
   
   // POP_LEAVE;
@@ -9,6 +9,7 @@
 #define VISION_CCTAG_MULTIRESOLUTION_HPP_
 
 #include <cctag/CCTag.hpp>
+#include <cctag/DetectionStats.hpp>
 #include <cctag/Params.hpp>
 #include <cctag/geometry/Ellipse.hpp>
 #include <cctag/geometry/Circle.hpp>
@@ -24,6 +25,8 @@
 
 namespace cctag {
 
+class DebugSink;
+
 struct CCTagParams
 {
 };
@@ -44,10 +47,25 @@ void cctagMultiresDetection(
         std::size_t   frame,
         cctag::TagPipe*    cuda_pipe,
         const Parameters&   params,
-        cctag::logtime::Mgmt* durations );
+        DebugSink&          debug,
+        cctag::logtime::Mgmt* durations,
+        DetectionStats* stats = nullptr );
 
 void update(CCTag::List& markers, const CCTag& markerToAdd);
 
+/**
+ * @brief Remove the duplicates from a set of markers, keeping the best ones.
+ * Gives the same result as calling update() for every marker, in order, on an
+ * empty list, but looks for the duplicates through a spatial index instead of
+ * comparing every pair of markers. The markers are not copied.
+ * 
+ * @param[in] markers markers to merge
+ * @param[out] merged merged markers, pointing into markers
+ */
+void mergeEqualMarkers(
+        const std::vector<const CCTag*>& markers,
+        std::vector<const CCTag*>& merged);
+
 } // namespace cctag
 
 
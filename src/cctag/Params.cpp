@@ -65,6 +65,12 @@ Parameters::Parameters(std::size_t nCrowns)
     , _doIdentification( kDefaultDoIdentification )
     , _maxEdges( kDefaultMaxEdges )
     , _useCuda( kDefaultUseCuda )
+    , _deterministic( kDefaultDeterministic )
+    , _ringProfileCheck( kDefaultRingProfileCheck )
+    , _ringProfileNumCuts( kDefaultRingProfileNumCuts )
+    , _imagedCenterMinSampleCutLength( kDefaultImagedCenterMinSampleCutLength )
+    , _imagedCenterPatternSearch( kDefaultImagedCenterPatternSearch )
+    , _resultOnly( false )
     , _debugDir( "" )
 {
     _nCircles = 2*_nCrowns;
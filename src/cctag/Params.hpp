@@ -10,6 +10,7 @@
 #include <boost/math/constants/constants.hpp>
 #include <boost/serialization/access.hpp>
 #include <boost/serialization/nvp.hpp>
+#include <boost/serialization/version.hpp>
 
 #include <cmath>
 #include <cstddef>
@@ -58,6 +59,11 @@ static const bool kDefaultSearchForAnotherSegment = true;
 static const bool kDefaultWriteOutput = false;
 static const bool kDefaultDoIdentification = true;
 static const uint32_t kDefaultMaxEdges = 20000;
+static const bool kDefaultDeterministic = false;
+static const bool kDefaultRingProfileCheck = false;
+static const std::size_t kDefaultRingProfileNumCuts = 8;
+static const std::size_t kDefaultImagedCenterMinSampleCutLength = 25;
+static const bool kDefaultImagedCenterPatternSearch = false;
 #ifdef WITH_CUDA
 static const bool kDefaultUseCuda = true;
 #else
@@ -96,6 +102,11 @@ static const std::string kParamWriteOutput( "kParamWriteOutput" );
 static const std::string kParamDoIdentification( "kParamDoIdentification" );
 static const std::string kParamMaxEdges( "kParamMaxEdges" );
 static const std::string kUseCuda( "kUseCuda" );
+static const std::string kParamDeterministic( "kParamDeterministic" );
+static const std::string kParamRingProfileCheck( "kParamRingProfileCheck" );
+static const std::string kParamRingProfileNumCuts( "kParamRingProfileNumCuts" );
+static const std::string kParamImagedCenterMinSampleCutLength( "kParamImagedCenterMinSampleCutLength" );
+static const std::string kParamImagedCenterPatternSearch( "kParamImagedCenterPatternSearch" );
 
 static const std::size_t kWeight = INV_GRAD_WEIGHT;
 
@@ -152,6 +163,20 @@ struct Parameters
   bool _doIdentification; // perform the identification step
   uint32_t _maxEdges; // max number of edge point, determines memory allocation
   bool        _useCuda; // if compiled WITH_CUDA, allow CLI selection, ignore if not
+  bool _deterministic; // results do not depend on the number of threads nor on
+  // their scheduling (identical to a serial run), at the cost of some
+  // speculative work in the first loop.
+  bool _ringProfileCheck; // reject, before the identification, the candidates whose
+  // radial profile does not show the black/white transitions of the crowns
+  std::size_t _ringProfileNumCuts; // number of radial cuts sampled by the ring profile check
+  std::size_t _imagedCenterMinSampleCutLength; // sample cut length of the first (coarsest) iteration
+  // of the imaged center optimization, it grows up to _sampleCutLength as the
+  // neighbourhood shrinks (_sampleCutLength or more: always full length)
+  bool _imagedCenterPatternSearch; // optimize the imaged center with a pattern search seeded by
+  // a 3x3 grid instead of the shrinking grid of _imagedCenterNGridSample points
+  bool _resultOnly; // only the id, status, center, quality and ellipses of the markers
+  // are needed (CCTagResult output): their edge points, cut points and id
+  // candidates are not kept once used !!!! NOT SERIALIZED
   std::string _debugDir; // prefix for debug output !!!! ONLY ON COMMAND LINE
 
   template<class Archive>
@@ -189,6 +214,25 @@ struct Parameters
     ar & BOOST_SERIALIZATION_NVP( _doIdentification );
     ar & BOOST_SERIALIZATION_NVP( _maxEdges );
     ar & BOOST_SERIALIZATION_NVP( _useCuda );
+    // Fields added after version 0 are optional so that older parameter
+    // files can still be loaded.
+    if( version >= 1 )
+    {
+      ar & BOOST_SERIALIZATION_NVP( _deterministic );
+    }
+    if( version >= 2 )
+    {
+      ar & BOOST_SERIALIZATION_NVP( _ringProfileCheck );
+      ar & BOOST_SERIALIZATION_NVP( _ringProfileNumCuts );
+    }
+    if( version >= 3 )
+    {
+      ar & BOOST_SERIALIZATION_NVP( _imagedCenterMinSampleCutLength );
+    }
+    if( version >= 4 )
+    {
+      ar & BOOST_SERIALIZATION_NVP( _imagedCenterPatternSearch );
+    }
     _nCircles = 2*_nCrowns;
   }
 
@@ -198,3 +242,5 @@ struct Parameters
 };
 
 } // namespace cctag
+
+BOOST_CLASS_VERSION(cctag::Parameters, 4)
@@ -0,0 +1,134 @@
+/*
+ * Copyright 2016, Simula Research Laboratory
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+#include <cctag/ResourceCache.hpp>
+#include <cctag/utils/Exceptions.hpp>
+
+#include <boost/archive/xml_iarchive.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/throw_exception.hpp>
+
+#include <ctime>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <utility>
+
+namespace bfs = boost::filesystem;
+
+namespace cctag {
+
+namespace {
+
+// Version of a file on disk: a file rewritten within the same second is still
+// seen as modified if its size changed.
+struct FileStamp
+{
+  std::time_t mtime;
+  boost::uintmax_t size;
+
+  bool operator==(const FileStamp& other) const
+  {
+    return mtime == other.mtime && size == other.size;
+  }
+};
+
+template<typename T>
+struct CacheEntry
+{
+  FileStamp stamp;
+  std::shared_ptr<const T> value;
+};
+
+std::mutex cacheMutex;
+std::map<std::pair<std::string, std::size_t>, CacheEntry<Parameters>> parametersCache;
+std::map<std::string, CacheEntry<CCTagMarkersBank>> bankCache;
+std::map<std::size_t, std::shared_ptr<const CCTagMarkersBank>> defaultBanks;
+
+bool fileStamp(const std::string& filename, FileStamp& stamp)
+{
+  boost::system::error_code ec;
+  stamp.mtime = bfs::last_write_time(filename, ec);
+  if (ec)
+    return false;
+  stamp.size = bfs::file_size(filename, ec);
+  return !ec;
+}
+
+/* Value of key in cache if it is up to date with the file, otherwise load it
+ * without holding the lock, so that other files can be looked up meanwhile. */
+template<typename T, typename Key, typename Load>
+std::shared_ptr<const T> lookup(std::map<Key, CacheEntry<T>>& cache, const Key& key,
+                                const std::string& filename, Load load)
+{
+  FileStamp stamp;
+  if (!fileStamp(filename, stamp))
+    return nullptr;
+
+  {
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    const auto found = cache.find(key);
+    if (found != cache.end() && found->second.stamp == stamp)
+      return found->second.value;
+  }
+
+  std::shared_ptr<const T> value = load();
+
+  std::lock_guard<std::mutex> lock(cacheMutex);
+  CacheEntry<T>& entry = cache[key];
+  // Another thread may have loaded the same version meanwhile: keep one copy.
+  if (entry.value && entry.stamp == stamp)
+    return entry.value;
+  entry.stamp = stamp;
+  entry.value = value;
+  return value;
+}
+
+} // namespace
+
+std::shared_ptr<const Parameters> cachedParameters(const std::string& filename, std::size_t nCrowns)
+{
+  return lookup(parametersCache, std::make_pair(filename, nCrowns), filename, [&]() -> std::shared_ptr<const Parameters>
+  {
+    std::shared_ptr<Parameters> params = std::make_shared<Parameters>(nCrowns);
+    std::ifstream ifs(filename.c_str());
+    boost::archive::xml_iarchive ia(ifs);
+    ia >> boost::serialization::make_nvp("CCTagsParams", *params);
+    return params;
+  });
+}
+
+std::shared_ptr<const CCTagMarkersBank> cachedBank(const std::string& filename)
+{
+  std::shared_ptr<const CCTagMarkersBank> bank = lookup(bankCache, filename, filename, [&]() -> std::shared_ptr<const CCTagMarkersBank>
+  {
+    return std::make_shared<CCTagMarkersBank>(filename);
+  });
+  // Same error as the bank constructor for a file that cannot be opened.
+  if (!bank)
+    BOOST_THROW_EXCEPTION(exception::Value() << exception::dev() + "Unable to open the bank file: " + filename);
+  return bank;
+}
+
+std::shared_ptr<const CCTagMarkersBank> defaultBank(std::size_t nCrowns)
+{
+  std::lock_guard<std::mutex> lock(cacheMutex);
+  std::shared_ptr<const CCTagMarkersBank>& bank = defaultBanks[nCrowns];
+  if (!bank)
+    bank = std::make_shared<CCTagMarkersBank>(nCrowns);
+  return bank;
+}
+
+void clearResourceCache()
+{
+  std::lock_guard<std::mutex> lock(cacheMutex);
+  parametersCache.clear();
+  bankCache.clear();
+  defaultBanks.clear();
+}
+
+} // namespace cctag
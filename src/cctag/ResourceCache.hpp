@@ -0,0 +1,47 @@
+/*
+ * Copyright 2016, Simula Research Laboratory
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+#ifndef _CCTAG_RESOURCECACHE_HPP_
+#define _CCTAG_RESOURCECACHE_HPP_
+
+#include <cctag/CCTagMarkersBank.hpp>
+#include <cctag/Params.hpp>
+
+#include <cstddef>
+#include <memory>
+#include <string>
+
+namespace cctag {
+
+/**
+ * @brief Parameters read from an xml parameter file, on top of the defaults
+ * for nCrowns. The files are read once per process and shared between the
+ * callers of all threads; a file modified since it was read is read again.
+ * @return nullptr if the file does not exist
+ */
+std::shared_ptr<const Parameters> cachedParameters(const std::string& filename, std::size_t nCrowns);
+
+/**
+ * @brief Bank read from a bank file, text or binary, cached like the parameters.
+ * @throw exception::Value if the file does not exist, as CCTagMarkersBank(file)
+ */
+std::shared_ptr<const CCTagMarkersBank> cachedBank(const std::string& filename);
+
+/**
+ * @brief Bank of the markers of nCrowns crowns, built once per process.
+ */
+std::shared_ptr<const CCTagMarkersBank> defaultBank(std::size_t nCrowns);
+
+/**
+ * @brief Forget the cached parameters and banks. The callers holding one keep
+ * it alive.
+ */
+void clearResourceCache();
+
+} // namespace cctag
+
+#endif
@@ -13,9 +13,22 @@ namespace cctag {
 namespace numerical {
 
 
+static const std::uint64_t kRandSeed = 271828;
+
+static pcg32& rand_5_k_rng()
+{
+  static thread_local pcg32 rng(kRandSeed);
+  return rng;
+}
+
+void rand_5_k_reseed(std::uint64_t stream)
+{
+  rand_5_k_rng().seed(kRandSeed, stream);
+}
+
 void rand_5_k(std::array<int, 5>& perm, size_t N)
 {
-  static thread_local pcg32 rng(271828);
+  pcg32& rng = rand_5_k_rng();
   
   auto it = perm.begin();
   int r;
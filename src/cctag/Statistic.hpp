@@ -16,6 +16,7 @@
 #include <algorithm>
 #include <cassert>
 #include <array>
+#include <cstdint>
 
 namespace cctag {
 namespace numerical {
@@ -74,6 +75,11 @@ void rand_n_k(Container &container, size_t N, size_t K)
 
 void rand_5_k(std::array<int, 5>& perm, size_t N);
 
+// Restart the random sequence drawn by rand_5_k on the calling thread on the
+// given stream. Reseeding per candidate makes the draws independent of which
+// thread processed which candidate before.
+void rand_5_k_reseed(std::uint64_t stream);
+
 // median(X) is the median value of the elements in X.
 float median( std::vector<float>& v );
 
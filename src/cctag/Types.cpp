@@ -12,20 +12,34 @@ namespace cctag
 {
 
 EdgePointCollection::EdgePointCollection(size_t w, size_t h) :
-  _edgeMap(new int[MAX_RESOLUTION*MAX_RESOLUTION]),
+  _edgeMap(new int[MAX_EDGE_MAP_SIZE]),
   _edgeList(new EdgePoint[MAX_POINTS]),
   _linkList(new int[2*MAX_POINTS]),
   _votersIndex(new int[MAX_POINTS+CUDA_OFFSET]),
   _votersList(new int[MAX_VOTERLIST_SIZE]),
   _processedIn(new unsigned[MAX_POINTS/4]),
-  _processedAux(new unsigned[MAX_POINTS/4])
+  _processedAux(new unsigned[MAX_POINTS/4]),
+  _edgeMapLayout(w, h),
+  _edgeMapOccupancy(new uint64_t[MAX_EDGE_MAP_SIZE/64]),
+  _flowLength(new float[MAX_POINTS]),
+  _processedRuns(new std::atomic<uint64_t>[MAX_POINTS]),
+  _isMax(new int[MAX_POINTS]),
+  _nSegmentOut(new int[MAX_POINTS])
 {
-  if (w*h > MAX_RESOLUTION*MAX_RESOLUTION)
+  if (w*h > MAX_RESOLUTION*MAX_RESOLUTION || _edgeMapLayout.size() > MAX_EDGE_MAP_SIZE)
     throw std::length_error("EdgePointCollection::set_frame_size: image resolution is too large");
 
-  point_count() = 0;
   _edgeMapShape[0] = w; _edgeMapShape[1] = h;
-  memset(&_edgeMap[0], -1, w*h*sizeof(int));  // XXX@stian: unnecessary for CUDA
+  clear();
+}
+
+void EdgePointCollection::clear()
+{
+  const size_t w = _edgeMapShape[0], h = _edgeMapShape[1];
+  point_count() = 0;
+  // The cells of _edgeMap are read only when their occupancy bit is set: only
+  // the bitmap needs clearing.
+  memset(&_edgeMapOccupancy[0], 0, (_edgeMapLayout.size()+63)/64*sizeof(uint64_t));
   
   if (w*h/8+4 < MAX_POINTS) {
     memset(&_processedIn[0], 0, w*h/8+4);     // one bit per pixel + roundoff error
@@ -43,7 +57,7 @@ void EdgePointCollection::add_point(int vx, int vy, float vdx, float vdy)
     throw std::out_of_range("EdgePointCollection::add_point: coordinate out of range");
 
   size_t imap = map_index(vx, vy);
-  if (_edgeMap[imap] != -1)
+  if (testOccupancy(&_edgeMapOccupancy[0], imap))
     throw std::logic_error("EdgePointCollection::add_point: point already exists");
 
   // XXX@stian: new() below is technically UB, but the class has no defined dtors
@@ -54,9 +68,15 @@ void EdgePointCollection::add_point(int vx, int vy, float vdx, float vdy)
   
   size_t ipoint = point_count()++;
   _edgeMap[imap] = ipoint;
+  setOccupancy(&_edgeMapOccupancy[0], imap);
   new (&_edgeList[ipoint]) EdgePoint(vx, vy, vdx, vdy);
   _linkList[2*ipoint+0] = -1;
   _linkList[2*ipoint+1] = -1;
+
+  _flowLength[ipoint] = 0;
+  _processedRuns[ipoint].store(0, std::memory_order_relaxed);
+  _isMax[ipoint] = -1;
+  _nSegmentOut[ipoint] = -1;
   // voter lists must be constructed afterwards
 }
 
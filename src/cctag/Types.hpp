@@ -8,22 +8,35 @@
 #ifndef _CCTAG_MARKERS_TYPES_HPP_
 #define _CCTAG_MARKERS_TYPES_HPP_
 
+#include <atomic>
+#include <cstdint>
 #include <memory>
 #include <new>
 #include <stdexcept>
+#include <cctag/EdgeMapLayout.hpp>
 #include <cctag/EdgePoint.hpp>
 
 
 namespace cctag {
 
+/**
+ * @brief Edge points of one pyramid level.
+ * The EdgePoint records only hold the read-only data of the points (coordinates
+ * and gradient). The state written by the voting and the loops over the seeds
+ * lives in per point arrays indexed like the records, so that writing it does
+ * not dirty the cache lines read by the other threads. The stages address the
+ * points by EdgePoint* or by index, operator() converting one into the other.
+ */
 class EdgePointCollection
 {
 public:
   static constexpr size_t MAX_POINTS = size_t(1) << 24;
+  static constexpr size_t MAX_VOTERLIST_SIZE = 16*MAX_POINTS;
 private:
   static constexpr size_t MAX_RESOLUTION = 6144;
+  // Room for the padding of a tiled layout on the borders of the largest image.
+  static constexpr size_t MAX_EDGE_MAP_SIZE = (MAX_RESOLUTION+64)*(MAX_RESOLUTION+64);
   static constexpr size_t CUDA_OFFSET = 1024; // 4 kB, one page
-  static constexpr size_t MAX_VOTERLIST_SIZE = 16*MAX_POINTS;
   
 public:
   using int_vector = std::vector<int>;
@@ -41,12 +54,24 @@ private:
   std::unique_ptr<unsigned[]> _processedIn;
   std::unique_ptr<unsigned[]> _processedAux;
   size_t _edgeMapShape[2];
+
+  // Cell order of _edgeMap, and one bit per cell set when the cell holds a
+  // point: probing an empty pixel is a bit test instead of an int load.
+  EdgeMapLayout _edgeMapLayout;
+  std::unique_ptr<uint64_t[]> _edgeMapOccupancy;
+
+  // Mutable state of the points, written by the voting and the loops over the
+  // seeds, kept apart from the read-only EdgePoint records.
+  std::unique_ptr<float[]> _flowLength;
+  std::unique_ptr<std::atomic<uint64_t>[]> _processedRuns; // bitfield, one bit per run of the second loop
+  std::unique_ptr<int[]> _isMax;
+  std::unique_ptr<int[]> _nSegmentOut;
   
   static_assert(sizeof(unsigned) == 4, "unsigned has wrong size");
   
   int& point_count() { return _votersIndex[0]; }
   int point_count() const { return _votersIndex[0]; }
-  size_t map_index(int x, int y) const { return x + y * _edgeMapShape[0]; }
+  size_t map_index(int x, int y) const { return _edgeMapLayout.index(x, y); }
   
   static void set_bit(unsigned* v, size_t i, bool f)
   {
@@ -71,10 +96,13 @@ public:
   EdgePointCollection& operator=(const EdgePointCollection&) = delete;
   
   EdgePointCollection(size_t w, size_t h);
+
+  // Remove all the points, keeping the frame size.
+  void clear();
     
   void add_point(int vx, int vy, float vdx, float vdy);
   
-  int get_point_count()
+  int get_point_count() const
   {
     return point_count();
   }
@@ -85,7 +113,14 @@ public:
 
   EdgePoint* operator()(int i) const { return i >= 0 ? const_cast<EdgePoint*>(&_edgeList[i]) : nullptr; }
 
-  EdgePoint* operator()(int x, int y) const { return (*this)(_edgeMap[map_index(x,y)]); }
+  EdgePoint* operator()(int x, int y) const { return (*this)(index(x,y)); }
+
+  // Index of the point at (x,y), or -1.
+  int index(int x, int y) const
+  {
+    const size_t cell = map_index(x,y);
+    return testOccupancy(&_edgeMapOccupancy[0], cell) ? _edgeMap[cell] : -1;
+  }
 
   int operator()(const EdgePoint* p) const
   {
@@ -105,6 +140,9 @@ public:
     return std::make_pair(&_votersList[0]+b, &_votersList[0]+e);
   }
   
+  // Total size of the voter lists, once they are created.
+  int voter_count() const { return _votersIndex[point_count()+CUDA_OFFSET]; }
+
   int voters_size(const EdgePoint* p) const
   {
     int i = (*this)(p);
@@ -136,6 +174,29 @@ public:
     _linkList[2*i+1] = link;
   }
   
+  // Index based accessors to the EdgePoint records; i must be a valid point index.
+  int16_t x(int i) const { return _edgeList[i].x(); }
+  int16_t y(int i) const { return _edgeList[i].y(); }
+  float dX(int i) const { return _edgeList[i].dX(); }
+  float dY(int i) const { return _edgeList[i].dY(); }
+  Eigen::Vector2f gradient(int i) const { return _edgeList[i].gradient(); }
+  float normGradient(int i) const { return _edgeList[i].normGradient(); }
+
+  int before(int i) const { return _linkList[2*i+0]; }
+  int after(int i) const { return _linkList[2*i+1]; }
+
+  // Index based accessors to the mutable state. As for operator()(int) const,
+  // the state can be updated through a const collection.
+  float& flow_length(int i) const { return _flowLength[i]; }
+  std::atomic<uint64_t>& processed(int i) const { return _processedRuns[i]; }
+  int& is_max(int i) const { return _isMax[i]; }
+  int& n_segment_out(int i) const { return _nSegmentOut[i]; }
+
+  float& flow_length(const EdgePoint* p) const { return flow_length((*this)(p)); }
+  std::atomic<uint64_t>& processed(const EdgePoint* p) const { return processed((*this)(p)); }
+  int& is_max(const EdgePoint* p) const { return is_max((*this)(p)); }
+  int& n_segment_out(const EdgePoint* p) const { return n_segment_out((*this)(p)); }
+
   void set_processed_in(EdgePoint* p, bool f)
   {
     set_bit(&_processedIn[0], (*this)(p), f);
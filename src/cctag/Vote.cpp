@@ -11,14 +11,14 @@
 #include <cctag/Vote.hpp>
 #include <cctag/Fitting.hpp>
 #include <cctag/EllipseGrowing.hpp>
-#include <cctag/utils/FileDebug.hpp>
+#include <cctag/utils/DebugSink.hpp>
 #include <cctag/geometry/Point.hpp>
 // #include <cctag/algebra/Invert.hpp>
 #include <cctag/geometry/Distance.hpp>
 #include <cctag/geometry/EllipseFromPoints.hpp>
 #include <cctag/Statistic.hpp>
 #include <cctag/utils/Defines.hpp>
-#include <cctag/utils/VisualDebug.hpp>
+#include <cctag/utils/Trace.hpp>
 
 #include <boost/foreach.hpp>
 #include <boost/format.hpp>
@@ -45,86 +45,80 @@
 
 namespace cctag {
 
-/* Brief: Voting procedure. For every edge points, construct the 1st order approximation 
- * of the field line passing through it which consists in a polygonal line whose
- * extremities are two edge points.
- * Input:
- * points: set of edge points to be processed, i.e. considered as the 1st extremity
- * of the constructed field line passing through it.
- * seeds: edge points having received enough votes to be considered as a seed, i.e.
- * as an edge point belonging on an inner elliptical arc of a cctag.
- * edgesMap: map of all the edge points
- * cannyGradX: X derivative of the gray image
- * cannyGradY: Y derivative of the gray image
+// Same as numerical::distancePoints2D, on the coordinates of two points given by index.
+static inline float distancePoints2D(const EdgePointCollection& edgeCollection, int i, int j)
+{
+  return std::sqrt( (float)boost::math::pow<2>( edgeCollection.x(j) - edgeCollection.x(i) ) +
+                    boost::math::pow<2>( edgeCollection.y(j) - edgeCollection.y(i) ) );
+}
+
+// Lengths of the sub-segments of a field line: at most two per crown after
+// the first one, in a fixed size array when the number of crowns is known at
+// compile time.
+template<std::size_t NCrowns>
+class CrownDistances
+{
+public:
+  explicit CrownDistances(std::size_t) {}
+  void push_back(float d) { _dist[_size++] = d; }
+  std::size_t size() const { return _size; }
+  float operator[](std::size_t i) const { return _dist[i]; }
+private:
+  std::array<float, 2*NCrowns-1> _dist;
+  std::size_t _size = 0;
+};
+
+template<>
+class CrownDistances<0>
+{
+public:
+  explicit CrownDistances(std::size_t nCrowns) { _dist.reserve(2*nCrowns-1); }
+  void push_back(float d) { _dist.push_back(d); }
+  std::size_t size() const { return _dist.size(); }
+  float operator[](std::size_t i) const { return _dist[i]; }
+private:
+  std::vector<float> _dist;
+};
+
+/* Follow the field lines of all the edge points across the crowns and count
+ * the votes of each point, for a compile time number of crowns (0: the number
+ * of crowns of the parameters).
  */
-void vote(EdgePointCollection& edgeCollection,
+template<std::size_t NCrowns>
+static void voteAlongFieldLines(EdgePointCollection& edgeCollection,
+        std::vector<std::vector<int>>& voters,
         std::vector<EdgePoint*> & seeds,
-        const cv::Mat & dx,
-        const cv::Mat & dy,
         const Parameters & params)
 {
-#ifdef CCTAG_VOTE_DEBUG
-  std::stringstream outFilenameVote;
-  outFilenameVote << "vote" << CCTagVisualDebug::instance().getPyramidLevel() << ".txt";
-  CCTagFileDebug::instance().newSession(outFilenameVote.str());
-#endif
-  
-  const int pointCount = edgeCollection.get_point_count();
-  std::vector<std::vector<int>> voters;
-  voters.resize(pointCount);
+    const std::size_t nCrowns = NCrowns ? NCrowns : params._nCrowns;
+    const int pointCount = edgeCollection.get_point_count();
 
-    for (int iEdgePoint = 0; iEdgePoint < pointCount; ++iEdgePoint ) {
-        EdgePoint& p = *edgeCollection(iEdgePoint);
-        EdgePoint* link;
-        int ilink;
-        
-        link = gradientDirectionDescent(edgeCollection, p, -1, params._distSearch, dx, dy, params._thrGradientMagInVote);
-        ilink = edgeCollection(link);
-        edgeCollection.set_before(&p, ilink);
-        
-        CCTagFileDebug::instance().endVote();
-        
-        link = gradientDirectionDescent(edgeCollection, p, 1, params._distSearch, dx, dy, params._thrGradientMagInVote);
-        ilink = edgeCollection(link);
-        edgeCollection.set_after(&p, ilink);
-        
-        CCTagFileDebug::instance().endVote();
-    }
-    // Vote
-    seeds.reserve(pointCount / 2);
-
-    // todo@Lilian: remove thrVotingAngle from the parameter file
-    if (params._angleVoting != 0) {
-        BOOST_THROW_EXCEPTION(cctag::exception::Bug() << cctag::exception::user() + 
-                "thrVotingAngle must be equal to 0 or edge points gradients have to be normalized");
-    }
-
-    
+    // The field lines are followed through the point indices: only the link,
+    // coordinates and gradients of the collection are read.
     for (int iEdgePoint = 0; iEdgePoint < pointCount; ++iEdgePoint )
     {
-        EdgePoint& p = *edgeCollection(iEdgePoint);
+        const int p = iEdgePoint;
         
         // Alternate from the edge point found in the direction opposed to the gradient
         // direction.
-        EdgePoint* current = edgeCollection.before(&p);
+        int current = edgeCollection.before(p);
         // Here current contains the edge point lying on the 2nd ellipse (from outer to inner)
-        EdgePoint* choosen = nullptr;
+        int choosen = -1;
 
         // To save all sub-segments length
-        std::vector<float> vDist; ///
-        vDist.reserve(params._nCrowns * 2 - 1);
+        CrownDistances<NCrowns> vDist(nCrowns);
 
         // Length of the reconstructed field line approximation between the two
         // extremities.
         float totalDistance = 0.f;
 
-        if (current != nullptr)
+        if (current >= 0)
         {
             // difference in subsequent gradients orientation
-            float cosDiffTheta = -p.gradient().dot(current->gradient());
+            float cosDiffTheta = -edgeCollection.gradient(p).dot(edgeCollection.gradient(current));
             if (cosDiffTheta >= params._angleVoting)
             {
-                float lastDist = cctag::numerical::distancePoints2D(p, *current);
+                float lastDist = distancePoints2D(edgeCollection, p, current);
                 vDist.push_back(lastDist);
                 
                 // Add the sub-segment length to the total distance.
@@ -132,24 +126,24 @@ void vote(EdgePointCollection& edgeCollection,
 
                 std::size_t i = 1;
                 // Iterate over all crowns
-                while (i < params._nCrowns)
+                while (i < nCrowns)
                 {
-                    choosen = nullptr;
+                    choosen = -1;
                     
                     // First in the gradient direction
-                    EdgePoint* target = edgeCollection.after(current);
+                    int target = edgeCollection.after(current);
                     // No edge point was found in that direction
-                    if (target == nullptr)
+                    if (target < 0)
                     {
                         break;
                     }
                     
                     // Check the difference of two consecutive angles
-                    cosDiffTheta = -target->gradient().dot(current->gradient());
+                    cosDiffTheta = -edgeCollection.gradient(target).dot(edgeCollection.gradient(current));
                     if (cosDiffTheta >= params._angleVoting)
                     {
                         // scalar used to compute the distance ratio
-                        float dist = cctag::numerical::distancePoints2D(*target, *current);
+                        float dist = distancePoints2D(edgeCollection, target, current);
                         vDist.push_back(dist);
                         totalDistance += dist;
 
@@ -158,9 +152,9 @@ void vote(EdgePointCollection& edgeCollection,
                         // Check the distance ratio
                         if (vDist.size() > 1)
                         {
-                            for (int iDist = 0; iDist < vDist.size(); ++iDist)
+                            for (std::size_t iDist = 0; iDist < vDist.size(); ++iDist)
                             {
-                                for (int jDist = iDist + 1; jDist < vDist.size(); ++jDist)
+                                for (std::size_t jDist = iDist + 1; jDist < vDist.size(); ++jDist)
                                 {
                                     flagDist = (vDist[iDist] <= vDist[jDist] * params._ratioVoting) && (vDist[jDist] <= vDist[iDist] * params._ratioVoting) && flagDist;
                                 }
@@ -173,20 +167,20 @@ void vote(EdgePointCollection& edgeCollection,
                             current = target;
                             // Second in the opposite gradient direction
                             target = edgeCollection.before(current);
-                            if (target == nullptr)
+                            if (target < 0)
                             {
                                 break;
                             }
-                            cosDiffTheta = -target->gradient().dot(current->gradient());
+                            cosDiffTheta = -edgeCollection.gradient(target).dot(edgeCollection.gradient(current));
                             if (cosDiffTheta >= params._angleVoting)
                             {
-                                dist = cctag::numerical::distancePoints2D(*target, *current);
+                                dist = distancePoints2D(edgeCollection, target, current);
                                 vDist.push_back(dist);
                                 totalDistance += dist;
 
-                                for (int iDist = 0; iDist < vDist.size(); ++iDist)
+                                for (std::size_t iDist = 0; iDist < vDist.size(); ++iDist)
                                 {
-                                    for (int jDist = iDist + 1; jDist < vDist.size(); ++jDist)
+                                    for (std::size_t jDist = iDist + 1; jDist < vDist.size(); ++jDist)
                                     {
                                         flagDist = (vDist[iDist] <= vDist[jDist] * params._ratioVoting) && (vDist[jDist] <= vDist[iDist] * params._ratioVoting) && flagDist;
                                     }
@@ -197,7 +191,7 @@ void vote(EdgePointCollection& edgeCollection,
                                     lastDist = dist;
                                     current = target;
                                     choosen = current;
-                                    if (current == nullptr)
+                                    if (current < 0)
                                     {
                                         break;
                                     }
@@ -226,23 +220,91 @@ void vote(EdgePointCollection& edgeCollection,
             }
         }
         // Check if winner was found
-        if (choosen != nullptr)
+        if (choosen >= 0)
         {
-            int iChoosen = edgeCollection(choosen);
-            voters[iChoosen].push_back(edgeCollection(&p));
+            int iChoosen = choosen;
+            voters[iChoosen].push_back(p);
             // update flow length average scale factor
-            choosen->_flowLength = (choosen->_flowLength * (voters[iChoosen].size() - 1) + totalDistance) / voters[iChoosen].size();
+            float& flowLength = edgeCollection.flow_length(iChoosen);
+            flowLength = (flowLength * (voters[iChoosen].size() - 1) + totalDistance) / voters[iChoosen].size();
 
             // If choosen has a number of votes greater than one of
             // the edge points, then update max.
             if (voters[iChoosen].size() >= params._minVotesToSelectCandidate) {
-                if (choosen->_isMax == -1) {
-                    seeds.push_back(choosen);
+                int& isMax = edgeCollection.is_max(iChoosen);
+                if (isMax == -1) {
+                    seeds.push_back(edgeCollection(iChoosen));
                 }
-                choosen->_isMax = voters[iChoosen].size();
+                isMax = voters[iChoosen].size();
             }
         }
     }
+}
+
+/* Brief: Voting procedure. For every edge points, construct the 1st order approximation 
+ * of the field line passing through it which consists in a polygonal line whose
+ * extremities are two edge points.
+ * Input:
+ * points: set of edge points to be processed, i.e. considered as the 1st extremity
+ * of the constructed field line passing through it.
+ * seeds: edge points having received enough votes to be considered as a seed, i.e.
+ * as an edge point belonging on an inner elliptical arc of a cctag.
+ * edgesMap: map of all the edge points
+ * cannyGradX: X derivative of the gray image
+ * cannyGradY: Y derivative of the gray image
+ */
+void vote(EdgePointCollection& edgeCollection,
+        std::vector<EdgePoint*> & seeds,
+        const cv::Mat & dx,
+        const cv::Mat & dy,
+        const Parameters & params,
+        DebugSink& debug)
+{
+  CCTAG_TRACE_SPAN("vote");
+
+#ifdef CCTAG_VOTE_DEBUG
+  std::stringstream outFilenameVote;
+  outFilenameVote << "vote" << debug.visual().getPyramidLevel() << ".txt";
+  debug.file().newSession(outFilenameVote.str());
+#endif
+  
+  const int pointCount = edgeCollection.get_point_count();
+  std::vector<std::vector<int>> voters;
+  voters.resize(pointCount);
+
+    for (int iEdgePoint = 0; iEdgePoint < pointCount; ++iEdgePoint ) {
+        EdgePoint& p = *edgeCollection(iEdgePoint);
+        EdgePoint* link;
+        int ilink;
+        
+        link = gradientDirectionDescent(edgeCollection, p, -1, params._distSearch, dx, dy, params._thrGradientMagInVote, debug);
+        ilink = edgeCollection(link);
+        edgeCollection.set_before(&p, ilink);
+        
+        debug.file().endVote();
+        
+        link = gradientDirectionDescent(edgeCollection, p, 1, params._distSearch, dx, dy, params._thrGradientMagInVote, debug);
+        ilink = edgeCollection(link);
+        edgeCollection.set_after(&p, ilink);
+        
+        debug.file().endVote();
+    }
+    // Vote
+    seeds.reserve(pointCount / 2);
+
+    // todo@Lilian: remove thrVotingAngle from the parameter file
+    if (params._angleVoting != 0) {
+        BOOST_THROW_EXCEPTION(cctag::exception::Bug() << cctag::exception::user() + 
+                "thrVotingAngle must be equal to 0 or edge points gradients have to be normalized");
+    }
+
+    
+    switch (params._nCrowns)
+    {
+      case 3: voteAlongFieldLines<3>(edgeCollection, voters, seeds, params); break;
+      case 4: voteAlongFieldLines<4>(edgeCollection, voters, seeds, params); break;
+      default: voteAlongFieldLines<0>(edgeCollection, voters, seeds, params); break;
+    }
     edgeCollection.create_voter_lists(voters);
     
     CCTAG_COUT_LILIAN("Elapsed time for vote: " << t.elapsed());
@@ -256,26 +318,39 @@ void vote(EdgePointCollection& edgeCollection,
 
     void edgeLinking(EdgePointCollection& edgeCollection, std::list<EdgePoint*>& convexEdgeSegment, EdgePoint* pmax,
             std::size_t windowSizeOnInnerEllipticSegment, float averageVoteMin) {
+
+        std::vector<EdgePoint*> processedIn;
+        edgeLinking(edgeCollection, convexEdgeSegment, processedIn, pmax, windowSizeOnInnerEllipticSegment, averageVoteMin);
+        for (EdgePoint* p : processedIn)
+        {
+            edgeCollection.set_processed_in(p, true);
+        }
+    }
+
+    void edgeLinking(const EdgePointCollection& edgeCollection, std::list<EdgePoint*>& convexEdgeSegment,
+            std::vector<EdgePoint*>& processedIn, EdgePoint* pmax,
+            std::size_t windowSizeOnInnerEllipticSegment, float averageVoteMin) {
         
         boost::container::flat_set<unsigned int> processed; // (x,y) packed in 32 bits
         if (pmax) {
             // Add current max point
             convexEdgeSegment.push_back(pmax);
-            edgeCollection.set_processed_in(pmax, true);
+            processedIn.push_back(pmax);
 
             processed.insert(packxy(pmax->x(), pmax->y()));
             // Link left
-            edgeLinkingDir(edgeCollection, processed, pmax, 1, convexEdgeSegment, windowSizeOnInnerEllipticSegment, averageVoteMin);
+            edgeLinkingDir(edgeCollection, processed, pmax, 1, convexEdgeSegment, processedIn, windowSizeOnInnerEllipticSegment, averageVoteMin);
             // Link right
-            edgeLinkingDir(edgeCollection, processed, pmax, -1, convexEdgeSegment, windowSizeOnInnerEllipticSegment, averageVoteMin);
+            edgeLinkingDir(edgeCollection, processed, pmax, -1, convexEdgeSegment, processedIn, windowSizeOnInnerEllipticSegment, averageVoteMin);
         }
     }
     
-    void edgeLinkingDir(EdgePointCollection& edgeCollection,
+    void edgeLinkingDir(const EdgePointCollection& edgeCollection,
                         boost::container::flat_set<unsigned int>& processed,
                         const EdgePoint* p,
                         int dir,
                         std::list<EdgePoint*>& convexEdgeSegment,
+                        std::vector<EdgePoint*>& processedIn,
                         std::size_t windowSizeOnInnerEllipticSegment,
                         float averageVoteMin) {
         
@@ -379,7 +454,7 @@ void vote(EdgePointCollection& edgeCollection,
                     }
                     else
                     {
-                        edgeCollection.set_processed_in(collectedP, true);
+                        processedIn.push_back(collectedP);
                         ++n;
                     }
                 }
@@ -389,7 +464,7 @@ void vote(EdgePointCollection& edgeCollection,
         {
             for (EdgePoint* collectedP : convexEdgeSegment)
             {
-                edgeCollection.set_processed_in(collectedP, true);
+                processedIn.push_back(collectedP);
             }
         }
         return;
@@ -413,13 +488,16 @@ void vote(EdgePointCollection& edgeCollection,
         }
     }
 
-    void outlierRemoval(
-            const std::list<EdgePoint*>& children,
+    template<typename EdgePointContainer>
+    static void outlierRemovalImpl(
+            const EdgePointContainer& children,
             std::vector<EdgePoint*>& filteredChildren,
             float & SmFinal,
             float threshold,
+            DebugSink& debug,
             std::size_t weightedType,
-            std::size_t maxSize)
+            std::size_t maxSize,
+            std::size_t* nTrials)
     {
       
       filteredChildren.reserve(children.size());
@@ -447,13 +525,13 @@ void vote(EdgePointCollection& edgeCollection,
 
             std::size_t k = 0;
             std::size_t iEdgePoint = 0;
-            for(const auto edgePoint : children )
+            for(const EdgePoint* edgePoint : children )
             {
               if (iEdgePoint == std::size_t(k*step) )
               {
                 ++k;
                 pts.emplace_back(edgePoint->cast<float>());
-                CCTagVisualDebug::instance().drawPoint(cctag::Point2d<Eigen::Vector3f>(pts.back()), cctag::color_red);
+                debug.visual().drawPoint(cctag::Point2d<Eigen::Vector3f>(pts.back()), cctag::color_red);
 
                 if (weightedType == INV_GRAD_WEIGHT) {
                   weights.push_back(255 / (edgePoint->normGradient()));
@@ -471,9 +549,11 @@ void vote(EdgePointCollection& edgeCollection,
             Eigen::Matrix<float, 5, 1> b, temp;
 
             std::size_t counter = 0;
+            std::size_t trials = 0;
             std::array<int, 5> perm;
             while (counter < 70)
             {
+                ++trials;
                 // Random subset of 5 points from pts
                 //const std::vector<int> perm = cctag::numerical::randperm< std::vector<int> >(pts.size());
                 cctag::numerical::rand_5_k(perm, pts.size());
@@ -569,9 +649,38 @@ void vote(EdgePointCollection& edgeCollection,
                 }
             }
             SmFinal = numerical::medianRef(vDistFinal);
+
+            if (nTrials)
+              *nTrials += trials;
         }
     }
 
+    void outlierRemoval(
+            const std::list<EdgePoint*>& children,
+            std::vector<EdgePoint*>& filteredChildren,
+            float & SmFinal,
+            float threshold,
+            DebugSink& debug,
+            std::size_t weightedType,
+            std::size_t maxSize,
+            std::size_t* nTrials)
+    {
+      outlierRemovalImpl(children, filteredChildren, SmFinal, threshold, debug, weightedType, maxSize, nTrials);
+    }
+
+    void outlierRemoval(
+            const std::vector<EdgePoint*>& children,
+            std::vector<EdgePoint*>& filteredChildren,
+            float & SmFinal,
+            float threshold,
+            DebugSink& debug,
+            std::size_t weightedType,
+            std::size_t maxSize,
+            std::size_t* nTrials)
+    {
+      outlierRemovalImpl(children, filteredChildren, SmFinal, threshold, debug, weightedType, maxSize, nTrials);
+    }
+
     bool isAnotherSegment(
             EdgePointCollection& edgeCollection,
             numerical::geometry::Ellipse & outerEllipse,
@@ -580,7 +689,8 @@ void vote(EdgePointCollection& edgeCollection,
             const Candidate & anotherCandidate,
             std::vector< std::vector< DirectedPoint2d<Eigen::Vector3f> > >& cctagPoints,
             std::size_t numCircles,
-            float thrMedianDistanceEllipse)
+            float thrMedianDistanceEllipse,
+            DebugSink& debug)
     {
         const std::vector<EdgePoint*> & anotherOuterEllipsePoints = anotherCandidate._outerEllipsePoints;
 
@@ -711,7 +821,7 @@ void vote(EdgePointCollection& edgeCollection,
                 const float SmFinal = numerical::medianRef(vDistFinal);
 
                 if (SmFinal < thrMedianDistanceEllipse) {
-                    if (addCandidateFlowtoCCTag(edgeCollection, anotherCandidate._filteredChildren, anotherOuterEllipsePoints, outerEllipseTemp, cctagPoints, numCircles)) {
+                    if (addCandidateFlowtoCCTag(edgeCollection, anotherCandidate._filteredChildren, anotherOuterEllipsePoints, outerEllipseTemp, cctagPoints, numCircles, debug)) {
                         outerEllipsePoints = outerEllipsePointsTemp;
                         outerEllipse = outerEllipseTemp;
 
@@ -722,16 +832,16 @@ void vote(EdgePointCollection& edgeCollection,
                         return false;
                     }
                 } else {
-                    CCTagFileDebug::instance().outputFlowComponentAssemblingInfos(FINAL_MEDIAN_TEST_FAILED_WHILE_ASSEMBLING);
+                    debug.file().outputFlowComponentAssemblingInfos(FINAL_MEDIAN_TEST_FAILED_WHILE_ASSEMBLING);
                     CCTAG_COUT_DEBUG("SmFinal > thrMedianDistanceEllipse in isAnotherSegment");
                 }
             } else {
-                CCTagFileDebug::instance().outputFlowComponentAssemblingInfos(QUALITY_TEST_FAILED_WHILE_ASSEMBLING);
+                debug.file().outputFlowComponentAssemblingInfos(QUALITY_TEST_FAILED_WHILE_ASSEMBLING);
                 CCTAG_COUT_DEBUG("Quality too high: " << quality);
                 return false;
             }
         } else {
-            CCTagFileDebug::instance().outputFlowComponentAssemblingInfos(MEDIAN_TEST_FAILED_WHILE_ASSEMBLING);
+            debug.file().outputFlowComponentAssemblingInfos(MEDIAN_TEST_FAILED_WHILE_ASSEMBLING);
             CCTAG_COUT_DEBUG("Test failed !!\n");
             return false;
         }
@@ -24,6 +24,8 @@
 
 namespace cctag {
 
+class DebugSink;
+
 /* Brief: Voting procedure. For every edge points, construct the 1st order approximation 
  * of the field line passing through it which consists in a polygonal line whose
  * extremities are two edge points.
@@ -39,7 +41,8 @@ namespace cctag {
 void vote(EdgePointCollection& edgeCollection, std::vector<EdgePoint*> & seeds,
         const cv::Mat & dx,
         const cv::Mat & dy,
-        const Parameters & params);
+        const Parameters & params,
+        DebugSink& debug);
  
 /** @brief Retrieve all connected edges.
  * @param[out] convexEdgeSegment
@@ -47,11 +50,22 @@ void vote(EdgePointCollection& edgeCollection, std::vector<EdgePoint*> & seeds,
 void edgeLinking(EdgePointCollection& edgeCollection, std::list<EdgePoint*>& convexEdgeSegment, EdgePoint* pmax, 
 	std::size_t windowSizeOnInnerEllipticSegment, float averageVoteMin);
 
+/** @brief Speculative edge linking: same as above except that the edge points
+ * to be flagged as processed are returned instead of being flagged.
+ * @param[out] convexEdgeSegment
+ * @param[out] processedIn edge points to flag once the segment is committed
+ */
+void edgeLinking(const EdgePointCollection& edgeCollection, std::list<EdgePoint*>& convexEdgeSegment,
+	std::vector<EdgePoint*>& processedIn, EdgePoint* pmax,
+	std::size_t windowSizeOnInnerEllipticSegment, float averageVoteMin);
+
 /** @brief Edge linking in a given direction
  * @param edges resulting edges sorted points
+ * @param[out] processedIn edge points to flag as processed
  */
-void edgeLinkingDir(EdgePointCollection& edgeCollection, boost::container::flat_set<unsigned int>& processed,
+void edgeLinkingDir(const EdgePointCollection& edgeCollection, boost::container::flat_set<unsigned int>& processed,
 	const EdgePoint* p, int dir, std::list<EdgePoint*>& convexEdgeSegment,
+	std::vector<EdgePoint*>& processedIn,
 	std::size_t windowSizeOnInnerEllipticSegment, float averageVoteMin);
 
 /** @brief Concaten all children of each points
@@ -62,16 +76,27 @@ void childrenOf(const EdgePointCollection& edgeCollection, const std::list<EdgeP
 
 /** @brief Concaten all children of each points
  * @param [in/out] edges list of children points (from a winner)
+ * @param [out] nTrials if not null, incremented by the number of LMedS trials
  */
 void outlierRemoval(
         const std::list<EdgePoint*>& children,
         std::vector<EdgePoint*>& filteredChildren,
         float & SmFinal,
         float threshold,
+        DebugSink& debug,
         std::size_t weightedType = NO_WEIGHT,
-        std::size_t maxSize = std::numeric_limits<std::size_t>::max());
+        std::size_t maxSize = std::numeric_limits<std::size_t>::max(),
+        std::size_t* nTrials = nullptr);
 
-//void outlierRemoval( std::vector<EdgePoint*>& children, float & SmFinal, float threshold, std::size_t weightedType = 0 ); //todo@Lilian : templater le outlierRemoval
+void outlierRemoval(
+        const std::vector<EdgePoint*>& children,
+        std::vector<EdgePoint*>& filteredChildren,
+        float & SmFinal,
+        float threshold,
+        DebugSink& debug,
+        std::size_t weightedType = NO_WEIGHT,
+        std::size_t maxSize = std::numeric_limits<std::size_t>::max(),
+        std::size_t* nTrials = nullptr);
 
 /** @brief Search for another segment after the ellipse growinf procedure
  * @param points from the first elliptical segment
@@ -85,7 +110,8 @@ bool isAnotherSegment(
         const Candidate & anotherCandidate,
         std::vector< std::vector< DirectedPoint2d<Eigen::Vector3f> > >& cctagPoints,
         std::size_t numCircles,
-        float thrMedianDistanceEllipse);
+        float thrMedianDistanceEllipse,
+        DebugSink& debug);
 
 } // namespace cctag
 
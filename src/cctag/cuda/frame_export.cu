@@ -111,8 +111,8 @@ bool Frame::applyExport( cctag::EdgePointCollection& out_edges,
                 out_edges.set_before(ep, out_edges(n));
         }
 
-        ep->_flowLength = pt._flowLength;
-        ep->_isMax      = pt._winnerSize;
+        out_edges.flow_length(ep) = pt._flowLength;
+        out_edges.is_max(ep)      = pt._winnerSize;
     }
 
     /* Block 3
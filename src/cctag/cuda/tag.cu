@@ -346,10 +346,10 @@ void TagPipe::checkTagAllocations( const int                numTags,
 
 __host__
 void TagPipe::uploadCuts( int                                 numTags,
-                          const std::vector<cctag::ImageCut>* vCuts,
+                          const cctag::CutBatch*              vCuts,
                           const cctag::Parameters&            params )
 {
-    if( numTags <= 0 || vCuts == 0 || vCuts->size() == 0 ) return;
+    if( numTags <= 0 || vCuts == 0 || vCuts->empty() ) return;
 
     const int max_cuts_per_Tag = STRICT_CUTSIZE( params._numCutsInIdentStep );
 
@@ -366,17 +366,16 @@ void TagPipe::uploadCuts( int                                 numTags,
             exit( -1 );
         }
 
-        std::vector<cctag::ImageCut>::const_iterator vit  = vCuts[tagIndex].begin();
-        std::vector<cctag::ImageCut>::const_iterator vend = vCuts[tagIndex].end();
-
-        for( int cut=0 ; vit!=vend; vit++, cut++ ) {
-            cutGrid->getGrid(cut).start.x     = vit->start().x();
-            cutGrid->getGrid(cut).start.y     = vit->start().y();
-            cutGrid->getGrid(cut).stop.x      = vit->stop().x();
-            cutGrid->getGrid(cut).stop.y      = vit->stop().y();
-            cutGrid->getGrid(cut).beginSig    = vit->beginSig();
-            cutGrid->getGrid(cut).endSig      = vit->endSig();
-            cutGrid->getGrid(cut).sigSize     = STRICT_SIGSIZE( vit->imgSignal().size() );
+        const cctag::CutBatch& cuts = vCuts[tagIndex];
+
+        for( int cut=0 ; cut<cuts.size(); cut++ ) {
+            cutGrid->getGrid(cut).start.x     = cuts.startX(cut);
+            cutGrid->getGrid(cut).start.y     = cuts.startY(cut);
+            cutGrid->getGrid(cut).stop.x      = cuts.stopX(cut);
+            cutGrid->getGrid(cut).stop.y      = cuts.stopY(cut);
+            cutGrid->getGrid(cut).beginSig    = cuts.beginSig(cut);
+            cutGrid->getGrid(cut).endSig      = cuts.endSig(cut);
+            cutGrid->getGrid(cut).sigSize     = STRICT_SIGSIZE( cuts.nSamples() );
         }
     }
 
@@ -27,7 +27,7 @@
 
 #include "cctag/Params.hpp"
 #include "cctag/Types.hpp"
-#include "cctag/ImageCut.hpp"
+#include "cctag/CutBatch.hpp"
 #include "cctag/geometry/Ellipse.hpp"
 #include "cctag/geometry/Point.hpp"
 
@@ -119,7 +119,7 @@ public:
     // size_t getSignalBufferByteSize( int level ) const;
 
     void uploadCuts( int                                 numTags,
-                     const std::vector<cctag::ImageCut>* vCuts,
+                     const cctag::CutBatch*              vCuts,
                      const cctag::Parameters&            params );
 
 private:
@@ -0,0 +1,39 @@
+/*
+ * Copyright 2016, Simula Research Laboratory
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+#ifndef _CCTAG_DEBUGSINK_HPP_
+#define _CCTAG_DEBUGSINK_HPP_
+
+#include <cctag/utils/FileDebug.hpp>
+#include <cctag/utils/VisualDebug.hpp>
+
+namespace cctag
+{
+
+/**
+ * @brief Debug output of one detection stream, owned by the caller and passed
+ * down the pipeline by reference.
+ *
+ * Each stream (thread, camera) uses its own sink, so enabling CCTAG_SERIALIZE
+ * does not make concurrent detections write into each other's images and
+ * records. Without CCTAG_SERIALIZE the sink is empty and all the calls made on
+ * it are inline no-ops.
+ */
+class DebugSink
+{
+public:
+    CCTagVisualDebug& visual() { return _visual; }
+    CCTagFileDebug& file() { return _file; }
+
+private:
+    CCTagVisualDebug _visual;
+    CCTagFileDebug _file;
+};
+
+} // namespace cctag
+
+#endif
@@ -13,29 +13,27 @@
 
 namespace bfs = boost::filesystem;
 
+#ifdef CCTAG_SERIALIZE
+
 namespace cctag
 {
 
 CCTagFileDebug::CCTagFileDebug()
-: _sstream(nullptr) {
+: _sstream(nullptr)
+, _isAssembled(false) {
 
 }
 
-CCTagFileDebug::~CCTagFileDebug() = default;
-
 void CCTagFileDebug::setPath(const std::string& folderName)
 {
-#ifdef CCTAG_SERIALIZE
     _path = folderName;
     if (!bfs::exists(_path)) {
       bfs::create_directory(_path);
     }
-#endif
 }
 
 void CCTagFileDebug::newSession(const std::string& sessionName)
 {
-#ifdef CCTAG_SERIALIZE
     // Don't erase old sessions
     Sessions::iterator it = _sessions.find(sessionName);
     if (it == _sessions.end()) {
@@ -43,12 +41,11 @@ void CCTagFileDebug::newSession(const std::string& sessionName)
     } else {
         _sstream = it->second;
     }
-#endif
 }
 
 void CCTagFileDebug::outputFlowComponentAssemblingInfos(int status)
 {
-#if defined CCTAG_SERIALIZE && defined DEBUG
+#ifdef DEBUG
     boost::archive::text_oarchive oa(*_sstream);
 
     for(const int index : _vflowComponentIndex) {
@@ -74,7 +71,7 @@ void CCTagFileDebug::printInfos()
 
 void CCTagFileDebug::initFlowComponentsIndex(int size)
 {
-#if defined CCTAG_SERIALIZE && defined DEBUG
+#ifdef DEBUG
     _vflowComponentIndex.resize(size);
     for (int i = 0; i < _vflowComponentIndex.size(); ++i) {
         _vflowComponentIndex[i] = 0;
@@ -84,7 +81,7 @@ void CCTagFileDebug::initFlowComponentsIndex(int size)
 
 void CCTagFileDebug::resetFlowComponent()
 {
-#if defined CCTAG_SERIALIZE && defined DEBUG
+#ifdef DEBUG
     _isAssembled = false;
     _researchArea = cctag::numerical::geometry::Ellipse();
 
@@ -98,21 +95,21 @@ void CCTagFileDebug::resetFlowComponent()
 
 void CCTagFileDebug::incrementFlowComponentIndex(int n)
 {
-#if defined CCTAG_SERIALIZE && defined DEBUG
+#ifdef DEBUG
     (_vflowComponentIndex[n])++;
 #endif            
 }
 
 void CCTagFileDebug::setResearchArea(const cctag::numerical::geometry::Ellipse& circularResearchArea)
 {
-#if defined CCTAG_SERIALIZE && defined DEBUG
+#ifdef DEBUG
     _researchArea = circularResearchArea;
 #endif 
 }
 
 void CCTagFileDebug::setFlowComponentAssemblingState(bool isAssembled, int indexSelectedFlowComponent)
 {
-#if defined CCTAG_SERIALIZE && defined DEBUG
+#ifdef DEBUG
     _isAssembled = isAssembled;
     _vflowComponentIndex[1] = indexSelectedFlowComponent;
 #endif
@@ -120,7 +117,6 @@ void CCTagFileDebug::setFlowComponentAssemblingState(bool isAssembled, int index
 
 void CCTagFileDebug::outputFlowComponentInfos(const cctag::CCTagFlowComponent & flowComponent)
 {
-#ifdef CCTAG_SERIALIZE
     if (_sstream) {
         boost::archive::text_oarchive oa(*_sstream);
         //oa << flowComponent;
@@ -130,43 +126,36 @@ void CCTagFileDebug::outputFlowComponentInfos(const cctag::CCTagFlowComponent &
     } else {
         CCTAG_COUT_ERROR("Unable to output flowComponent infos! Select session before!");
     }
-#endif
 }
 
 void CCTagFileDebug::outputMarkerInfos(const cctag::CCTag& marker)
 {
-#ifdef CCTAG_SERIALIZE
     if (_sstream) {
         boost::archive::text_oarchive oa(*_sstream);
         oa << marker;
     } else {
         CCTAG_COUT_ERROR("Unable to output marker infos! Select session before!");
     }
-#endif
 }
 
 void CCTagFileDebug::outPutAllSessions() const
 {
-#ifdef CCTAG_SERIALIZE
     for (Sessions::const_iterator it = _sessions.begin(), itEnd = _sessions.end(); it != itEnd; ++it) {
         const std::string filename = _path + "/" + it->first; //cctagFileDebug_
         std::ofstream f(filename.c_str());
         f << it->second->str();
     }
-#endif
 }
 
 void CCTagFileDebug::clearSessions()
 {
-#ifdef CCTAG_SERIALIZE
     _sessions.erase(_sessions.begin(), _sessions.end());
-#endif
 }
 
 // Vote debug
 void CCTagFileDebug::newVote(float x, float y, float dx, float dy)
 {
-#if defined(CCTAG_SERIALIZE) && defined(CCTAG_VOTE_DEBUG)
+#ifdef CCTAG_VOTE_DEBUG
    if (_sstream) {
       //boost::archive::text_oarchive oa(*_sstream);
       *_sstream << x << " " << y << " " << dx << " " << dy;
@@ -178,7 +167,7 @@ void CCTagFileDebug::newVote(float x, float y, float dx, float dy)
 
 void CCTagFileDebug::addFieldLinePoint(float x, float y)
 {
-#if defined(CCTAG_SERIALIZE) && defined(CCTAG_VOTE_DEBUG)
+#ifdef CCTAG_VOTE_DEBUG
    if (_sstream) {
       //boost::archive::text_oarchive oa(*_sstream);
       *_sstream << " " << x << " " << y;
@@ -190,7 +179,7 @@ void CCTagFileDebug::addFieldLinePoint(float x, float y)
 
 void CCTagFileDebug::endVote()
 {
-#if defined(CCTAG_SERIALIZE) && defined(CCTAG_VOTE_DEBUG)
+#ifdef CCTAG_VOTE_DEBUG
    if (_sstream) {
       //boost::archive::text_oarchive oa(*_sstream);
       *_sstream << "\n";
@@ -202,3 +191,4 @@ void CCTagFileDebug::endVote()
 
 } // namespace cctag
 
+#endif // CCTAG_SERIALIZE
@@ -9,7 +9,6 @@
 #define	_CCTAG_CCTAGOUTPUT_HPP_
 
 #include <cctag/utils/Defines.hpp>
-#include <cctag/utils/Singleton.hpp>
 #include <cctag/CCTag.hpp>
 
 #include <boost/ptr_container/ptr_map.hpp>
@@ -35,12 +34,17 @@
 
 namespace cctag {
 
-        class CCTagFileDebug : public Singleton<CCTagFileDebug> {
-            MAKE_SINGLETON_WITHCONSTRUCTORS(CCTagFileDebug)
-
+        /**
+         * @brief Text records of the intermediate results of one detection;
+         * owned by the caller through a DebugSink like CCTagVisualDebug, and
+         * reduced to empty inline functions without CCTAG_SERIALIZE.
+         */
+        class CCTagFileDebug {
         public:
             typedef boost::ptr_map<std::string, std::stringstream> Sessions;
         public:
+#ifdef CCTAG_SERIALIZE
+            CCTagFileDebug();
 
             void setPath(const std::string& folderName);
             
@@ -68,8 +72,6 @@ namespace cctag {
             void addFieldLinePoint(float x, float y);
             void endVote();
 
-            
-            
         private:
             Sessions _sessions; ///< Sessions map
 
@@ -80,6 +82,24 @@ namespace cctag {
             std::vector<int> _vflowComponentIndex;
             bool _isAssembled;
             cctag::numerical::geometry::Ellipse _researchArea;
+#else
+            void setPath(const std::string&) {}
+            void newSession(const std::string&) {}
+            void outputFlowComponentAssemblingInfos(int) {}
+            void initFlowComponentsIndex(int) {}
+            void resetFlowComponent() {}
+            void incrementFlowComponentIndex(int) {}
+            void setResearchArea(const cctag::numerical::geometry::Ellipse&) {}
+            void setFlowComponentAssemblingState(bool, int) {}
+            void outputFlowComponentInfos(const cctag::CCTagFlowComponent&) {}
+            void outputMarkerInfos(const cctag::CCTag&) {}
+            void outPutAllSessions() const {}
+            void clearSessions() {}
+            void printInfos() {}
+            void newVote(float, float, float, float) {}
+            void addFieldLinePoint(float, float) {}
+            void endVote() {}
+#endif // CCTAG_SERIALIZE
         };
         
 } // namespace cctag
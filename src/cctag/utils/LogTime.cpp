@@ -26,6 +26,7 @@ void Mgmt::Measurement::print( std::ostream& ostr ) const
 
 Mgmt::Mgmt( int rsvp )
     : _previous_time( btime::microsec_clock::local_time() )
+    , _previous_trace_time( trace::now() )
     , _durations( rsvp )
     , _reserved( rsvp )
     , _idx( 0 )
@@ -34,6 +35,7 @@ Mgmt::Mgmt( int rsvp )
 void Mgmt::resetStartTime( )
 {
     _previous_time = btime::microsec_clock::local_time();
+    _previous_trace_time = trace::now();
     _idx = 0;
 }
 
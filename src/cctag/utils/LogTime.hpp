@@ -7,11 +7,14 @@
  */
 #pragma once
 
+#include <cctag/utils/Trace.hpp>
+
 #include <boost/date_time/posix_time/posix_time.hpp>
 #include <boost/accumulators/accumulators.hpp>
 #include <boost/accumulators/statistics.hpp>
 
 #include <cstddef>
+#include <cstdint>
 #include <string>
 #include <vector>
 
@@ -47,6 +50,7 @@ struct Mgmt
     };
 
     btime::ptime             _previous_time;
+    std::uint64_t            _previous_trace_time;
     std::vector<Measurement> _durations;
     int                      _reserved;
     int                      _idx;
@@ -57,6 +61,13 @@ struct Mgmt
 
     void log( const char* probename ) {
         // std::cerr << "logging >>>" << probename << "<<<" << std::endl;
+        // the interval between two probes is also a span of the trace, even
+        // when all the measurement slots are used; the start of the next span
+        // advances while tracing is off, so that enabling it does not give a
+        // first span reaching back to the last traced probe
+        trace::recordSince( probename, _previous_trace_time );
+        _previous_trace_time = trace::now();
+
         if( _idx >= _reserved ) return;
 
         btime::ptime now( btime::microsec_clock::local_time() );
@@ -0,0 +1,161 @@
+/*
+ * Copyright 2016, Simula Research Laboratory
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+#include "Trace.hpp"
+
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+namespace cctag {
+namespace trace {
+
+namespace {
+
+struct Event
+{
+  const char* name;
+  std::int64_t arg;
+  std::uint64_t begin;
+  std::uint64_t end;
+};
+
+// Written by its thread only; read by the export once the recording is over.
+struct ThreadBuffer
+{
+  explicit ThreadBuffer(std::uint32_t id)
+    : tid(id)
+    , events(new Event[kRingCapacity])
+    , written(0)
+  {}
+
+  std::uint32_t tid;
+  std::unique_ptr<Event[]> events;
+  std::atomic<std::uint64_t> written;
+};
+
+// The buffers outlive their threads so that their spans can still be exported.
+std::mutex registryMutex;
+std::vector<std::unique_ptr<ThreadBuffer> > registry;
+
+const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+
+ThreadBuffer& threadBuffer()
+{
+  static thread_local ThreadBuffer* buffer = nullptr;
+  if (!buffer)
+  {
+    std::lock_guard<std::mutex> lock(registryMutex);
+    registry.emplace_back(new ThreadBuffer(std::uint32_t(registry.size())));
+    buffer = registry.back().get();
+  }
+  return *buffer;
+}
+
+void writeEscaped(std::ostream& ostr, const char* s)
+{
+  for (; *s; ++s)
+  {
+    if (*s == '"' || *s == '\\')
+      ostr << '\\';
+    ostr << *s;
+  }
+}
+
+// Chrome trace times are in microseconds: write nanoseconds as such.
+void writeMicroseconds(std::ostream& ostr, std::uint64_t ns)
+{
+  const char fraction[4] = { char('0' + (ns / 100) % 10), char('0' + (ns / 10) % 10), char('0' + ns % 10), 0 };
+  ostr << ns / 1000 << '.' << fraction;
+}
+
+} // namespace
+
+namespace detail {
+
+std::atomic<bool> enabled(false);
+
+std::uint64_t now()
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now() - epoch).count();
+}
+
+void record(const char* name, std::int64_t arg, std::uint64_t begin, std::uint64_t end)
+{
+  ThreadBuffer& buffer = threadBuffer();
+  const std::uint64_t w = buffer.written.load(std::memory_order_relaxed);
+  buffer.events[w % kRingCapacity] = Event{ name, arg, begin, end };
+  buffer.written.store(w + 1, std::memory_order_release);
+}
+
+} // namespace detail
+
+void setEnabled(bool on)
+{
+  detail::enabled.store(on, std::memory_order_relaxed);
+}
+
+void writeChromeTrace(std::ostream& ostr)
+{
+  std::lock_guard<std::mutex> lock(registryMutex);
+
+  ostr << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+  bool first = true;
+  for (const std::unique_ptr<ThreadBuffer>& buffer : registry)
+  {
+    const std::uint64_t written = buffer->written.load(std::memory_order_acquire);
+    const std::uint64_t begin = written > kRingCapacity ? written - kRingCapacity : 0;
+    for (std::uint64_t i = begin; i < written; ++i)
+    {
+      const Event& e = buffer->events[i % kRingCapacity];
+      ostr << (first ? "\n" : ",\n");
+      first = false;
+      ostr << "{\"name\":\"";
+      writeEscaped(ostr, e.name);
+      ostr << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->tid
+           << ",\"ts\":";
+      writeMicroseconds(ostr, e.begin);
+      ostr << ",\"dur\":";
+      writeMicroseconds(ostr, e.end - e.begin);
+      if (e.arg >= 0)
+        ostr << ",\"args\":{\"index\":" << e.arg << '}';
+      ostr << '}';
+    }
+  }
+  ostr << "\n]}\n";
+}
+
+std::map<std::string, std::uint64_t> totalDurations()
+{
+  std::lock_guard<std::mutex> lock(registryMutex);
+
+  std::map<std::string, std::uint64_t> durations;
+  for (const std::unique_ptr<ThreadBuffer>& buffer : registry)
+  {
+    const std::uint64_t written = buffer->written.load(std::memory_order_acquire);
+    const std::uint64_t begin = written > kRingCapacity ? written - kRingCapacity : 0;
+    for (std::uint64_t i = begin; i < written; ++i)
+    {
+      const Event& e = buffer->events[i % kRingCapacity];
+      durations[e.name] += e.end - e.begin;
+    }
+  }
+  return durations;
+}
+
+void clear()
+{
+  std::lock_guard<std::mutex> lock(registryMutex);
+  for (const std::unique_ptr<ThreadBuffer>& buffer : registry)
+    buffer->written.store(0, std::memory_order_relaxed);
+}
+
+} // namespace trace
+} // namespace cctag
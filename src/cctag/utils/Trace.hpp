@@ -0,0 +1,122 @@
+/*
+ * Copyright 2016, Simula Research Laboratory
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <map>
+#include <string>
+
+namespace cctag {
+namespace trace {
+
+/*
+ * Scoped spans of the detection stages, recorded with a steady clock in
+ * nanoseconds into one ring buffer per thread, and exported in the Chrome
+ * trace format (chrome://tracing, Perfetto).
+ *
+ * Tracing is off by default; a span then costs the test of one flag. The
+ * spans of a thread nest by construction (frame > level > stage > candidate
+ * or tag); the spans opened by TBB workers appear on the worker threads.
+ */
+
+// Maximum number of spans kept per thread: the oldest spans are overwritten.
+static const std::size_t kRingCapacity = std::size_t(1) << 16;
+
+namespace detail {
+
+extern std::atomic<bool> enabled;
+
+std::uint64_t now();
+
+void record(const char* name, std::int64_t arg, std::uint64_t begin, std::uint64_t end);
+
+} // namespace detail
+
+inline bool enabled()
+{
+  return detail::enabled.load(std::memory_order_relaxed);
+}
+
+void setEnabled(bool on);
+
+/**
+ * @brief Span covering the lifetime of the object.
+ * @param name static string naming the span (not copied)
+ * @param arg optional argument shown with the span (level, candidate or tag index)
+ */
+class Span
+{
+public:
+  explicit Span(const char* name, std::int64_t arg = -1)
+  {
+    if (enabled())
+    {
+      _name = name;
+      _arg = arg;
+      _begin = detail::now();
+    }
+  }
+
+  ~Span()
+  {
+    if (_name)
+      detail::record(_name, _arg, _begin, detail::now());
+  }
+
+  Span(const Span&) = delete;
+  Span& operator=(const Span&) = delete;
+
+private:
+  const char* _name = nullptr;
+  std::int64_t _arg = -1;
+  std::uint64_t _begin = 0;
+};
+
+/**
+ * @brief Record a span over [begin, now], begin being a time from now().
+ */
+inline void recordSince(const char* name, std::uint64_t begin, std::int64_t arg = -1)
+{
+  if (enabled())
+    detail::record(name, arg, begin, detail::now());
+}
+
+// Time in nanoseconds of the clock of the spans.
+inline std::uint64_t now() { return detail::now(); }
+
+/**
+ * @brief Write the spans of all the threads as a Chrome trace JSON document.
+ * Must not be called while spans are being recorded.
+ */
+void writeChromeTrace(std::ostream& ostr);
+
+/**
+ * @brief Total duration in nanoseconds of the spans of every name, summed
+ * over all the threads.
+ * Must not be called while spans are being recorded.
+ */
+std::map<std::string, std::uint64_t> totalDurations();
+
+/**
+ * @brief Drop the recorded spans of all the threads.
+ * Must not be called while spans are being recorded.
+ */
+void clear();
+
+} // namespace trace
+} // namespace cctag
+
+#define CCTAG_TRACE_CONCAT_IMPL(a, b) a##b
+#define CCTAG_TRACE_CONCAT(a, b) CCTAG_TRACE_CONCAT_IMPL(a, b)
+
+// Span from this line to the end of the enclosing scope.
+#define CCTAG_TRACE_SPAN(...) \
+  cctag::trace::Span CCTAG_TRACE_CONCAT(cctagTraceSpan, __LINE__)(__VA_ARGS__)
@@ -13,16 +13,19 @@
 
 namespace bfs = boost::filesystem;
 
+#ifdef CCTAG_SERIALIZE
+
 namespace cctag
 {
 
-CCTagVisualDebug::CCTagVisualDebug() = default;
-
-CCTagVisualDebug::~CCTagVisualDebug() = default;
+CCTagVisualDebug::CCTagVisualDebug()
+: _pyramidLevel(0)
+, _markerIndex(0)
+{
+}
 
 void CCTagVisualDebug::initializeFolders(const boost::filesystem::path & rootPath, const std::string & outputFolder, std::size_t nCrowns)
 {
-#ifdef CCTAG_SERIALIZE
   // Create inputImagePath/result if it does not exist
   std::stringstream resultFolderName, localizationFolderName, identificationFolderName, absoluteOutputFolderName;
   
@@ -54,13 +57,10 @@ void CCTagVisualDebug::initializeFolders(const boost::filesystem::path & rootPat
   
   _pathRoot = resultFolderName.str();
   CCTAG_COUT_VAR(_pathRoot);
-#endif
 }
 
 void CCTagVisualDebug::setPyramidLevel(int level) {
-#ifdef CCTAG_SERIALIZE
   _pyramidLevel = level;
-#endif
 }
 
 int CCTagVisualDebug::getPyramidLevel() const {
@@ -69,23 +69,17 @@ int CCTagVisualDebug::getPyramidLevel() const {
 
 void CCTagVisualDebug::resetMarkerIndex() 
 {
-#ifdef CCTAG_SERIALIZE
   _markerIndex = 0;;
-#endif
 }
 
 void CCTagVisualDebug::incrementMarkerIndex() 
 {
-#ifdef CCTAG_SERIALIZE
   ++_markerIndex;
-#endif
 }
 
 std::size_t CCTagVisualDebug::getMarkerIndex() const
 {
-#ifdef CCTAG_SERIALIZE
   return _markerIndex;
-#endif
 }
 
 std::string CCTagVisualDebug::getPath() const {
@@ -93,7 +87,6 @@ std::string CCTagVisualDebug::getPath() const {
 }
 
 void CCTagVisualDebug::setImageFileName(const std::string& imageFileName) {
-#ifdef CCTAG_SERIALIZE
   _imageFileName = imageFileName;
     CCTAG_COUT_VAR(_imageFileName);
   _path = _pathRoot + "/" + imageFileName;
@@ -103,20 +96,16 @@ void CCTagVisualDebug::setImageFileName(const std::string& imageFileName) {
     CCTAG_COUT("creation done");
   }
   CCTAG_COUT("exit");
-#endif   
 }
 
 void CCTagVisualDebug::initBackgroundImage(const cv::Mat & back)
 {
-#ifdef CCTAG_SERIALIZE
   cv::Mat temp;
   cvtColor(back, temp, cv::COLOR_GRAY2RGB);
   _backImage = temp.clone();
-#endif
 }
 
 void CCTagVisualDebug::newSession(const std::string & sessionName) {
-#ifdef CCTAG_SERIALIZE
   // Don't erase old sessions
   if (_sessions.find(sessionName) == _sessions.end()) {
       _sessions[sessionName] = _backImage;
@@ -124,11 +113,9 @@ void CCTagVisualDebug::newSession(const std::string & sessionName) {
   {
     _backImage = _sessions[sessionName];
   }
-#endif
 }
 
 void CCTagVisualDebug::drawText(const cctag::Point2d<Eigen::Vector3f> & p, const std::string & text, const cctag::Color & color) {
-#ifdef CCTAG_SERIALIZE
   CvFont font1;
   cvInitFont(&font1, CV_FONT_HERSHEY_SIMPLEX, 0.8, 0.8, 0, 2);
 
@@ -136,11 +123,9 @@ void CCTagVisualDebug::drawText(const cctag::Point2d<Eigen::Vector3f> & p, const
   cvPutText( &iplBack, text.c_str(),
           cvPoint((int) p.x(), (int) p.y()),
           &font1, CV_RGB(color[0] * 255, color[1] * 255, color[2] * 255));
-#endif
 }
 
 void CCTagVisualDebug::drawPoint(const cctag::Point2d<Eigen::Vector3f> & point, const cctag::Color & color) {
-#ifdef CCTAG_SERIALIZE
   if (point.x() >= 1 && point.x() < _backImage.cols-1 &&
           point.y() >= 1 && point.y() < _backImage.rows-1)
   {
@@ -151,11 +136,9 @@ void CCTagVisualDebug::drawPoint(const cctag::Point2d<Eigen::Vector3f> & point,
     _backImage.at<cv::Vec3b>(point.y(),point.x()) = cvColor;
     //cv::rectangle(_backImage, cvPoint(point.x()-1.f,point.y()-1.f), cvPoint(point.x()+1.f,point.y()+1.f), cv::Scalar(255*color[0], 255*color[1], 255*color[2]),0);
   }
-#endif // CCTAG_SERIALIZE
 }
 
 void CCTagVisualDebug::drawPoint(const cctag::DirectedPoint2d<Eigen::Vector3f> & point, const cctag::Color & color) {
-#ifdef CCTAG_SERIALIZE
   if (point.x() >= 1 && point.x() < _backImage.cols-1 &&
           point.y() >= 1 && point.y() < _backImage.rows-1)
   {
@@ -170,31 +153,25 @@ void CCTagVisualDebug::drawPoint(const cctag::DirectedPoint2d<Eigen::Vector3f> &
     
     //cv::rectangle(_backImage, cvPoint(point.x()-1.f,point.y()-1.f), cvPoint(point.x()+1.f,point.y()+1.f), cv::Scalar(255*color[0], 255*color[1], 255*color[2]),0);
   }
-#endif // CCTAG_SERIALIZE
 }
 
 void CCTagVisualDebug::drawPoints(const std::vector<cctag::Point2d<Eigen::Vector3f> > & points, const cctag::Color & color)
 {
-#ifdef CCTAG_SERIALIZE
   for(const cctag::Point2d<Eigen::Vector3f> & point : points) {
-      CCTagVisualDebug::instance().drawPoint(point, cctag::color_red);
+      drawPoint(point, cctag::color_red);
   }
-#endif
 }
 
 // todo@Lilian: template that function
 void CCTagVisualDebug::drawPoints(const std::vector<cctag::DirectedPoint2d<Eigen::Vector3f> > & points, const cctag::Color & color)
 {
-#ifdef CCTAG_SERIALIZE
   for(const cctag::Point2d<Eigen::Vector3f> & point : points) {
-      CCTagVisualDebug::instance().drawPoint(cctag::Point2d<Eigen::Vector3f>(point.x(),point.y()), cctag::color_red);
+      drawPoint(cctag::Point2d<Eigen::Vector3f>(point.x(),point.y()), cctag::color_red);
   }
-#endif
 }
 
 void CCTagVisualDebug::drawMarker(const cctag::CCTag& marker, bool drawScaledMarker)
 {
-#ifdef CCTAG_SERIALIZE
   numerical::geometry::Ellipse rescaledOuterEllipse;
   if (drawScaledMarker) {
       rescaledOuterEllipse = marker.rescaledOuterEllipse();
@@ -240,12 +217,10 @@ void CCTagVisualDebug::drawMarker(const cctag::CCTag& marker, bool drawScaledMar
   cv::ellipse(_backImage , cv::Point(center.x(),center.y()),
       cv::Size(rescaledOuterEllipse.a(), rescaledOuterEllipse.b()),
       rescaledOuterEllipse.angle()*180/M_PI, 0, 360, color);
-#endif
 }
 
 void CCTagVisualDebug::drawInfos(const cctag::CCTag& marker, bool drawScaledMarker)
 {
-#ifdef CCTAG_SERIALIZE
     CvFont font1;
   cvInitFont(&font1, CV_FONT_HERSHEY_SIMPLEX, 0.8, 0.8, 0, 2);
 
@@ -264,7 +239,6 @@ void CCTagVisualDebug::drawInfos(const cctag::CCTag& marker, bool drawScaledMark
   cvPutText( &iplImg, sId.c_str(),
           cvPoint(x-10, y+10),
           &font1, CV_RGB(255, 140, 0));
-#endif
 }
 
 std::string CCTagVisualDebug::getImageFileName() const {
@@ -272,13 +246,13 @@ std::string CCTagVisualDebug::getImageFileName() const {
 }
 
 void CCTagVisualDebug::out(const std::string & filename) const {
-#if defined(CCTAG_SERIALIZE) && defined(VISUAL_DEBUG)
+#ifdef VISUAL_DEBUG
   cv::imwrite(filename, _backImage);
 #endif
 }
 
 void CCTagVisualDebug::outPutAllSessions() const {
-#if defined(CCTAG_SERIALIZE) && defined(VISUAL_DEBUG)
+#ifdef VISUAL_DEBUG
     for(const Sessions::const_iterator::value_type & v : _sessions) {
         const std::string filename = _path + "/" + v.first + ".png";
         cv::imwrite(filename, v.second);
@@ -286,39 +260,35 @@ void CCTagVisualDebug::outPutAllSessions() const {
 #endif
 }
 
-void CCTagVisualDebug::writeLocalizationView(cctag::CCTag::List& markers) const {
-#ifdef CCTAG_SERIALIZE
+void CCTagVisualDebug::writeLocalizationView(cctag::CCTag::List& markers) {
     std::stringstream localizationResultFileName;
     localizationResultFileName << "../localization/" << _imageFileName;
-    CCTagVisualDebug::instance().newSession(localizationResultFileName.str());
+    newSession(localizationResultFileName.str());
 
     for(const cctag::CCTag & marker : markers) {
-        CCTagVisualDebug::instance().drawMarker(marker);
-        CCTagVisualDebug::instance().drawInfos(marker);
+        drawMarker(marker);
+        drawInfos(marker);
     }
-#endif
 }
 
-void CCTagVisualDebug::writeIdentificationView(cctag::CCTag::List& markers) const {
-#ifdef CCTAG_SERIALIZE
+void CCTagVisualDebug::writeIdentificationView(cctag::CCTag::List& markers) {
 
     std::stringstream identificationResultFileName;
     identificationResultFileName << "../identification/" << _imageFileName;
-    CCTagVisualDebug::instance().newSession(identificationResultFileName.str());
+    newSession(identificationResultFileName.str());
 
     for(const cctag::CCTag & marker : markers) {
-        CCTagVisualDebug::instance().drawMarker(marker);
-        CCTagVisualDebug::instance().drawPoints(marker.rescaledOuterEllipsePoints(), cctag::color_red);
-        CCTagVisualDebug::instance().drawInfos(marker);
+        drawMarker(marker);
+        drawPoints(marker.rescaledOuterEllipsePoints(), cctag::color_red);
+        drawInfos(marker);
     }
 
-#endif
 }
 
 void CCTagVisualDebug::clearSessions() {
-#ifdef CCTAG_SERIALIZE
     _sessions.erase(_sessions.begin(), _sessions.end());
-#endif
 }
 
 } // namespace cctag
+
+#endif // CCTAG_SERIALIZE
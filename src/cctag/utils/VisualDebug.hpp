@@ -9,7 +9,6 @@
 #define	_CCTAG_CCTAG_VISUALDEBUG_HPP_
 
 #include <cctag/geometry/EllipseFromPoints.hpp>
-#include <cctag/utils/Singleton.hpp>
 #include <cctag/geometry/Point.hpp>
 #include <cctag/Colors.hpp>
 #include <cctag/CCTag.hpp>
@@ -19,12 +18,19 @@
 namespace cctag
 {
 
-class CCTagVisualDebug : public Singleton<CCTagVisualDebug> {
-    MAKE_SINGLETON_WITHCONSTRUCTORS(CCTagVisualDebug)
-
+/**
+ * @brief Images of the intermediate results of one detection.
+ *
+ * Owned by the caller through a DebugSink and handed down the pipeline, so that
+ * concurrent detections never share one. Without CCTAG_SERIALIZE every method
+ * is an empty inline function and the calls compile away.
+ */
+class CCTagVisualDebug {
 public:
     typedef std::map<std::string, cv::Mat> Sessions;
 public:
+#ifdef CCTAG_SERIALIZE
+    CCTagVisualDebug();
 
     void setPyramidLevel(int level);
 
@@ -63,9 +69,9 @@ public:
 
     void outPutAllSessions() const;
 
-    void writeLocalizationView(cctag::CCTag::List & markers) const;
+    void writeLocalizationView(cctag::CCTag::List & markers);
 
-    void writeIdentificationView(cctag::CCTag::List & markers) const;
+    void writeIdentificationView(cctag::CCTag::List & markers);
 
     std::string getImageFileName() const;
     
@@ -95,6 +101,31 @@ private:
     std::string _pathRoot;
     std::string _path;
     std::size_t _markerIndex;
+#else
+    void setPyramidLevel(int) {}
+    int getPyramidLevel() const { return 0; }
+    void resetMarkerIndex() {}
+    void incrementMarkerIndex() {}
+    std::size_t getMarkerIndex() const { return 0; }
+    std::string getPath() const { return std::string(); }
+    void setImageFileName(const std::string&) {}
+    void initBackgroundImage(const cv::Mat&) {}
+    void initializeFolders(const boost::filesystem::path&, const std::string&, std::size_t = 4) {}
+    void newSession(const std::string&) {}
+    void drawText(const cctag::Point2d<Eigen::Vector3f>&, const std::string&, const cctag::Color&) {}
+    void drawPoint(const cctag::Point2d<Eigen::Vector3f>&, const cctag::Color&) {}
+    void drawPoint(const cctag::DirectedPoint2d<Eigen::Vector3f>&, const cctag::Color&) {}
+    void drawPoints(const std::vector<cctag::Point2d<Eigen::Vector3f> >&, const cctag::Color&) {}
+    void drawPoints(const std::vector<cctag::DirectedPoint2d<Eigen::Vector3f> >&, const cctag::Color&) {}
+    void drawMarker(const cctag::CCTag&, bool = true) {}
+    void drawInfos(const cctag::CCTag&, bool = true) {}
+    void out(const std::string&) const {}
+    void outPutAllSessions() const {}
+    void writeLocalizationView(cctag::CCTag::List&) {}
+    void writeIdentificationView(cctag::CCTag::List&) {}
+    std::string getImageFileName() const { return std::string(); }
+    void clearSessions() {}
+#endif // CCTAG_SERIALIZE
 };
 
 } // namespace cctag